@@ -117,6 +117,50 @@ project("tankdump");
 	files({ "source/tools/tankdump/tankdump.cpp" });
 	links({ LIB_UTILS_NAME, LIB_SIEGE_NAME });
 
+-----------------------------------------------------------
+-- tankpack command line tool:
+-----------------------------------------------------------
+project("tankpack");
+	language("C++");
+	kind("ConsoleApp");
+	configuration("macosx", "linux", "gmake"); -- Debug & Release
+	buildoptions({ COMMON_COMPILER_FLAGS, CPLUSPLUS_FLAGS });
+	files({ "source/tools/tankpack/tankpack.cpp" });
+	links({ LIB_UTILS_NAME, LIB_SIEGE_NAME });
+
+-----------------------------------------------------------
+-- crc32bench command line tool:
+-----------------------------------------------------------
+project("crc32bench");
+	language("C++");
+	kind("ConsoleApp");
+	configuration("macosx", "linux", "gmake"); -- Debug & Release
+	buildoptions({ COMMON_COMPILER_FLAGS, CPLUSPLUS_FLAGS });
+	files({ "source/tools/crc32bench/crc32bench.cpp" });
+	links({ LIB_UTILS_NAME, LIB_SIEGE_NAME });
+
+-----------------------------------------------------------
+-- tankstress command line tool:
+-----------------------------------------------------------
+project("tankstress");
+	language("C++");
+	kind("ConsoleApp");
+	configuration("macosx", "linux", "gmake"); -- Debug & Release
+	buildoptions({ COMMON_COMPILER_FLAGS, CPLUSPLUS_FLAGS });
+	files({ "source/tools/tankstress/tankstress.cpp" });
+	links({ LIB_UTILS_NAME, LIB_SIEGE_NAME });
+
+-----------------------------------------------------------
+-- indexbench command line tool:
+-----------------------------------------------------------
+project("indexbench");
+	language("C++");
+	kind("ConsoleApp");
+	configuration("macosx", "linux", "gmake"); -- Debug & Release
+	buildoptions({ COMMON_COMPILER_FLAGS, CPLUSPLUS_FLAGS });
+	files({ "source/tools/indexbench/indexbench.cpp" });
+	links({ LIB_UTILS_NAME, LIB_SIEGE_NAME });
+
 -----------------------------------------------------------
 -- raw2tga command line tool:
 -----------------------------------------------------------
@@ -83,16 +83,17 @@ inline uint32_t versionOf(const uint32_t v)
 // AspModel::AspImporter:
 // ========================================================
 
-AspModel::AspImporter::AspImporter(AspModel & mdl, ByteArray fileData,
+AspModel::AspImporter::AspImporter(AspModel & mdl, const uint8_t * fileData, const size_t fileSizeBytes,
                                    const uint32_t impFlags, const std::string & filename)
 	: model(mdl)
 	, importFlags(impFlags)
 	, currentSubMeshIndex(0)
 	, readPosition(0)
-	, fileContents(std::move(fileData))
+	, fileContents(fileData)
+	, fileContentsSize(fileSizeBytes)
 	, srcFileName(filename)
 {
-	assert(!fileContents.empty());
+	assert(fileContentsSize != 0);
 	importAspModel();
 
 	// TODO actually use the importFlags !!!
@@ -103,14 +104,14 @@ void AspModel::AspImporter::readBytes(void * buffer, const size_t numBytes)
 {
 	assert(buffer   != nullptr);
 	assert(numBytes != 0);
-	assert(!fileContents.empty());
+	assert(fileContentsSize != 0);
 
-	if (readPosition == fileContents.size() || (readPosition + numBytes) > fileContents.size())
+	if (readPosition == fileContentsSize || (readPosition + numBytes) > fileContentsSize)
 	{
 		SiegeThrow(Exception, "Trying to read past the end of ASP file \"" << srcFileName << "\"!");
 	}
 
-	const uint8_t * dataPtr = fileContents.data() + readPosition;
+	const uint8_t * dataPtr = fileContents + readPosition;
 	std::memcpy(buffer, dataPtr, numBytes);
 	readPosition += numBytes;
 }
@@ -193,12 +194,12 @@ AspModel::Vec4 AspModel::AspImporter::readVec4()
 
 bool AspModel::AspImporter::readFourCC(FourCC & fcc)
 {
-	if (readPosition == fileContents.size() || (readPosition + sizeof(FourCC)) > fileContents.size())
+	if (readPosition == fileContentsSize || (readPosition + sizeof(FourCC)) > fileContentsSize)
 	{
 		return false; // End of file reached.
 	}
 
-	const uint8_t * dataPtr = fileContents.data() + readPosition;
+	const uint8_t * dataPtr = fileContents + readPosition;
 	std::memcpy(&fcc, dataPtr, sizeof(FourCC));
 	readPosition += sizeof(FourCC);
 	return true;
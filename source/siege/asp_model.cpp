@@ -69,10 +69,16 @@ void AspModel::initFromFile(std::string filename, const uint32_t importFlags)
 }
 
 void AspModel::initFromMemory(ByteArray fileContents, const uint32_t importFlags, std::string filename)
+{
+	initFromMemory(fileContents.data(), fileContents.size(), importFlags, std::move(filename));
+}
+
+void AspModel::initFromMemory(const uint8_t * fileData, const size_t fileSizeBytes,
+                               const uint32_t importFlags, std::string filename)
 {
 	dispose(); // Get rid of any existing import.
 
-	AspImporter importer(*this, std::move(fileContents), importFlags, filename);
+	AspImporter importer(*this, fileData, fileSizeBytes, importFlags, filename);
 	srcFileName = std::move(filename);
 
 	SiegeLog("AspModel \"" << srcFileName << "\" initialized. "
@@ -145,6 +145,10 @@ public:
 	// Load ASP model from memory. Discards current, if any.
 	void initFromMemory(ByteArray fileContents, uint32_t importFlags = Default, std::string filename = "");
 
+	// Load ASP model from a memory buffer that is not owned by the model, such as a view into
+	// a memory mapped Tank file. The buffer only has to stay valid for the duration of the call.
+	void initFromMemory(const uint8_t * fileData, size_t fileSizeBytes, uint32_t importFlags = Default, std::string filename = "");
+
 	// Disposes model data, making this class an empty/invalid model.
 	void dispose();
 
@@ -170,7 +174,7 @@ private:
 
 		// Imports a model from file data, writing to 'mdl'.
 		// Might throw an exception on error.
-		AspImporter(AspModel & mdl, ByteArray fileData,
+		AspImporter(AspModel & mdl, const uint8_t * fileData, size_t fileSizeBytes,
 		            uint32_t impFlags, const std::string & filename);
 
 	private:
@@ -211,7 +215,8 @@ private:
 		uint32_t            importFlags;
 		uint32_t            currentSubMeshIndex;
 		size_t              readPosition;
-		const ByteArray     fileContents;
+		const uint8_t *     fileContents;
+		const size_t        fileContentsSize;
 		const std::string & srcFileName;
 	};
 
@@ -98,6 +98,12 @@ void setDefaultLogStream(std::ostream & ostr) noexcept
 	logStream = &ostr;
 }
 
+std::mutex & getLogMutex() noexcept
+{
+	static std::mutex logMutex;
+	return logMutex;
+}
+
 // ========================================================
 // Siege Exception:
 // ========================================================
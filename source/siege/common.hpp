@@ -12,6 +12,7 @@
 // ================================================================================================
 
 #include "utils/utils.hpp"
+#include <mutex>
 
 // ========================================================
 
@@ -30,18 +31,21 @@
 	#define SiegeLog(message) \
 		if (int(::siege::defaultLogVerbosity) >= int(::siege::LogVerbosity::All)) \
 		{ \
+			std::lock_guard<std::mutex> logLock(::siege::getLogMutex()); \
 			SiegeLogStream << "LOG...: " << message << "\n"; \
 		}
 
 	#define SiegeWarn(message) \
 		if (int(::siege::defaultLogVerbosity) >= int(::siege::LogVerbosity::Warnings)) \
 		{ \
+			std::lock_guard<std::mutex> logLock(::siege::getLogMutex()); \
 			SiegeLogStream << "WARN..: " << message << "\n"; \
 		}
 
 	#define SiegeError(message) \
 		if (int(::siege::defaultLogVerbosity) >= int(::siege::LogVerbosity::Errors)) \
 		{ \
+			std::lock_guard<std::mutex> logLock(::siege::getLogMutex()); \
 			SiegeLogStream << "ERROR.: " << message << "\n"; \
 		}
 #else // !SIEGE_ENABLE_LOGGING
@@ -90,6 +94,11 @@ std::ostream & getDefaultLogStream();
 void setDefaultLogFileName(const char * filename) noexcept;
 void setDefaultLogStream(std::ostream & ostr) noexcept;
 
+// Mutex held by the log macros while writing a message, so that
+// Tank resources can be extracted from multiple threads without
+// interleaving output. Lock it if you write to the log stream directly.
+std::mutex & getLogMutex() noexcept;
+
 // Verbosity levels of the default Siege log.
 // NOTE: Not thread safe! Default value is `LogVerbosity::All`.
 enum class LogVerbosity { Silent, Errors, Warnings, All };
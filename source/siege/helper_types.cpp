@@ -148,6 +148,19 @@ time_t FileTime::toPortableTime() const
 	return static_cast<time_t>(temp);
 }
 
+FileTime FileTime::fromPortableTime(const time_t t)
+{
+	constexpr uint64_t TicksPerSecond  = 10000000;
+	constexpr uint64_t EpochDifference = 11644473600UL;
+
+	const uint64_t ticks = (static_cast<uint64_t>(t) + EpochDifference) * TicksPerSecond;
+
+	FileTime ft;
+	ft.lowDateTime  = static_cast<uint32_t>(ticks & 0xFFFFFFFF);
+	ft.highDateTime = static_cast<uint32_t>(ticks >> 32);
+	return ft;
+}
+
 std::ostream & operator << (std::ostream & s, const FileTime ft)
 {
 	// Detect a null FileTime:
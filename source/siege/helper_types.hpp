@@ -111,6 +111,7 @@ struct FileTime final
 
 	uint64_t toU64() const;
 	time_t toPortableTime() const;
+	static FileTime fromPortableTime(time_t t);
 };
 
 std::ostream & operator << (std::ostream & s, FileTime ft);
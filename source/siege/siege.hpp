@@ -12,6 +12,7 @@
 // ================================================================================================
 
 #include "siege/tank_file.hpp"
+#include "siege/tank_file_system.hpp"
 #include "siege/raw_image.hpp"
 #include "siege/asp_model.hpp"
 #include "siege/sno_model.hpp"
@@ -34,15 +34,16 @@ namespace siege
 // SnoModel::SnoImporter:
 // ========================================================
 
-SnoModel::SnoImporter::SnoImporter(SnoModel & mdl, ByteArray fileData,
+SnoModel::SnoImporter::SnoImporter(SnoModel & mdl, const uint8_t * fileData, const size_t fileSizeBytes,
                                    const uint32_t impFlags, const std::string & filename)
 	: model(mdl)
 	, importFlags(impFlags)
 	, readPosition(0)
-	, fileContents(std::move(fileData))
+	, fileContents(fileData)
+	, fileContentsSize(fileSizeBytes)
 	, srcFileName(filename)
 {
-	assert(!fileContents.empty());
+	assert(fileContentsSize != 0);
 	importSnoModel();
 
 	// TODO actually use the importFlags !!!
@@ -53,14 +54,14 @@ void SnoModel::SnoImporter::readBytes(void * buffer, const size_t numBytes)
 {
 	assert(buffer   != nullptr);
 	assert(numBytes != 0);
-	assert(!fileContents.empty());
+	assert(fileContentsSize != 0);
 
-	if (readPosition == fileContents.size() || (readPosition + numBytes) > fileContents.size())
+	if (readPosition == fileContentsSize || (readPosition + numBytes) > fileContentsSize)
 	{
 		SiegeThrow(Exception, "Trying to read past the end of SNO file \"" << srcFileName << "\"!");
 	}
 
-	const uint8_t * dataPtr = fileContents.data() + readPosition;
+	const uint8_t * dataPtr = fileContents + readPosition;
 	std::memcpy(buffer, dataPtr, numBytes);
 	readPosition += numBytes;
 }
@@ -69,10 +69,16 @@ void SnoModel::initFromFile(std::string filename, const uint32_t importFlags)
 }
 
 void SnoModel::initFromMemory(ByteArray fileContents, const uint32_t importFlags, std::string filename)
+{
+	initFromMemory(fileContents.data(), fileContents.size(), importFlags, std::move(filename));
+}
+
+void SnoModel::initFromMemory(const uint8_t * fileData, const size_t fileSizeBytes,
+                               const uint32_t importFlags, std::string filename)
 {
 	dispose(); // Get rid of any existing import.
 
-	SnoImporter importer(*this, std::move(fileContents), importFlags, filename);
+	SnoImporter importer(*this, fileData, fileSizeBytes, importFlags, filename);
 	srcFileName = std::move(filename);
 
 	SiegeLog("SnoModel \"" << srcFileName << "\" initialized. "
@@ -157,6 +157,10 @@ public:
 	// Load SNO model from memory. Discards current, if any.
 	void initFromMemory(ByteArray fileContents, uint32_t importFlags = Default, std::string filename = "");
 
+	// Load SNO model from a memory buffer that is not owned by the model, such as a view into
+	// a memory mapped Tank file. The buffer only has to stay valid for the duration of the call.
+	void initFromMemory(const uint8_t * fileData, size_t fileSizeBytes, uint32_t importFlags = Default, std::string filename = "");
+
 	// Disposes model data, making this class an empty/invalid model.
 	void dispose();
 
@@ -183,7 +187,7 @@ private:
 
 		// Imports a model from file data, writing to 'mdl'.
 		// Might throw an exception on error.
-		SnoImporter(SnoModel & mdl, ByteArray fileData,
+		SnoImporter(SnoModel & mdl, const uint8_t * fileData, size_t fileSizeBytes,
 		            uint32_t impFlags, const std::string & filename);
 
 	private:
@@ -209,7 +213,8 @@ private:
 		SnoModel &          model;
 		uint32_t            importFlags;
 		size_t              readPosition;
-		const ByteArray     fileContents;
+		const uint8_t *     fileContents;
+		const size_t        fileContentsSize;
 		const std::string & srcFileName;
 	};
 
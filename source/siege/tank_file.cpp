@@ -362,7 +362,7 @@ TankFile::DataFormat TankFile::dataFormatFromString(const std::string & str)
 // TankFile instance methods:
 // ========================================================
 
-void TankFile::openForReading(std::string filename)
+void TankFile::openForReading(std::string filename, const IOMode ioMode)
 {
 	if (isOpen())
 	{
@@ -374,7 +374,15 @@ void TankFile::openForReading(std::string filename)
 		SiegeThrow(TankFile::Error, "No filename provided!");
 	}
 
-	if (!utils::filesys::tryOpen(file, filename, std::ios::binary))
+	if (ioMode == IOMode::MemoryMapped)
+	{
+		if (!mappedFile.mapForReading(filename))
+		{
+			SiegeThrow(TankFile::Error, "Failed to memory map Tank file \"" << filename
+					<< "\": '" << utils::filesys::getLastFileError() << "'.");
+		}
+	}
+	else if (!file.openForReading(filename))
 	{
 		SiegeThrow(TankFile::Error, "Failed to open Tank file \"" << filename
 				<< "\": '" << utils::filesys::getLastFileError() << "'.");
@@ -382,6 +390,7 @@ void TankFile::openForReading(std::string filename)
 
 	fileName     = std::move(filename);
 	fileOpenMode = std::ios::in | std::ios::binary;
+	readCursor   = 0;
 
 	queryFileSize();
 	readAndValidateHeader();
@@ -392,10 +401,9 @@ void TankFile::openForReading(std::string filename)
 
 void TankFile::close()
 {
-	if (file.is_open())
-	{
-		file.close();
-	}
+	file.close();
+	mappedFile.unmap();
+	readCursor = 0;
 
 	fileSizeBytes = 0;
 	fileOpenMode  = 0;
@@ -406,7 +414,7 @@ void TankFile::close()
 
 bool TankFile::isOpen() const noexcept
 {
-	return file.is_open();
+	return file.isOpen() || mappedFile.isMapped();
 }
 
 bool TankFile::isReadOnly() const noexcept
@@ -427,6 +435,11 @@ bool TankFile::isReadWrite() const noexcept
 	       (fileOpenMode & std::ios::out);
 }
 
+bool TankFile::isMemoryMapped() const noexcept
+{
+	return mappedFile.isMapped();
+}
+
 size_t TankFile::getFileSizeBytes() const noexcept
 {
 	return fileSizeBytes;
@@ -530,29 +543,59 @@ void TankFile::readAndValidateHeader()
 void TankFile::seekAbsoluteOffset(const size_t offsetInBytes)
 {
 	assert(isOpen());
-	// Seek absolute offset relative to the beginning of the file.
-	if (!file.seekg(offsetInBytes, std::ifstream::beg))
+
+	// There's no underlying stream position, we just move our own cursor,
+	// which is only used by the sequential read helpers below.
+	if (offsetInBytes > fileSizeBytes)
 	{
 		SiegeThrow(TankFile::Error, "Failed to seek file offset on TankFile::seekAbsoluteOffset()!");
 	}
+	readCursor = offsetInBytes;
 }
 
 void TankFile::readBytes(void * buffer, const size_t numBytes)
+{
+	readBytesAt(readCursor, buffer, numBytes);
+	readCursor += numBytes;
+}
+
+void TankFile::readBytesAt(const size_t offsetInBytes, void * buffer, const size_t numBytes) const
 {
 	assert(buffer   != nullptr);
 	assert(numBytes != 0);
 	assert(isOpen());
 
-	if (!file.read(reinterpret_cast<char *>(buffer), numBytes))
+	if (isMemoryMapped())
 	{
-		SiegeError("Only " << file.gcount() << " bytes of " << numBytes
+		std::memcpy(buffer, getMappedBytes(offsetInBytes, numBytes), numBytes);
+		return;
+	}
+
+	size_t bytesRead = 0;
+	if (!file.readAt(offsetInBytes, buffer, numBytes, &bytesRead))
+	{
+		SiegeError("Only " << bytesRead << " bytes of " << numBytes
 				<< " could be read from \"" << fileName << "\"!");
 
 		SiegeThrow(TankFile::Error, "Failed to read " << utils::formatMemoryUnit(numBytes)
-				<< " from Tank file \"" << fileName << "\"!");
+				<< " at offset " << offsetInBytes << " from Tank file \"" << fileName << "\"!");
 	}
 }
 
+const uint8_t * TankFile::getMappedBytes(const size_t offsetInBytes, const size_t numBytes) const
+{
+	assert(isMemoryMapped());
+
+	const size_t mappedSize = mappedFile.getSizeBytes();
+	if (offsetInBytes > mappedSize || numBytes > (mappedSize - offsetInBytes))
+	{
+		SiegeThrow(TankFile::Error, "Failed to read " << utils::formatMemoryUnit(numBytes)
+				<< " from Tank file \"" << fileName << "\"! Range is past the end of the mapping.");
+	}
+
+	return mappedFile.getData() + offsetInBytes;
+}
+
 uint16_t TankFile::readU16()
 {
 	uint16_t x = 0;
@@ -15,9 +15,9 @@
 #include "siege/helper_types.hpp"
 
 #include <fstream>
+#include <functional>
 #include <future>
 #include <memory>
-#include <unordered_map>
 
 namespace siege
 {
@@ -75,6 +75,19 @@ public:
 	static DataFormat dataFormatFromString(const std::string & str);
 	static bool isDataFormatCompressed(DataFormat format) noexcept { return format != DataFormat::Raw; }
 
+	//
+	// How the Tank file contents are accessed after opening:
+	//
+	//  Stream       - Positional reads (pread) from the file. Every extracted byte is copied out of the file.
+	//  MemoryMapped - The whole file is mapped read-only into the address space.
+	//                 Uncompressed resources can be accessed in-place with Reader::getResourceView().
+	//
+	enum class IOMode
+	{
+		Stream,
+		MemoryMapped
+	};
+
 	//
 	// Original comment from "TankStructure.h":
 	//
@@ -307,19 +320,282 @@ public:
 		~Error();
 	};
 
+	//
+	// Compact read-only index of all the directories and files in a Tank.
+	//
+	// Everything lives in a single contiguous block of memory that only refers
+	// to itself by offsets, so it can be saved to disk and used again as-is.
+	// Full paths are stored once in a string arena and records reference them
+	// by offset/length. Lookups do a binary search over arrays of record indexes
+	// sorted by path, which also gives the path lists in alphabetical order.
+	//
+	class Index final
+		: public utils::NonCopyable
+	{
+	public:
+
+		static constexpr uint32_t InvalidIndex = 0xFFFFFFFF;
+
+		struct DirRecord final
+		{
+			uint32_t parentIndex;  // Index of the parent DirRecord. InvalidIndex for the root.
+			uint32_t dirSetOffset; // (DSO) Offset of the original DirEntry.
+			uint32_t pathOffset;   // Full path with trailing separator, e.g.: "/art/maps/".
+			uint32_t pathLength;
+			uint32_t nameOffset;   // Slice of the path with just the dir name. "/" for the root.
+			uint32_t nameLength;
+			uint32_t firstSubdir;  // Children, sorted by name, as ranges of the dirsByParent
+			uint32_t numSubdirs;   // and filesByParent tables. Files with a null parent are
+			uint32_t firstFile;    // listed as children of the root.
+			uint32_t numFiles;
+			FileTime fileTime;
+
+			bool isRoot() const noexcept { return parentIndex == InvalidIndex; }
+		};
+
+		struct FileRecord final
+		{
+			uint32_t parentIndex;    // Index of the parent DirRecord. InvalidIndex if the file had a null parent.
+			uint32_t pathOffset;     // Full path, e.g.: "/art/maps/foo.gas".
+			uint32_t pathLength;
+			uint32_t nameOffset;     // Slice of the path with just the file name.
+			uint32_t nameLength;
+			uint32_t size;           // Uncompressed size of resource.
+			uint32_t offset;         // (DO) Offset to data from top of data section.
+			uint32_t crc32;          // CRC-32 of just this resource.
+			FileTime fileTime;       // Last modified timestamp of the file when it was added.
+			uint16_t format;         // DataFormat.
+			uint16_t flags;          // FileFlags.
+			uint32_t compressedSize; // Zero if not compressed.
+			uint32_t chunkSize;      // Zero if not compressed.
+			uint32_t firstChunk;     // First ChunkRecord of this file.
+			uint32_t numChunks;      // Zero if not compressed.
+
+			DataFormat getDataFormat() const noexcept { return static_cast<DataFormat>(format); }
+			bool isInvalidFile() const noexcept { return !!(flags & FileFlagInvalid); }
+			bool isCompressed()  const noexcept { return isDataFormatCompressed(getDataFormat()); }
+		};
+
+		struct ChunkRecord final
+		{
+			uint32_t uncompressedSize; // Note: sizes are the same if this chunk not compressed
+			uint32_t compressedSize;   // Size in bytes while compressed
+			uint32_t extraBytes;       // Extra bytes to read into the end to allow for decompression overhead
+			uint32_t offset;           // Offset from start of file data to this chunk (FileRecord::offset)
+
+			bool isCompressed() const noexcept { return uncompressedSize != compressedSize; }
+		};
+
+		//
+		// Sorted list of dir or file paths. A lightweight view
+		// into the Index, which must outlive it.
+		//
+		class PathList final
+		{
+		public:
+
+			class Iterator final
+			{
+			public:
+
+				Iterator(const PathList & l, const uint32_t i) noexcept : list(&l), position(i) { }
+				utils::StringView operator*() const { return (*list)[position]; }
+				Iterator & operator++() noexcept { ++position; return *this; }
+				bool operator == (const Iterator & other) const noexcept { return position == other.position; }
+				bool operator != (const Iterator & other) const noexcept { return position != other.position; }
+
+			private:
+
+				const PathList * list;
+				uint32_t         position;
+			};
+
+			PathList(const Index & idx, const uint32_t * sorted, const uint32_t count, const bool dirs) noexcept
+				: index(&idx), sortedRecords(sorted), numPaths(count), isDirList(dirs) { }
+
+			utils::StringView operator[](uint32_t i) const;
+			uint32_t getRecordIndex(uint32_t i) const noexcept { return sortedRecords[i]; } // For getDir()/getFile().
+			uint32_t size()  const noexcept { return numPaths; }
+			bool     empty() const noexcept { return numPaths == 0; }
+			Iterator begin() const noexcept { return Iterator(*this, 0); }
+			Iterator end()   const noexcept { return Iterator(*this, numPaths); }
+
+		private:
+
+			const Index *    index;
+			const uint32_t * sortedRecords;
+			uint32_t         numPaths;
+			bool             isDirList;
+		};
+
+		//
+		// The paths of a PathList that match a glob pattern (see utils::filesys::matchGlob()).
+		// Nothing is matched up front, the iterators skip to the next match as they advance.
+		// A view into the Index, like the PathList.
+		//
+		class GlobList final
+		{
+		public:
+
+			class Iterator final
+			{
+			public:
+
+				Iterator(const GlobList & l, const uint32_t i) noexcept : list(&l), position(i) { }
+				utils::StringView operator*() const { return list->candidates[position]; }
+				Iterator & operator++() { position = list->findNextMatch(position + 1); return *this; }
+				bool operator == (const Iterator & other) const noexcept { return position == other.position; }
+				bool operator != (const Iterator & other) const noexcept { return position != other.position; }
+				uint32_t getRecordIndex() const noexcept { return list->candidates.getRecordIndex(position); }
+
+			private:
+
+				const GlobList * list;
+				uint32_t         position;
+			};
+
+			GlobList(const PathList & paths, std::string globPattern)
+				: candidates(paths), pattern(std::move(globPattern)) { }
+
+			Iterator begin() const { return Iterator(*this, findNextMatch(0)); }
+			Iterator end()   const noexcept { return Iterator(*this, candidates.size()); }
+			bool     empty() const { return begin() == end(); }
+
+			// Paths that are tested against the pattern.
+			const PathList & getCandidates() const noexcept { return candidates; }
+
+		private:
+
+			uint32_t findNextMatch(uint32_t first) const;
+
+			PathList    candidates;
+			std::string pattern;
+		};
+
+		//
+		// Identifies the Tank an index was built from, so that a saved
+		// index can be matched against the Tank file before it is used.
+		//
+		struct SourceKey final
+		{
+			Guid     guid;          // Header::guid
+			uint32_t indexCrc32;    // Header::indexCrc32
+			uint32_t reserved;      // Always zero
+			uint64_t fileSizeBytes; // Size of the whole Tank file
+
+			static SourceKey fromTank(const TankFile & tank);
+			bool operator == (const SourceKey & other) const noexcept;
+		};
+
+		Index() = default;
+
+		// Builds the index from the parsed DirSet and FileSet of a Tank. Any previous contents
+		// are discarded. Throws TankFile::Error if the entries don't form a valid tree.
+		void build(const DirSet & dirSet, const FileSet & fileSet, const SourceKey & source);
+		void clear();
+
+		// Writes the index block as is to a file, which can later be memory mapped back by loadFromFile().
+		// The data is written to a temporary file that then replaces 'filename', so a copy of the same file
+		// already mapped by someone else is never modified. Returns false on failure, see filesys::getLastFileError().
+		bool saveToFile(const std::string & filename) const;
+
+		// Memory maps an index saved by saveToFile(). The block is used in place, no parsing
+		// or pointer fix-ups, but it is validated first and only accepted if built from the
+		// Tank identified by 'expectedSource'. Returns false and leaves the index empty otherwise.
+		bool loadFromFile(const std::string & filename, const SourceKey & expectedSource);
+
+		bool isEmpty() const noexcept { return blobHeader == nullptr; }
+
+		uint32_t getDirCount()   const noexcept;
+		uint32_t getFileCount()  const noexcept;
+		uint32_t getChunkCount() const noexcept;
+
+		const DirRecord   & getDir(uint32_t index)  const;
+		const FileRecord  & getFile(uint32_t index) const;
+		const ChunkRecord * getChunks(const FileRecord & file) const;
+
+		// Bytes taken by the file in the data section, from its offset to the end of
+		// the furthest chunk (compressed data plus extra bytes). Zero for invalid files.
+		uint32_t getStoredSize(const FileRecord & file) const;
+
+		// Index of a record returned by getDir()/getFile().
+		uint32_t getDirIndex(const DirRecord & dir)    const;
+		uint32_t getFileIndex(const FileRecord & file) const;
+
+		utils::StringView getPath(const DirRecord  & dir)  const;
+		utils::StringView getPath(const FileRecord & file) const;
+		utils::StringView getName(const DirRecord  & dir)  const;
+		utils::StringView getName(const FileRecord & file) const;
+
+		// Lookup by full path. Directory paths must end with a separator.
+		// Return InvalidIndex if not found.
+		uint32_t findFile(utils::StringView path) const;
+		uint32_t findDir(utils::StringView path)  const;
+
+		// All paths, sorted alphabetically.
+		PathList getFilePaths() const;
+		PathList getDirPaths()  const;
+
+		// Direct children of a directory, sorted alphabetically.
+		PathList getFilePaths(const DirRecord & dir) const;
+		PathList getSubdirPaths(const DirRecord & dir) const;
+
+		// Paths starting with 'prefix', sorted alphabetically. A directory path (with the trailing
+		// separator) gives its whole subtree. Found with a binary search of the sorted tables.
+		PathList getFilePathsWithPrefix(utils::StringView prefix) const;
+		PathList getDirPathsWithPrefix(utils::StringView prefix)  const;
+
+		// File paths matching a glob pattern, e.g. "/art/bitmaps/**/*.raw". Only the paths starting with
+		// the part of the pattern before the first wildcard ("/art/bitmaps/") are ever looked at.
+		GlobList getFilePathsMatching(const std::string & pattern) const;
+
+		// The whole index in a single block.
+		const uint8_t * getData()      const noexcept { return reinterpret_cast<const uint8_t *>(blobHeader); }
+		size_t          getSizeBytes() const noexcept;
+
+	private:
+
+		struct BlobHeader;
+
+		uint32_t findRecord(utils::StringView path, const uint32_t * sorted, uint32_t count, bool dirs) const;
+		PathList findPrefixRange(utils::StringView prefix, const uint32_t * sorted, uint32_t count, bool dirs) const;
+		void setBlob(const uint8_t * blob);
+		static bool isValidBlob(const uint8_t * blob, size_t sizeBytes);
+
+		// Owned copy of the block if built, or the mapping if loaded from file.
+		ByteArray               storage;
+		utils::MemoryMappedFile mappedStorage;
+		const BlobHeader  * blobHeader    = nullptr;
+		const DirRecord   * dirs          = nullptr;
+		const FileRecord  * files         = nullptr;
+		const ChunkRecord * chunks        = nullptr;
+		const uint32_t    * dirsByPath    = nullptr;
+		const uint32_t    * filesByPath   = nullptr;
+		const uint32_t    * dirsByParent  = nullptr;
+		const uint32_t    * filesByParent = nullptr;
+		const char        * strings       = nullptr;
+	};
+
 	// Asynchronous file operations with a TankFile.
 	using Task = std::future<bool>;
 
+	class ResourceStream;
+
 	//
 	// Reads the Tank file using a stream opened by a TankFile instance.
 	// This class is a friend of the TankFile class.
 	//
+	// Once indexed, all the const extraction methods only use positional
+	// reads on the TankFile, so any number of threads may extract resources
+	// from the same Reader and the same open TankFile at the same time.
+	//
 	class Reader final
 		: public utils::NonCopyable
 	{
 	public:
 
-		Reader() = default;
+		Reader();
+		~Reader();
 
 		// Calls indexFile().
 		Reader(TankFile & tank);
@@ -329,90 +605,635 @@ public:
 		// The file may be discarded after this method returns. Throws TankFile::Error on failure.
 		void indexFile(TankFile & tank);
 
+		// Same as indexFile(), but first tries to load the index from a cache file saved by a previous call.
+		// The cache is only used if it was built from the same Tank (same GUID, index CRC and file size).
+		// Otherwise the Tank is indexed normally and the cache file is (re)written. Failing to write the
+		// cache is not an error. Returns true if the index was loaded from the cache.
+		bool indexFileCached(TankFile & tank, const std::string & cacheFile);
+
+		// Cache file used by default for a Tank: the Tank's file name plus ".tidx".
+		static std::string getDefaultIndexCacheFile(const TankFile & tank);
+
 		// Attempts to extract a resource and write an uncompressed binary file with its contents.
 		// Might throw TankFile::Error if any step of the process should fail. Might also throw std::bad_alloc if out-of-memory.
 		// If 'validateCRCs' is true and the CRC32 of the file doesn't match the computed one, also fails with an exception.
 		// CRC32 of the extracted file is not computed if 'validateCRCs' is false.
-		void extractResourceToFile(TankFile & tank, const std::string & resourcePath,
+		void extractResourceToFile(const TankFile & tank, const std::string & resourcePath,
 		                           const std::string & destFile, bool validateCRCs) const;
 
-		// Same as extractResourceToFile() but writes the dest file as an async background task.
-		// Unlike the previous method however, this one DOES NOT throw and exception if the file can't be written.
-		// If the async IO fails, when the returned std::future is dereferenced, it will return a boolean
-		// with the result of the file write operation. Data is fetched from the Tank before spawning the thread,
-		// so an exception might still be thrown if data can't be read/decompressed from the source Tank.
-		Task extractResourceToFileAsync(TankFile & tank, const std::string & resourcePath,
+		// Same as extractResourceToFile() but reads, decompresses and writes the dest file as an async background task.
+		// Unlike the previous method however, this one DOES NOT throw and exception if the file can't be extracted or written.
+		// If the async extraction or IO fails, when the returned std::future is dereferenced, it will return a boolean
+		// with the result of the operation. An exception is still thrown right away if the resource doesn't exist.
+		// Both the Reader and the TankFile must stay alive until the returned task completes.
+		Task extractResourceToFileAsync(const TankFile & tank, const std::string & resourcePath,
 		                                const std::string & destFile, bool validateCRCs) const;
 
+		// Read-only window into the memory mapping of a Tank opened with IOMode::MemoryMapped.
+		// Only valid while the Tank file remains open.
+		struct ResourceView
+		{
+			const uint8_t * data;
+			size_t          size;
+		};
+
+		// Returns a zero-copy view of an uncompressed (DataFormat::Raw) resource stored in a memory mapped Tank.
+		// Throws TankFile::Error if the Tank is not memory mapped or if the resource is compressed.
+		// If 'validateCRCs' is true and the CRC32 of the file doesn't match the computed one, also fails with an exception.
+		ResourceView getResourceView(const TankFile & tank, const std::string & resourcePath, bool validateCRCs) const;
+
 		// Attempts to extract a resource to a memory buffer.
 		// Might throw TankFile::Error if the file cannot be extracted. Might also throw std::bad_alloc if out-of-memory.
 		// If 'validateCRCs' is true and the CRC32 of the file doesn't match the computed one, also fails with an exception.
 		// CRC32 of the extracted file is not computed if 'validateCRCs' is false.
-		ByteArray extractResourceToMemory(TankFile & tank, const std::string & resourcePath, bool validateCRCs) const;
+		ByteArray extractResourceToMemory(const TankFile & tank, const std::string & resourcePath, bool validateCRCs) const;
+
+		// Same as extractResourceToMemory(), but decompresses straight into a caller provided buffer, each chunk
+		// going to its final offset. Returns the number of bytes written, which is the resource size, or zero
+		// for invalid files. Throws TankFile::Error if 'bufferSizeBytes' is less than that.
+		size_t extractResourceInto(const TankFile & tank, const std::string & resourcePath, uint8_t * buffer,
+		                           size_t bufferSizeBytes, bool validateCRCs) const;
+
+		// Extracts just 'length' bytes starting at 'offset' of the uncompressed resource. Only the
+		// chunks that overlap the range are decompressed. The range is clipped to the end of the
+		// resource, so fewer bytes than asked might be returned. CRCs can't be validated for partial
+		// reads. Throws TankFile::Error if the resource is not found or if 'offset' is past its end.
+		ByteArray extractResourceRange(const TankFile & tank, const std::string & resourcePath,
+		                               uint32_t offset, uint32_t length) const;
 
 		// Extracts all files present in the Tank to the given path. Tank must have been previously indexed with indexFile().
 		// The name of the Tank minus its extension will be the first directory in the path hierarchy.
-		void extractWholeTank(TankFile & tank, const std::string & destPath, bool validateCRCs) const;
+		// The directory tree is created up front with createDirectoryTree(). Runs on extractAllResources(),
+		// so see it for how the work is split. Returns the number of files successfully written.
+		unsigned int extractWholeTank(const TankFile & tank, const std::string & destPath, bool validateCRCs) const;
+
+		// Creates the directories of the Tank under 'destPath', parents first, with one mkdir() each. They are
+		// added to 'dirCache', so resources written with dirCache.createPath() don't need to check their
+		// directories again. Throws siege::Exception if a directory can't be created.
+		void createDirectoryTree(const std::string & destPath, utils::filesys::DirectoryCache & dirCache) const;
+
+		// Threads of each stage of extractAllResources() and the number of read batches each queue
+		// between two stages can hold. Zero decode threads means one per JobSystem worker, minus the
+		// verify threads, so the stages doing CPU work don't ask for more threads than there are.
+		// The read and write stages mostly wait on the disk and are not counted.
+		struct PipelineConfig
+		{
+			unsigned int readThreads   = 1;
+			unsigned int decodeThreads = 0;
+			unsigned int verifyThreads = 1;
+			unsigned int writeThreads  = 2;
+			unsigned int queueDepth    = 16;
+		};
+		void setPipelineConfig(const PipelineConfig & config) noexcept { pipelineConfig = config; }
+		const PipelineConfig & getPipelineConfig() const noexcept { return pipelineConfig; }
+		unsigned int getDecodeThreadCount(const PipelineConfig & config) const;
+
+		// Contents of a resource going through extractAllResources(). Pooled buffers that don't
+		// zero-fill when they grow. Contents left in them are recycled after the sink's 'write'.
+		using ResourceBuffer = utils::BufferPool::Buffer;
+
+		// Where extractAllResources() sends each resource. 'write' is required, 'convert' is optional and
+		// runs after the CRC check, before 'write'. It also gets the stored bytes of the resource the read
+		// stage fetched (Index::getStoredSize() of them), or null if there are none, such as when an
+		// uncompressed resource was read straight into its contents. Both may change or take the contents. Either one
+		// returning false or throwing fails the resource. 'error' is optional and gets the reason of each
+		// failed resource, besides the SiegeError log. They are called from several threads at once.
+		// 'select' is also optional. It is called for every resource from the calling thread before
+		// anything is read, and the resources it returns false for are skipped altogether. 'outputName'
+		// is optional too. It gives the path, relative to the output, of the file 'write' makes of a
+		// resource, if not the resource path itself (e.g. a RAW texture saved as PNG).
+		struct ResourceSink
+		{
+			std::function<bool(const std::string & resourcePath, const Index::FileRecord & resFile)> select;
+			std::function<std::string(const std::string & resourcePath)> outputName;
+			std::function<bool(const std::string & resourcePath, const uint8_t * storedData, ResourceBuffer & contents)> convert;
+			std::function<bool(const std::string & resourcePath, ResourceBuffer & contents)> write;
+			std::function<void(const std::string & resourcePath, const std::string & errorText)> error;
+		};
 
-		// Directory and file lists for printing.
-		// NOTE: Lists are not sorted!
-		std::vector<std::string> getFileList() const;
-		std::vector<std::string> getDirectoryList() const;
+		// Totals of an extractAllResources() run. Stage times are the sum of the busy time of the
+		// stage's threads, not counting the time spent waiting on the queues or the memory budget.
+		struct ExtractionStats
+		{
+			unsigned int filesWritten      = 0;
+			unsigned int filesFailed       = 0;
+			uint64_t     readCalls         = 0; // Reads made by the read stage. None if memory mapped.
+			uint64_t     bytesRead         = 0; // Stored bytes fetched, including the gaps between resources.
+			uint64_t     bytesExtracted    = 0; // Decompressed bytes handed to the sink.
+			uint64_t     peakBytesInFlight = 0;
+			double       readSeconds       = 0.0;
+			double       decodeSeconds     = 0.0;
+			double       verifySeconds     = 0.0;
+			double       writeSeconds      = 0.0;
+			double       elapsedSeconds    = 0.0;
+		};
 
-		// Misc queries:
-		unsigned int getDirectoryCount() const noexcept { return (dirSet  != nullptr) ? dirSet->numDirs   : 0; }
-		unsigned int getFileCount()      const noexcept { return (fileSet != nullptr) ? fileSet->numFiles : 0; }
+		// Extracts every resource in the Tank through a pipeline of four stages, each with its own threads
+		// and a bounded queue in front of the next, so the disk and the CPUs are kept busy at the same time:
+		//  - read:   Fetches the stored data in the order it is in the Tank. Runs of neighboring resources
+		//            are fetched with a single read (see setMaxCoalescedReadSize()) and then passed from
+		//            stage to stage together.
+		//  - decode: Decompresses each resource into a pooled buffer, checksumming the chunks if fused.
+		//  - verify: Checks the CRC, if 'validateCRCs', then calls the sink's 'convert'.
+		//  - write:  Calls the sink's 'write'.
+		// A full queue stalls the stage feeding it, and the read stage also waits while the stored and
+		// decompressed bytes held by the pipeline would go over getMaxBytesInFlight(). Resources that fail
+		// are logged and counted, but don't stop the others. Blocks until all resources are done. An error
+		// outside of a single resource (e.g. out-of-memory) stops the whole pipeline and is rethrown here.
+		ExtractionStats extractAllResources(const TankFile & tank, const ResourceSink & sink, bool validateCRCs) const;
+
+		// What an incremental extraction did. Paths are sorted. Added and changed
+		// only list the resources written, the failed ones are in the stats.
+		struct IncrementalExtraction
+		{
+			std::vector<std::string> added;         // Not in the previous manifest.
+			std::vector<std::string> changed;       // CRC, size or time changed, or the output file is gone.
+			std::vector<std::string> removed;       // In the previous manifest but no longer in the Tank.
+			unsigned int             unchanged = 0; // Skipped.
+			ExtractionStats          stats;         // Of the added and changed resources.
+		};
 
-	private:
+		// Same as extractAllResources(), but skips the resources extracted by a previous run that haven't
+		// changed since. 'manifestFile' lists the CRC, size and time of each resource written by the last
+		// run. A resource is skipped, without being read or decompressed, if all three still match and
+		// its file, 'outputPath' + the sink's output name, still exists. The file must also have the same
+		// size (getExtractedSize(), so zero for invalid entries), unless the output name differs from the
+		// resource path (converted). A missing manifest
+		// extracts everything. The manifest is rewritten at the end, leaving out the resources that
+		// failed, so the next run retries them. Files of removed resources are not deleted.
+		IncrementalExtraction extractAllResourcesIncremental(const TankFile & tank, const ResourceSink & sink,
+		                                                     const std::string & outputPath, const std::string & manifestFile,
+		                                                     bool validateCRCs) const;
+
+		// extractWholeTank() on top of the above, with the manifest next to the output tree,
+		// at 'destPath' + tank name + ".manifest". Meant for dumping updated Tanks over and over.
+		IncrementalExtraction extractWholeTankIncremental(const TankFile & tank, const std::string & destPath, bool validateCRCs) const;
+
+		// Outcome of verify(). Resource failures are sorted by path. Problems with the Tank as a whole,
+		// such as a header CRC mismatch, go to 'tankErrors'. The header CRCs are only checked if the
+		// Tank has them (not InvalidChecksum).
+		struct VerifyReport
+		{
+			struct Failure
+			{
+				std::string resourcePath;
+				std::string errorText;
+			};
+
+			std::vector<Failure>     failures;
+			std::vector<std::string> tankErrors;
+			unsigned int             filesChecked       = 0;     // Including the failed ones.
+			unsigned int             invalidFiles       = 0;     // Marked FileFlagInvalid by the Tank builder. Skipped.
+			bool                     indexCrcChecked    = false;
+			bool                     dataCrcChecked     = false;
+			uint32_t                 computedIndexCrc32 = 0;
+			uint32_t                 computedDataCrc32  = 0;
+			uint64_t                 tankSizeBytes      = 0;
+			double                   elapsedSeconds     = 0.0;
+			ExtractionStats          stats;                      // Of the resource CRC pass.
+
+			bool passed() const noexcept { return failures.empty() && tankErrors.empty(); }
+
+			// Throughput over the whole Tank file.
+			double getMegabytesPerSecond() const noexcept
+			{
+				return (elapsedSeconds > 0.0) ? (tankSizeBytes / (1024.0 * 1024.0)) / elapsedSeconds : 0.0;
+			}
+		};
 
-		void readDirSet(TankFile & tank);
-		void readFileSet(TankFile & tank);
+		// Checks the integrity of the whole Tank without writing anything:
+		//  - The index and data CRCs of the header, each over its whole section. The data
+		//    section is split in blocks checksummed in parallel by the JobSystem.
+		//  - The chunk headers of every resource, which must add up to the resource size and
+		//    stay inside the data section. Resources that fail this are not decompressed.
+		//  - The CRC of every resource, decompressed by extractAllResources() with a sink that
+		//    throws the data away, so it runs in parallel with the same memory limits.
+		// Problems are reported, not thrown. Only an unreadable Tank throws TankFile::Error.
+		VerifyReport verify(const TankFile & tank) const;
+
+		// Options of transcodeToZip().
+		struct ZipOptions
+		{
+			// Deflate level of the files that are recompressed (see utils::compression::Level).
+			// Zero stores all files uncompressed, without passing anything through.
+			unsigned int compressionLevel = utils::compression::Level::DefaultCompression;
+
+			// Zlib resources have the Deflate data of their chunks joined and copied to the archive,
+			// without recompressing it (see utils::compression::DeflateStreamBuilder).
+			bool passThroughZlib = true;
+
+			// Files bigger than this are deflated in pieces of this size, joined into a single stream.
+			// The pieces are deflated one after the other by the convert thread, since the convert stage
+			// already works on as many resources at once as there are threads. Zero never splits a file.
+			uint32_t sliceSize = DefaultZipSliceSize;
+		};
+		static constexpr uint32_t DefaultZipSliceSize = 256 * 1024;
 
-		void buildDirPaths();
-		void buildFilePaths();
+		// Outcome of transcodeToZip(). Failures are sorted by path.
+		struct ZipReport
+		{
+			std::vector<VerifyReport::Failure> failures;
+			unsigned int    filesPassedThrough = 0; // Deflate data copied from the Tank.
+			unsigned int    filesDeflated      = 0; // Recompressed.
+			unsigned int    filesStored        = 0; // Empty, level zero or that didn't get smaller.
+			unsigned int    directories        = 0;
+			unsigned int    invalidFiles       = 0; // Marked FileFlagInvalid by the Tank builder. Skipped.
+			uint64_t        zipSizeBytes       = 0;
+			double          elapsedSeconds     = 0.0;
+			ExtractionStats stats;
+			PipelineConfig  pipelineConfig;         // Stages the run used.
+		};
 
-		struct TankEntry
+		// Writes every resource of the Tank to a ZIP archive, without going through the file system.
+		// The resources come from extractAllResources(), with their CRCs validated, and are compressed
+		// by its convert stage. The threads of the pipeline's CPU stages, one per JobSystem worker or
+		// PipelineConfig::decodeThreads, are split between decoding and deflating, which is slower and
+		// gets most of them. Big files are deflated in slices (see ZipOptions). The archive is
+		// written by a single thread in the order the data is stored in the Tank, so the same Tank and
+		// options always give the same archive. Directories get entries of their own. Resources that
+		// fail are reported and left out. Written to a temporary file renamed at the end, so a failed
+		// run doesn't leave a partial archive. Throws TankFile::Error if the archive can't be written.
+		ZipReport transcodeToZip(const TankFile & tank, const std::string & zipFile, const ZipOptions & options) const;
+
+		// Job system used by extractWholeTank(). If never set (or null), utils::JobSystem::getDefault() is used.
+		void setJobSystem(utils::JobSystem * jobs) noexcept { jobSystem = jobs; }
+		utils::JobSystem & getJobSystem() const { return (jobSystem != nullptr) ? *jobSystem : utils::JobSystem::getDefault(); }
+
+		// Cap on the stored and decompressed bytes held in memory by the bulk extraction
+		// before they are written out. Zero removes the limit.
+		void setMaxBytesInFlight(uint64_t maxBytes) noexcept { maxBytesInFlight = maxBytes; }
+		uint64_t getMaxBytesInFlight() const noexcept { return maxBytesInFlight; }
+		static constexpr uint64_t DefaultMaxBytesInFlight = 256 * 1024 * 1024;
+
+		// Compressed resources at least this big (uncompressed) and with more than one chunk
+		// have their chunks decompressed in parallel by the Reader's JobSystem, each chunk
+		// going straight to its final place in the output. Zero always decodes serially.
+		// extractAllResources() doesn't use it, as its decode stage already runs one
+		// resource per thread, and fanning out more jobs from each would oversubscribe.
+		void setParallelChunkDecodeThreshold(uint32_t minBytes) noexcept { parallelChunkDecodeThreshold = minBytes; }
+		uint32_t getParallelChunkDecodeThreshold() const noexcept { return parallelChunkDecodeThreshold; }
+		static constexpr uint32_t DefaultParallelChunkDecodeThreshold = 1024 * 1024;
+
+		// Largest read the bulk extraction makes to fetch several neighboring resources, or all the
+		// chunks of one, at once. Most of the small files are packed together at the front of the
+		// data section, so this replaces a lot of tiny reads with a few big sequential ones. Zero
+		// reads every resource on its own.
+		void setMaxCoalescedReadSize(uint32_t maxBytes) noexcept { maxCoalescedReadSize = maxBytes; }
+		uint32_t getMaxCoalescedReadSize() const noexcept { return maxCoalescedReadSize; }
+		static constexpr uint32_t DefaultMaxCoalescedReadSize = 1024 * 1024;
+
+		// When validating CRCs of compressed resources, checksum each chunk right after it is
+		// decompressed, while still in the CPU cache, and merge the chunk CRCs with
+		// utils::crc32::combine(). Otherwise the whole resource is checksummed in a second
+		// pass after extraction. On by default.
+		void setFusedChunkChecksums(bool fused) noexcept { fusedChunkChecksums = fused; }
+		bool getFusedChunkChecksums() const noexcept { return fusedChunkChecksums; }
+
+		// Optional LRU cache of decompressed chunks, shared by all the extraction methods and threads.
+		// Repeated reads of the same resource or of neighboring ranges skip the inflate when the
+		// chunks are still cached. Only compressed chunks are cached. Zero bytes (the default)
+		// disables and frees the cache. The cache is cleared when the Tank is re-indexed.
+		void setChunkCacheSize(uint64_t maxBytes);
+		uint64_t getChunkCacheSize() const noexcept;
+		void clearChunkCache();
+
+		struct ChunkCacheStats
 		{
-			// Pointer into dirSet.dirEntries[] or fileSet.fileEntries[].
-			union Entry
-			{
-				const DirEntry  * dir;
-				const FileEntry * file;
-			} ptr;
+			uint64_t hits;         // Chunks served from the cache.
+			uint64_t misses;       // Chunks decompressed and added to the cache.
+			uint64_t evictions;    // Least recently used chunks dropped to make room.
+			uint64_t bytesCached;  // Current size of the cached data.
+			uint64_t chunksCached; // Current number of cached chunks.
+		};
+		ChunkCacheStats getChunkCacheStats() const;
 
-			// Type tag to select from the pointers above.
-			enum Type
-			{
-				TypeDir,
-				TypeFile
-			} type;
+		// Optional trace of the resources opened through this Reader, for laying out a repacked Tank
+		// in the order they are used (see Writer::setPlacementOrder()). Every extraction, resource view
+		// and ResourceStream adds a record. Recording is thread safe, but the trace should only be
+		// enabled or disabled while nothing is being extracted. Disabling it discards the records.
+		struct AccessRecord
+		{
+			std::string resourcePath;
+			uint64_t    timeMicroseconds; // Since the trace was enabled.
+		};
+		void setAccessTraceEnabled(bool enable);
+		bool isAccessTraceEnabled() const noexcept { return accessTrace != nullptr; }
+		std::vector<AccessRecord> getAccessTrace() const; // Sorted by time.
+		void clearAccessTrace();
+
+		// Trace files are text, with one "<microseconds> <resource path>" line per record.
+		// Return false on failure, see filesys::getLastFileError() for I/O errors.
+		bool saveAccessTrace(const std::string & filename) const;
+		static bool loadAccessTrace(const std::string & filename, std::vector<AccessRecord> & records);
+
+		// Uncompressed size in bytes of a resource. Throws TankFile::Error if the resource is not in the Tank.
+		uint32_t getResourceSize(const TankFile & tank, const std::string & resourcePath) const;
+
+		// Directory and file paths, sorted alphabetically.
+		// These are views into the Reader's index, valid until the next indexFile().
+		Index::PathList getFileList() const { return index.getFilePaths(); }
+		Index::PathList getDirectoryList() const { return index.getDirPaths(); }
+
+		// Subdirectories and files right under one directory, sorted by name. Views into the index like the
+		// lists above, no paths are copied. 'dirPath' may omit the leading and trailing separators, so "art/maps"
+		// is "/art/maps/". The root is "/". Throws TankFile::Error if the directory is not in the Tank.
+		struct DirectoryListing
+		{
+			Index::PathList subdirs;
+			Index::PathList files;
+		};
+		DirectoryListing listDirectory(const std::string & dirPath) const;
 
-			TankEntry(const DirEntry * d)
-				: type(TypeDir) { ptr.dir = d; }
+		// Files whose path starts with 'prefix', e.g. "/art/bitmaps/" for a whole subtree, sorted alphabetically.
+		// Found with two binary searches. The leading separator may be omitted.
+		Index::PathList getFileListWithPrefix(const std::string & prefix) const;
 
-			TankEntry(const FileEntry * f)
-				: type(TypeFile) { ptr.file = f; }
+		// Files matching a glob pattern, e.g. "art/bitmaps/**/*.raw", in alphabetical order.
+		// See utils::filesys::matchGlob(). Matches are found as the list is iterated, and only
+		// among the files under the part of the pattern before the first wildcard.
+		Index::GlobList getFileListMatching(const std::string & pattern) const;
 
-			TankEntry() = default;
-		};
+		// File paths in the order their data is stored in the Tank, for reading it front to back.
+		// Paths repeated in the Tank are only listed once. Valid until the next indexFile().
+		std::vector<utils::StringView> getFileListInDataOrder() const;
+
+		// The compact index of the Tank.
+		const Index & getIndex() const noexcept { return index; }
+
+		// Misc queries:
+		unsigned int getDirectoryCount() const noexcept { return index.getDirCount();  }
+		unsigned int getFileCount()      const noexcept { return index.getFileCount(); }
+
+	private:
+
+		friend ResourceStream;
 
-		using FileTable  = std::unordered_map<std::string, TankEntry>;
 		using DirSetPtr  = std::unique_ptr<TankFile::DirSet>;
 		using FileSetPtr = std::unique_ptr<TankFile::FileSet>;
 
-		DirSetPtr  dirSet;
-		FileSetPtr fileSet;
-		FileTable  fileTable;
+		class IndexCursor;
+		class ChunkCache;
+		class AccessTrace;
+		static DirSetPtr  readDirSet(const TankFile & tank, IndexCursor & cursor);
+		static FileSetPtr readFileSet(const TankFile & tank, IndexCursor & cursor);
+
+		const Index::FileRecord & findFileEntry(const TankFile & tank, const std::string & resourcePath) const;
+
+		// Adds the resource to the access trace, if enabled.
+		void recordAccess(const Index::FileRecord & resFile) const;
+
+		// Number of bytes extracted for a file. Zero for invalid files.
+		static size_t getExtractedSize(const Index::FileRecord & resFile) noexcept;
+
+		// Indexes of the files that can be looked up by path, sorted by data offset.
+		std::vector<uint32_t> getFilesInDataOrder() const;
+
+		// extractAllResources() with its stages set by 'config' instead of getPipelineConfig().
+		ExtractionStats extractAllResources(const TankFile & tank, const ResourceSink & sink,
+		                                    bool validateCRCs, const PipelineConfig & config) const;
+
+		// Extracts a resource to 'dest', which must have room for getExtractedSize() bytes.
+		// If not null, 'storedData' has the Index::getStoredSize() bytes of the resource already
+		// read from the data section, otherwise they are read from the Tank as needed.
+		void extractResourceData(const TankFile & tank, const Index::FileRecord & resFile,
+		                         const std::string & resourcePath, uint8_t * dest, bool validateCRCs,
+		                         const uint8_t * storedData = nullptr) const;
+
+		// The decompression part of the above. If 'computeCrc' and the chunk checksums are fused, sets 'crcOut'
+		// to the CRC32 of the resource and returns true. Returns false if the CRC is left for the caller.
+		// 'parallelChunks' allows big resources to be decoded by chunk jobs (see setParallelChunkDecodeThreshold()).
+		bool decodeResourceData(const TankFile & tank, const Index::FileRecord & resFile,
+		                        const std::string & resourcePath, uint8_t * dest, bool computeCrc,
+		                        uint32_t & crcOut, const uint8_t * storedData, bool parallelChunks) const;
+
+		// Decompresses one chunk of a compressed resource into 'dest', which must have room for
+		// the chunk's uncompressedSize. 'compressedData' is scratch memory for non mapped Tanks.
+		// 'storedData' is the same as above.
+		void decompressChunk(const TankFile & tank, const Index::FileRecord & resFile, const std::string & resourcePath,
+		                     uint32_t chunkIndex, uint8_t * dest, ByteArray & compressedData,
+		                     const uint8_t * storedData = nullptr) const;
+
+		// Does the actual decompression of a compressed chunk for the above. Bypasses the chunk cache.
+		void decompressChunkData(const TankFile & tank, const Index::FileRecord & resFile, const std::string & resourcePath,
+		                         uint32_t chunkIndex, uint8_t * dest, ByteArray & compressedData,
+		                         const uint8_t * storedData) const;
+
+		Index index;
+		std::unique_ptr<ChunkCache> chunkCache; // Null if disabled.
+		std::unique_ptr<AccessTrace> accessTrace; // Null if disabled.
+
+		utils::JobSystem * jobSystem                    = nullptr;
+		uint64_t           maxBytesInFlight             = DefaultMaxBytesInFlight;
+		uint32_t           parallelChunkDecodeThreshold = DefaultParallelChunkDecodeThreshold;
+		uint32_t           maxCoalescedReadSize         = DefaultMaxCoalescedReadSize;
+		bool               fusedChunkChecksums          = true;
+		PipelineConfig     pipelineConfig;
+	};
+
+	//
+	// Sequential reader of a single resource that hands out the decompressed
+	// data one chunk at a time, so memory use doesn't grow with the resource size.
+	// Compressed resources are produced in the same chunks they were stored in,
+	// uncompressed ones in blocks of RawBlockSize bytes. Chunks stored without
+	// compression in a memory mapped Tank are handed out in-place, without copying.
+	//
+	// The Reader and the TankFile must outlive the stream. Any number of streams
+	// may be open at the same time, but each one must only be used by one thread.
+	//
+	class ResourceStream final
+		: public utils::NonCopyable
+	{
+	public:
+
+		static constexpr uint32_t RawBlockSize = 64 * 1024;
+
+		// Throws TankFile::Error if the resource is not in the Tank. If 'validateCRCs' is true,
+		// the CRC32 is accumulated as the chunks are read and checked when the last one is reached.
+		ResourceStream(const Reader & reader, const TankFile & tank,
+		               const std::string & resourcePath, bool validateCRCs);
+
+		// Decompresses the next chunk, which is then available with getChunkData()/getChunkSize()
+		// until the next call. Returns false once the whole resource was read. Throws TankFile::Error.
+		bool nextChunk();
+
+		const uint8_t * getChunkData() const noexcept { return chunkData; }
+		size_t          getChunkSize() const noexcept { return chunkSize; }
+
+		// Byte oriented alternative to nextChunk(). Copies up to 'numBytes' to 'buffer',
+		// fetching new chunks as needed. Returns the number of bytes copied, less than
+		// 'numBytes' only at the end of the resource. Throws TankFile::Error.
+		size_t read(void * buffer, size_t numBytes);
+
+		// Queries:
+		const std::string & getResourcePath() const noexcept { return resourcePath; }
+		uint32_t getResourceSize()  const noexcept { return resourceSize; } // Zero for invalid files.
+		uint64_t getBytesStreamed() const noexcept { return bytesStreamed; } // Total size of the chunks fetched so far.
+		bool     isAtEnd() const noexcept { return bytesStreamed == resourceSize && chunkReadPos == chunkSize; }
+
+	private:
+
+		const Reader &            reader;
+		const TankFile &          tank;
+		const std::string         resourcePath;
+		const Index::FileRecord & resFile;
+		const bool                validateCRCs;
+
+		uint32_t                  resourceSize   = 0;
+		uint32_t                  nextChunkIndex = 0;
+		uint32_t                  numChunks      = 0;
+		uint64_t                  bytesStreamed  = 0;
+		uint32_t                  runningCrc     = 0;
+
+		const uint8_t *           chunkData      = nullptr;
+		size_t                    chunkSize      = 0;
+		size_t                    chunkReadPos   = 0;
+		ByteArray                 chunkBuffer;
+		ByteArray                 compressedData;
+	};
+
+	//
+	// Builds a new Tank file from resources in memory or on disk.
+	//
+	// The layout follows the rules in "gpg/TankStructure.h": small files (under
+	// LargeFileSize) are placed first, then the large ones, each aligned to
+	// DataAlignment, with the data section starting at a DataSectionAlignment
+	// boundary and the DirSet/FileSet at the end. Compressed resources are split
+	// into chunks that are deflated in parallel by the Writer's JobSystem. Each
+	// compressed chunk keeps enough of its tail uncompressed (the chunk's extra
+	// bytes) for the game to inflate it in place.
+	//
+	// Paths are stored in lower case, as the game expects them. Resources copied
+	// from another Tank keep their stored data and entry, names included.
+	//
+	class Writer final
+		: public utils::NonCopyable
+	{
+	public:
+
+		Writer();
+		~Writer();
+
+		// Adds a resource with the given contents. 'resourcePath' is the full path inside
+		// the Tank, e.g.: "/art/maps/foo.gas". 'format' must be Raw or Zlib. Zlib resources
+		// that don't compress are stored Raw. A null 'fileTime' is replaced by the build time.
+		// Throws TankFile::Error if the path is not valid.
+		void addResource(const std::string & resourcePath, ByteArray contents,
+		                 DataFormat format = DataFormat::Zlib, FileTime fileTime = FileTime());
+
+		// Same as above, but the contents are only read from 'sourceFile' when the Tank is written.
+		// A null 'fileTime' is replaced by the last modification time of the file.
+		void addResourceFromFile(const std::string & resourcePath, const std::string & sourceFile,
+		                         DataFormat format = DataFormat::Zlib, FileTime fileTime = FileTime());
+
+		// Adds every file under 'sourceDir' and its subdirectories with addResourceFromFile(),
+		// placing them under 'tankDir' in the Tank. Returns the number of files added.
+		// Throws TankFile::Error if the directory can't be read.
+		unsigned int addResourcesFromDirectory(const std::string & sourceDir, const std::string & tankDir = "/",
+		                                       DataFormat format = DataFormat::Zlib);
+
+		// Copies a resource from another Tank exactly as stored: same chunks, size, CRC, format,
+		// flags and timestamp. Only its offset in the data section changes. The Reader and the
+		// TankFile must stay alive and open until writeTank() returns. Throws TankFile::Error.
+		void addResourceFromTank(const Reader & reader, const TankFile & tank, const std::string & resourcePath);
+
+		// Calls addResourceFromTank() for every file in the Tank and copies the descriptive parts
+		// of its header (priority, flags, versions, creator id and texts). Returns the number of files added.
+		unsigned int addAllResourcesFromTank(const Reader & reader, const TankFile & tank);
+
+		// Resources to place first in the data section, in this order. Meant for the order they
+		// are loaded in, e.g. from Reader::getAccessTrace(), so a load pattern reads the Tank
+		// mostly front to back. Repeated paths and paths never added are ignored. The remaining
+		// resources follow in the default layout.
+		void setPlacementOrder(const std::vector<std::string> & resourcePaths);
+
+		// Writes a Tank with all the resources added so far. The Tank is written to a temporary file
+		// that only replaces 'filename' once complete. Throws TankFile::Error on failure, including
+		// duplicate paths or a path that is both a file and a directory.
+		void writeTank(const std::string & filename);
+
+		// Header info copied to the Tank. Defaults to a 'DSig' Tank with User priority, created by 'USER'.
+		void setPriority(Priority priority) noexcept { header.priority = priority; }
+		void setTankFlags(uint32_t flags) noexcept { header.flags = flags; }
+		void setTitleText(const std::string & text);
+		void setAuthorText(const std::string & text);
+		void setCopyrightText(const std::string & text);
+		void setBuildText(const std::string & text);
+		void setDescriptionText(const std::string & text);
+
+		// Header of the last Tank written, with the offsets, CRCs, GUID and build time filled in.
+		const Header & getHeader() const noexcept { return header; }
+
+		// Zlib compression level, see utils::compression::Level.
+		void setCompressionLevel(unsigned int level) noexcept { compressionLevel = level; }
+		unsigned int getCompressionLevel() const noexcept { return compressionLevel; }
+
+		// Uncompressed size of the compressed chunks. Rounded up to a multiple of 4KB (the page size).
+		void setChunkSize(uint32_t sizeBytes) noexcept;
+		uint32_t getChunkSize() const noexcept { return chunkSize; }
+		static constexpr uint32_t DefaultChunkSize = 16 * 1024;
+
+		// Job system used to compress the chunks. If never set (or null), utils::JobSystem::getDefault() is used.
+		void setJobSystem(utils::JobSystem * jobs) noexcept { jobSystem = jobs; }
+		utils::JobSystem & getJobSystem() const { return (jobSystem != nullptr) ? *jobSystem : utils::JobSystem::getDefault(); }
+
+		// Cap on the uncompressed bytes being compressed or waiting to be written at any time. Zero removes the limit.
+		void setMaxBytesInFlight(uint64_t maxBytes) noexcept { maxBytesInFlight = maxBytes; }
+		uint64_t getMaxBytesInFlight() const noexcept { return maxBytesInFlight; }
+
+		// Resources added so far.
+		unsigned int getResourceCount() const noexcept { return static_cast<unsigned int>(resources.size()); }
+
+	private:
+
+		struct Resource
+		{
+			std::string path;       // Normalized, lower case.
+			std::string sourceFile; // Empty if the contents are in memory.
+			ByteArray   contents;
+			DataFormat  format;
+			FileTime    fileTime;
+			uint32_t    size;
+
+			// Resource copied as stored from another Tank if not null.
+			const Reader *   sourceReader    = nullptr;
+			const TankFile * sourceTank      = nullptr;
+			uint32_t         sourceFileIndex = 0;
+		};
+
+		struct PackedChunk;
+		struct PackedResource;
+		struct DirNode;
+
+		static std::string normalizePath(const std::string & resourcePath, bool lowerCase = true);
+		void loadContents(Resource & res) const;
+		void packChunk(const uint8_t * data, uint32_t sizeBytes, PackedChunk & chunk) const;
+		void startPacking(PackedResource & packed, utils::JobGroup & jobs);
+		void buildDirTree(const std::vector<uint32_t> & fileOrder, std::vector<DirNode> & dirsOut) const;
+		ByteArray buildIndex(const std::vector<PackedResource> & packed, const std::vector<DirNode> & dirs,
+		                     const std::vector<uint32_t> & fileOrder, FileTime buildFileTime,
+		                     uint32_t & dirSetSizeOut) const;
+
+		Header                   header;
+		std::vector<Resource>    resources;
+		std::vector<std::string> placementOrder;
+
+		utils::JobSystem *       jobSystem        = nullptr;
+		uint64_t                 maxBytesInFlight = Reader::DefaultMaxBytesInFlight;
+		uint32_t                 chunkSize        = DefaultChunkSize;
+		unsigned int             compressionLevel = utils::compression::Level::DefaultCompression;
 	};
 
 	// TankFile::Reader will have access to private data
 	// and methods of TankFile so that it can read the file.
+	// Writer reads the stored data of resources it copies.
 	friend Reader;
+	friend ResourceStream;
+	friend Writer;
 
 public:
 
 	// Opens a file for reading. File must exist. Throws TankFile::Error.
-	void openForReading(std::string filename);
+	void openForReading(std::string filename, IOMode ioMode = IOMode::Stream);
 
 	// Manually close the file (closed automatically by the destructor).
 	void close();
@@ -422,6 +1243,7 @@ public:
 	bool isReadOnly()  const noexcept;
 	bool isWriteOnly() const noexcept;
 	bool isReadWrite() const noexcept;
+	bool isMemoryMapped() const noexcept;
 
 	// Accessors:
 	size_t getFileSizeBytes()         const noexcept;
@@ -433,7 +1255,13 @@ private:
 	void queryFileSize();
 	void readAndValidateHeader();
 	void seekAbsoluteOffset(size_t offsetInBytes);
+	const uint8_t * getMappedBytes(size_t offsetInBytes, size_t numBytes) const;
 
+	// Positional read that doesn't touch the read cursor. Thread safe.
+	void readBytesAt(size_t offsetInBytes, void * buffer, size_t numBytes) const;
+
+	// Sequential reads starting from the cursor set by seekAbsoluteOffset().
+	// Only used while opening and indexing the file, so these are not thread safe.
 	void           readBytes(void * buffer, size_t numBytes);
 	uint16_t       readU16();
 	uint32_t       readU32();
@@ -446,11 +1274,15 @@ private:
 	Guid           readGuid();
 
 	using OpenMode = std::ios::open_mode;
-	std::ifstream  file;
 	std::string    fileName;
 	Header         fileHeader;
 	OpenMode       fileOpenMode = {};
 	size_t         fileSizeBytes = 0;
+	size_t         readCursor = 0;
+
+	// Only one of these is open, depending on the IOMode.
+	utils::RandomAccessFile file;
+	utils::MemoryMappedFile mappedFile;
 };
 
 } // namespace siege {}
@@ -0,0 +1,812 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: tank_file_index.cpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: TankFile::Index inner class implementation.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "siege/tank_file.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+namespace siege
+{
+
+// ========================================================
+// TankFile::Index::BlobHeader:
+// ========================================================
+
+//
+// First thing in the index block. Every offset is from the start of the block.
+// Layout: BlobHeader | DirRecords | FileRecords | ChunkRecords | dirsByPath | filesByPath |
+//         dirsByParent | filesByParent | strings
+//
+struct TankFile::Index::BlobHeader final
+{
+	static constexpr uint32_t Magic   = 0x58444954; // 'TIDX'
+	static constexpr uint32_t Version = 3;
+
+	// Sizes of the structures in the block. Saved indexes are only
+	// usable by builds where the records have the exact same layout.
+	static constexpr uint32_t LayoutId = uint32_t(sizeof(DirRecord)) | (uint32_t(sizeof(FileRecord)) << 8) |
+	                                     (uint32_t(sizeof(ChunkRecord)) << 16) | (uint32_t(sizeof(SourceKey)) << 24);
+
+	uint32_t  magic;
+	uint32_t  version;
+	uint32_t  layoutId;
+	uint32_t  sizeBytes;             // Size of the whole block, including this header.
+	SourceKey source;                // Tank this index was built from.
+	uint32_t  numDirs;
+	uint32_t  numFiles;
+	uint32_t  numChunks;
+	uint32_t  dirsOffset;            // DirRecord[numDirs]
+	uint32_t  filesOffset;           // FileRecord[numFiles]
+	uint32_t  chunksOffset;          // ChunkRecord[numChunks]
+	uint32_t  dirsByPathOffset;      // uint32_t[numDirs], dir indexes sorted by path
+	uint32_t  filesByPathOffset;     // uint32_t[numFiles], file indexes sorted by path
+	uint32_t  dirsByParentOffset;    // uint32_t[numDirs], dir indexes grouped by parent (DirRecord::firstSubdir)
+	uint32_t  filesByParentOffset;   // uint32_t[numFiles], file indexes grouped by parent (DirRecord::firstFile)
+	uint32_t  stringsOffset;         // Null terminated paths, back to back
+	uint32_t  stringsSize;
+};
+
+constexpr uint32_t TankFile::Index::InvalidIndex;
+constexpr uint32_t TankFile::Index::BlobHeader::Magic;
+constexpr uint32_t TankFile::Index::BlobHeader::Version;
+constexpr uint32_t TankFile::Index::BlobHeader::LayoutId;
+
+// ========================================================
+// Local helpers:
+// ========================================================
+
+namespace
+{
+
+inline uint32_t alignBlobOffset(const size_t offset) noexcept
+{
+	return static_cast<uint32_t>((offset + 3) & ~size_t(3));
+}
+
+// Fills 'sorted' with the indexes of 'records' ordered by path, then by index.
+template<class RecordType>
+void sortRecordsByPath(uint32_t * sorted, const uint32_t count, const RecordType * records, const char * strings)
+{
+	// Sorting a compact copy of the keys is a lot more cache friendly
+	// than going through the records on every comparison.
+	struct SortKey
+	{
+		utils::StringView path;
+		uint32_t index;
+	};
+
+	std::vector<SortKey> keys;
+	keys.reserve(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		keys.push_back({ utils::StringView(strings + records[i].pathOffset, records[i].pathLength), i });
+	}
+
+	std::sort(std::begin(keys), std::end(keys), [](const SortKey & a, const SortKey & b)
+	{
+		const int result = a.path.compare(b.path);
+		return (result != 0) ? (result < 0) : (a.index < b.index);
+	});
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		sorted[i] = keys[i].index;
+	}
+}
+
+// Fills 'byParent' with the indexes of 'byPath' grouped by parent directory, keeping the path
+// order, which is the name order, inside each group. Sets the range of each group in the parent's
+// DirRecord through 'first' and 'count'. Records without a parent go to 'orphansParent', if valid.
+template<class RecordType>
+void groupRecordsByParent(uint32_t * byParent, const uint32_t * byPath, const uint32_t numRecords,
+                          const RecordType * records, const uint32_t orphansParent,
+                          TankFile::Index::DirRecord * dirs, const uint32_t numDirs,
+                          uint32_t TankFile::Index::DirRecord::* first, uint32_t TankFile::Index::DirRecord::* count)
+{
+	const auto parentOf = [records, orphansParent](const uint32_t index)
+	{
+		const uint32_t parent = records[index].parentIndex;
+		return (parent != TankFile::Index::InvalidIndex) ? parent : orphansParent;
+	};
+
+	for (uint32_t d = 0; d < numDirs; ++d)
+	{
+		dirs[d].*count = 0;
+	}
+	for (uint32_t i = 0; i < numRecords; ++i)
+	{
+		const uint32_t parent = parentOf(byPath[i]);
+		if (parent != TankFile::Index::InvalidIndex)
+		{
+			++(dirs[parent].*count);
+		}
+	}
+
+	uint32_t groupStart = 0;
+	for (uint32_t d = 0; d < numDirs; ++d)
+	{
+		dirs[d].*first = groupStart;
+		groupStart += dirs[d].*count;
+		dirs[d].*count = 0;
+	}
+	for (uint32_t i = 0; i < numRecords; ++i)
+	{
+		const uint32_t parent = parentOf(byPath[i]);
+		if (parent != TankFile::Index::InvalidIndex)
+		{
+			byParent[dirs[parent].*first + (dirs[parent].*count)++] = byPath[i];
+		}
+	}
+}
+
+} // namespace {}
+
+// ========================================================
+// TankFile::Index:
+// ========================================================
+
+void TankFile::Index::build(const DirSet & dirSet, const FileSet & fileSet, const SourceKey & source)
+{
+	clear();
+
+	const uint32_t numDirs  = static_cast<uint32_t>(dirSet.dirEntries.size());
+	const uint32_t numFiles = static_cast<uint32_t>(fileSet.fileEntries.size());
+	const char pathSeparator = utils::filesys::getPathSeparator()[0];
+
+	// Parents are referenced by their offset in the DirSet.
+	std::unordered_map<uint32_t, uint32_t> dirIndexes;
+	dirIndexes.reserve(numDirs);
+	for (uint32_t d = 0; d < numDirs; ++d)
+	{
+		dirIndexes.emplace(dirSet.dirOffsets[d], d);
+	}
+
+	std::vector<uint32_t> dirParents(numDirs, InvalidIndex);
+	for (uint32_t d = 0; d < numDirs; ++d)
+	{
+		if (dirSet.dirEntries[d].isRoot())
+		{
+			continue;
+		}
+
+		const auto it = dirIndexes.find(dirSet.dirEntries[d].parentOffset);
+		if (it == std::end(dirIndexes))
+		{
+			SiegeThrow(TankFile::Error, "Found an orphan directory entry! '"
+					<< dirSet.dirEntries[d].name << "'.");
+		}
+		dirParents[d] = it->second;
+	}
+
+	// Path of each directory without the trailing separator. The root's path
+	// is empty. Each path is built once from its parent's, so resolving a
+	// directory only walks up to the nearest ancestor already resolved.
+	std::vector<std::string> dirPaths(numDirs);
+	std::vector<bool> resolved(numDirs, false);
+	std::vector<uint32_t> unresolvedChain;
+
+	for (uint32_t d = 0; d < numDirs; ++d)
+	{
+		unresolvedChain.clear();
+		for (uint32_t current = d; current != InvalidIndex && !resolved[current]; current = dirParents[current])
+		{
+			if (unresolvedChain.size() == numDirs)
+			{
+				SiegeThrow(TankFile::Error, "Directory entry '" << dirSet.dirEntries[d].name
+						<< "' has a cyclic parent chain!");
+			}
+			unresolvedChain.push_back(current);
+		}
+
+		// Root-most first, so every parent is ready before its children.
+		for (auto it = unresolvedChain.rbegin(); it != unresolvedChain.rend(); ++it)
+		{
+			if (dirParents[*it] != InvalidIndex)
+			{
+				dirPaths[*it] = dirPaths[dirParents[*it]] + pathSeparator + dirSet.dirEntries[*it].name;
+			}
+			resolved[*it] = true;
+		}
+	}
+
+	for (auto & path : dirPaths)
+	{
+		path += pathSeparator;
+	}
+
+	// File paths are the parent's path plus the file name. The
+	// root's path stands in for files that have a null parent.
+	const std::string rootPath(1, pathSeparator);
+	const auto fileDirPath = [&rootPath, &dirPaths](const uint32_t parentIndex) -> const std::string &
+	{
+		return (parentIndex != InvalidIndex) ? dirPaths[parentIndex] : rootPath;
+	};
+
+	std::vector<uint32_t> fileParents(numFiles, InvalidIndex);
+	size_t stringsSize = 0;
+	uint32_t numChunks = 0;
+
+	for (uint32_t f = 0; f < numFiles; ++f)
+	{
+		const FileEntry & fileEntry = fileSet.fileEntries[f];
+
+		const auto it = dirIndexes.find(fileEntry.parentOffset);
+		if (it != std::end(dirIndexes))
+		{
+			fileParents[f] = it->second;
+		}
+		else if (fileEntry.parentOffset != 0)
+		{
+			SiegeThrow(TankFile::Error, "Found an orphan file entry! '"
+					<< fileEntry.name << "' (parentOffset = " << fileEntry.parentOffset << ")");
+		}
+		stringsSize += fileDirPath(fileParents[f]).length() + fileEntry.name.length() + 1;
+
+		if (fileEntry.isCompressed() && fileEntry.size != 0)
+		{
+			const auto & compressedHeader = fileEntry.getCompressedHeader();
+			if (compressedHeader.chunkHeaders.size() != compressedHeader.numChunks)
+			{
+				SiegeThrow(TankFile::Error, "File entry '" << fileEntry.name << "' has "
+						<< compressedHeader.chunkHeaders.size() << " chunk headers, expected "
+						<< compressedHeader.numChunks << "!");
+			}
+			numChunks += compressedHeader.numChunks;
+		}
+	}
+
+	for (const auto & path : dirPaths)
+	{
+		stringsSize += path.length() + 1;
+	}
+
+	// Work out the layout of the block:
+	BlobHeader header;
+	header.magic               = BlobHeader::Magic;
+	header.version             = BlobHeader::Version;
+	header.layoutId            = BlobHeader::LayoutId;
+	header.source              = source;
+	header.numDirs             = numDirs;
+	header.numFiles            = numFiles;
+	header.numChunks           = numChunks;
+	header.dirsOffset          = alignBlobOffset(sizeof(BlobHeader));
+	header.filesOffset         = alignBlobOffset(header.dirsOffset          + size_t(numDirs)   * sizeof(DirRecord));
+	header.chunksOffset        = alignBlobOffset(header.filesOffset         + size_t(numFiles)  * sizeof(FileRecord));
+	header.dirsByPathOffset    = alignBlobOffset(header.chunksOffset        + size_t(numChunks) * sizeof(ChunkRecord));
+	header.filesByPathOffset   = alignBlobOffset(header.dirsByPathOffset    + size_t(numDirs)   * sizeof(uint32_t));
+	header.dirsByParentOffset  = alignBlobOffset(header.filesByPathOffset   + size_t(numFiles)  * sizeof(uint32_t));
+	header.filesByParentOffset = alignBlobOffset(header.dirsByParentOffset  + size_t(numDirs)   * sizeof(uint32_t));
+	header.stringsOffset       = alignBlobOffset(header.filesByParentOffset + size_t(numFiles)  * sizeof(uint32_t));
+	header.stringsSize         = static_cast<uint32_t>(stringsSize);
+
+	const size_t totalSize = size_t(header.stringsOffset) + stringsSize;
+	if (totalSize > UINT32_MAX)
+	{
+		SiegeThrow(TankFile::Error, "Tank index is too big (" << totalSize << " bytes)!");
+	}
+	header.sizeBytes = static_cast<uint32_t>(totalSize);
+
+	// And fill it in:
+	storage.assign(totalSize, 0);
+	uint8_t * const blob = storage.data();
+	std::memcpy(blob, &header, sizeof(header));
+
+	auto * const outDirs   = reinterpret_cast<DirRecord   *>(blob + header.dirsOffset);
+	auto * const outFiles  = reinterpret_cast<FileRecord  *>(blob + header.filesOffset);
+	auto * const outChunks = reinterpret_cast<ChunkRecord *>(blob + header.chunksOffset);
+	char * const outStrings = reinterpret_cast<char *>(blob + header.stringsOffset);
+	uint32_t stringsUsed = 0;
+
+	// Appends the concatenation of 'a' and 'b' plus a null terminator to the arena.
+	const auto addString = [outStrings, &stringsUsed](const std::string & a, const std::string & b) -> uint32_t
+	{
+		const uint32_t strOffset = stringsUsed;
+		std::memcpy(outStrings + strOffset, a.data(), a.length());
+		std::memcpy(outStrings + strOffset + a.length(), b.data(), b.length());
+		outStrings[strOffset + a.length() + b.length()] = '\0';
+		stringsUsed += static_cast<uint32_t>(a.length() + b.length() + 1);
+		return strOffset;
+	};
+
+	for (uint32_t d = 0; d < numDirs; ++d)
+	{
+		const DirEntry & dirEntry = dirSet.dirEntries[d];
+		DirRecord & dir = outDirs[d];
+
+		dir.parentIndex  = dirParents[d];
+		dir.dirSetOffset = dirSet.dirOffsets[d];
+		dir.pathOffset   = addString(dirPaths[d], std::string());
+		dir.pathLength   = static_cast<uint32_t>(dirPaths[d].length());
+		dir.fileTime     = dirEntry.fileTime;
+
+		if (dir.isRoot())
+		{
+			dir.nameOffset = dir.pathOffset;
+			dir.nameLength = dir.pathLength;
+		}
+		else
+		{
+			// Last path component, minus the trailing separator.
+			dir.nameLength = static_cast<uint32_t>(dirEntry.name.length());
+			dir.nameOffset = dir.pathOffset + dir.pathLength - 1 - dir.nameLength;
+		}
+	}
+
+	uint32_t chunksUsed = 0;
+	for (uint32_t f = 0; f < numFiles; ++f)
+	{
+		const FileEntry & fileEntry = fileSet.fileEntries[f];
+		FileRecord & file = outFiles[f];
+
+		file.parentIndex = fileParents[f];
+		file.pathOffset  = addString(fileDirPath(fileParents[f]), fileEntry.name);
+		file.pathLength  = static_cast<uint32_t>(fileDirPath(fileParents[f]).length() + fileEntry.name.length());
+		file.nameLength  = static_cast<uint32_t>(fileEntry.name.length());
+		file.nameOffset  = file.pathOffset + file.pathLength - file.nameLength;
+		file.size        = fileEntry.size;
+		file.offset      = fileEntry.offset;
+		file.crc32       = fileEntry.crc32;
+		file.fileTime    = fileEntry.fileTime;
+		file.format      = static_cast<uint16_t>(fileEntry.format);
+		file.flags       = static_cast<uint16_t>(fileEntry.flags);
+		file.firstChunk  = chunksUsed;
+
+		if (fileEntry.isCompressed() && fileEntry.size != 0)
+		{
+			const auto & compressedHeader = fileEntry.getCompressedHeader();
+			file.compressedSize = compressedHeader.compressedSize;
+			file.chunkSize      = compressedHeader.chunkSize;
+			file.numChunks      = compressedHeader.numChunks;
+
+			for (const auto & chunkHeader : compressedHeader.chunkHeaders)
+			{
+				ChunkRecord & chunk = outChunks[chunksUsed++];
+				chunk.uncompressedSize = chunkHeader.uncompressedSize;
+				chunk.compressedSize   = chunkHeader.compressedSize;
+				chunk.extraBytes       = chunkHeader.extraBytes;
+				chunk.offset           = chunkHeader.offset;
+			}
+		}
+	}
+
+	assert(chunksUsed == numChunks);
+	assert(stringsUsed == stringsSize);
+
+	// Lookup tables sorted by path. Ties are broken by record index, so for
+	// duplicate paths the first entry in the Tank is the one that is found.
+	auto * const outDirsByPath  = reinterpret_cast<uint32_t *>(blob + header.dirsByPathOffset);
+	auto * const outFilesByPath = reinterpret_cast<uint32_t *>(blob + header.filesByPathOffset);
+
+	sortRecordsByPath(outDirsByPath,  numDirs,  outDirs,  outStrings);
+	sortRecordsByPath(outFilesByPath, numFiles, outFiles, outStrings);
+
+	// Children of each directory. Files with a null parent have the root's
+	// path, so they are listed under the first root, the one findDir() gets.
+	auto * const outDirsByParent  = reinterpret_cast<uint32_t *>(blob + header.dirsByParentOffset);
+	auto * const outFilesByParent = reinterpret_cast<uint32_t *>(blob + header.filesByParentOffset);
+
+	const auto firstRoot = std::find(std::begin(dirParents), std::end(dirParents), InvalidIndex);
+	const uint32_t rootIndex = (firstRoot != std::end(dirParents)) ?
+			static_cast<uint32_t>(firstRoot - std::begin(dirParents)) : InvalidIndex;
+
+	groupRecordsByParent(outDirsByParent, outDirsByPath, numDirs, outDirs, InvalidIndex,
+			outDirs, numDirs, &DirRecord::firstSubdir, &DirRecord::numSubdirs);
+	groupRecordsByParent(outFilesByParent, outFilesByPath, numFiles, outFiles, rootIndex,
+			outDirs, numDirs, &DirRecord::firstFile, &DirRecord::numFiles);
+
+	setBlob(blob);
+}
+
+void TankFile::Index::clear()
+{
+	storage.clear();
+	storage.shrink_to_fit();
+	mappedStorage.unmap();
+
+	blobHeader  = nullptr;
+	dirs        = nullptr;
+	files       = nullptr;
+	chunks      = nullptr;
+	dirsByPath    = nullptr;
+	filesByPath   = nullptr;
+	dirsByParent  = nullptr;
+	filesByParent = nullptr;
+	strings       = nullptr;
+}
+
+bool TankFile::Index::saveToFile(const std::string & filename) const
+{
+	assert(!filename.empty());
+	if (isEmpty())
+	{
+		errno = EINVAL;
+		return false;
+	}
+
+	// Never write over the destination directly. Another
+	// process could have it memory mapped at this moment.
+	const std::string tempFilename = filename + ".tmp";
+	{
+		std::ofstream outFile;
+		if (!utils::filesys::tryOpen(outFile, tempFilename, std::ofstream::binary))
+		{
+			return false;
+		}
+
+		outFile.write(reinterpret_cast<const char *>(getData()), getSizeBytes());
+		outFile.close();
+
+		if (outFile.fail())
+		{
+			std::remove(tempFilename.c_str());
+			return false;
+		}
+	}
+
+	return utils::filesys::replaceFile(tempFilename, filename);
+}
+
+bool TankFile::Index::loadFromFile(const std::string & filename, const SourceKey & expectedSource)
+{
+	clear();
+
+	if (!mappedStorage.mapForReading(filename))
+	{
+		return false;
+	}
+
+	const uint8_t * const blob = mappedStorage.getData();
+	if (!isValidBlob(blob, mappedStorage.getSizeBytes()) ||
+	    !(reinterpret_cast<const BlobHeader *>(blob)->source == expectedSource))
+	{
+		mappedStorage.unmap();
+		return false;
+	}
+
+	setBlob(blob);
+	return true;
+}
+
+void TankFile::Index::setBlob(const uint8_t * const blob)
+{
+	const auto * header = reinterpret_cast<const BlobHeader *>(blob);
+
+	blobHeader    = header;
+	dirs          = reinterpret_cast<const DirRecord   *>(blob + header->dirsOffset);
+	files         = reinterpret_cast<const FileRecord  *>(blob + header->filesOffset);
+	chunks        = reinterpret_cast<const ChunkRecord *>(blob + header->chunksOffset);
+	dirsByPath    = reinterpret_cast<const uint32_t    *>(blob + header->dirsByPathOffset);
+	filesByPath   = reinterpret_cast<const uint32_t    *>(blob + header->filesByPathOffset);
+	dirsByParent  = reinterpret_cast<const uint32_t    *>(blob + header->dirsByParentOffset);
+	filesByParent = reinterpret_cast<const uint32_t    *>(blob + header->filesByParentOffset);
+	strings       = reinterpret_cast<const char        *>(blob + header->stringsOffset);
+}
+
+bool TankFile::Index::isValidBlob(const uint8_t * const blob, const size_t sizeBytes)
+{
+	// Everything in the block gets used without further checks,
+	// so make sure no record points outside of it. This only touches
+	// the fixed size records, the strings are never scanned.
+	if (blob == nullptr || sizeBytes < sizeof(BlobHeader) ||
+	   (reinterpret_cast<uintptr_t>(blob) & (alignof(BlobHeader) - 1)) != 0)
+	{
+		return false;
+	}
+
+	const auto & header = *reinterpret_cast<const BlobHeader *>(blob);
+	if (header.magic != BlobHeader::Magic || header.version != BlobHeader::Version ||
+	    header.layoutId != BlobHeader::LayoutId || header.sizeBytes != sizeBytes)
+	{
+		return false;
+	}
+
+	const auto sectionFits = [&header](const uint32_t offset, const uint32_t count, const size_t elementSize)
+	{
+		return (offset % 4) == 0 && offset >= sizeof(BlobHeader) &&
+		       (uint64_t(offset) + uint64_t(count) * elementSize) <= header.stringsOffset;
+	};
+
+	if (!sectionFits(header.dirsOffset,          header.numDirs,   sizeof(DirRecord))   ||
+	    !sectionFits(header.filesOffset,         header.numFiles,  sizeof(FileRecord))  ||
+	    !sectionFits(header.chunksOffset,        header.numChunks, sizeof(ChunkRecord)) ||
+	    !sectionFits(header.dirsByPathOffset,    header.numDirs,   sizeof(uint32_t))    ||
+	    !sectionFits(header.filesByPathOffset,   header.numFiles,  sizeof(uint32_t))    ||
+	    !sectionFits(header.dirsByParentOffset,  header.numDirs,   sizeof(uint32_t))    ||
+	    !sectionFits(header.filesByParentOffset, header.numFiles,  sizeof(uint32_t)))
+	{
+		return false;
+	}
+
+	if ((uint64_t(header.stringsOffset) + header.stringsSize) != sizeBytes ||
+	    (header.stringsSize != 0 && blob[sizeBytes - 1] != '\0'))
+	{
+		return false;
+	}
+
+	const auto stringFits = [&header](const uint32_t offset, const uint32_t length)
+	{
+		return (uint64_t(offset) + length) < header.stringsSize;
+	};
+
+	const auto * dirRecords = reinterpret_cast<const DirRecord *>(blob + header.dirsOffset);
+	for (uint32_t d = 0; d < header.numDirs; ++d)
+	{
+		const DirRecord & dir = dirRecords[d];
+		if ((dir.parentIndex != InvalidIndex && dir.parentIndex >= header.numDirs) ||
+		    !stringFits(dir.pathOffset, dir.pathLength) || !stringFits(dir.nameOffset, dir.nameLength) ||
+		    (uint64_t(dir.firstSubdir) + dir.numSubdirs) > header.numDirs ||
+		    (uint64_t(dir.firstFile) + dir.numFiles) > header.numFiles)
+		{
+			return false;
+		}
+	}
+
+	const auto * fileRecords = reinterpret_cast<const FileRecord *>(blob + header.filesOffset);
+	for (uint32_t f = 0; f < header.numFiles; ++f)
+	{
+		const FileRecord & file = fileRecords[f];
+		if ((file.parentIndex != InvalidIndex && file.parentIndex >= header.numDirs) ||
+		    !stringFits(file.pathOffset, file.pathLength) || !stringFits(file.nameOffset, file.nameLength) ||
+		    (uint64_t(file.firstChunk) + file.numChunks) > header.numChunks)
+		{
+			return false;
+		}
+	}
+
+	const auto * sortedDirs   = reinterpret_cast<const uint32_t *>(blob + header.dirsByPathOffset);
+	const auto * sortedFiles  = reinterpret_cast<const uint32_t *>(blob + header.filesByPathOffset);
+	const auto * groupedDirs  = reinterpret_cast<const uint32_t *>(blob + header.dirsByParentOffset);
+	const auto * groupedFiles = reinterpret_cast<const uint32_t *>(blob + header.filesByParentOffset);
+	for (uint32_t d = 0; d < header.numDirs; ++d)
+	{
+		if (sortedDirs[d] >= header.numDirs || groupedDirs[d] >= header.numDirs)
+		{
+			return false;
+		}
+	}
+	for (uint32_t f = 0; f < header.numFiles; ++f)
+	{
+		if (sortedFiles[f] >= header.numFiles || groupedFiles[f] >= header.numFiles)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+uint32_t TankFile::Index::getDirCount() const noexcept
+{
+	return (blobHeader != nullptr) ? blobHeader->numDirs : 0;
+}
+
+uint32_t TankFile::Index::getFileCount() const noexcept
+{
+	return (blobHeader != nullptr) ? blobHeader->numFiles : 0;
+}
+
+uint32_t TankFile::Index::getChunkCount() const noexcept
+{
+	return (blobHeader != nullptr) ? blobHeader->numChunks : 0;
+}
+
+size_t TankFile::Index::getSizeBytes() const noexcept
+{
+	return (blobHeader != nullptr) ? blobHeader->sizeBytes : 0;
+}
+
+const TankFile::Index::DirRecord & TankFile::Index::getDir(const uint32_t index) const
+{
+	assert(index < getDirCount());
+	return dirs[index];
+}
+
+const TankFile::Index::FileRecord & TankFile::Index::getFile(const uint32_t index) const
+{
+	assert(index < getFileCount());
+	return files[index];
+}
+
+const TankFile::Index::ChunkRecord * TankFile::Index::getChunks(const FileRecord & file) const
+{
+	assert(file.firstChunk + file.numChunks <= getChunkCount());
+	return chunks + file.firstChunk;
+}
+
+uint32_t TankFile::Index::getStoredSize(const FileRecord & file) const
+{
+	if (file.isInvalidFile())
+	{
+		return 0;
+	}
+	if (!file.isCompressed())
+	{
+		return file.size;
+	}
+
+	// Chunks might not be in order, so up to the end of the furthest one.
+	uint32_t storedSize = 0;
+	const ChunkRecord * fileChunks = getChunks(file);
+	for (uint32_t c = 0; c < file.numChunks; ++c)
+	{
+		const uint32_t extraBytes = fileChunks[c].isCompressed() ? fileChunks[c].extraBytes : 0;
+		storedSize = std::max(storedSize, fileChunks[c].offset + fileChunks[c].compressedSize + extraBytes);
+	}
+	return storedSize;
+}
+
+uint32_t TankFile::Index::getDirIndex(const DirRecord & dir) const
+{
+	assert(&dir >= dirs && &dir < dirs + getDirCount());
+	return static_cast<uint32_t>(&dir - dirs);
+}
+
+uint32_t TankFile::Index::getFileIndex(const FileRecord & file) const
+{
+	assert(&file >= files && &file < files + getFileCount());
+	return static_cast<uint32_t>(&file - files);
+}
+
+utils::StringView TankFile::Index::getPath(const DirRecord & dir) const
+{
+	return utils::StringView(strings + dir.pathOffset, dir.pathLength);
+}
+
+utils::StringView TankFile::Index::getPath(const FileRecord & file) const
+{
+	return utils::StringView(strings + file.pathOffset, file.pathLength);
+}
+
+utils::StringView TankFile::Index::getName(const DirRecord & dir) const
+{
+	return utils::StringView(strings + dir.nameOffset, dir.nameLength);
+}
+
+utils::StringView TankFile::Index::getName(const FileRecord & file) const
+{
+	return utils::StringView(strings + file.nameOffset, file.nameLength);
+}
+
+uint32_t TankFile::Index::findFile(const utils::StringView path) const
+{
+	return findRecord(path, filesByPath, getFileCount(), false);
+}
+
+uint32_t TankFile::Index::findDir(const utils::StringView path) const
+{
+	return findRecord(path, dirsByPath, getDirCount(), true);
+}
+
+uint32_t TankFile::Index::findRecord(const utils::StringView path, const uint32_t * sorted,
+                                     const uint32_t count, const bool isDir) const
+{
+	const auto pathOf = [this, isDir](const uint32_t index) -> utils::StringView
+	{
+		return isDir ? getPath(dirs[index]) : getPath(files[index]);
+	};
+
+	const uint32_t * const first = sorted;
+	const uint32_t * const last  = sorted + count;
+
+	const uint32_t * it = std::lower_bound(first, last, path,
+		[&pathOf](const uint32_t index, const utils::StringView key) { return pathOf(index) < key; });
+
+	if (it == last || pathOf(*it) != path)
+	{
+		return InvalidIndex;
+	}
+	return *it;
+}
+
+TankFile::Index::PathList TankFile::Index::getFilePaths() const
+{
+	return PathList(*this, filesByPath, getFileCount(), false);
+}
+
+TankFile::Index::PathList TankFile::Index::getDirPaths() const
+{
+	return PathList(*this, dirsByPath, getDirCount(), true);
+}
+
+TankFile::Index::PathList TankFile::Index::getFilePaths(const DirRecord & dir) const
+{
+	assert(&dir >= dirs && &dir < dirs + getDirCount());
+	return PathList(*this, filesByParent + dir.firstFile, dir.numFiles, false);
+}
+
+TankFile::Index::PathList TankFile::Index::getSubdirPaths(const DirRecord & dir) const
+{
+	assert(&dir >= dirs && &dir < dirs + getDirCount());
+	return PathList(*this, dirsByParent + dir.firstSubdir, dir.numSubdirs, true);
+}
+
+TankFile::Index::PathList TankFile::Index::getFilePathsWithPrefix(const utils::StringView prefix) const
+{
+	return findPrefixRange(prefix, filesByPath, getFileCount(), false);
+}
+
+TankFile::Index::PathList TankFile::Index::getDirPathsWithPrefix(const utils::StringView prefix) const
+{
+	return findPrefixRange(prefix, dirsByPath, getDirCount(), true);
+}
+
+TankFile::Index::GlobList TankFile::Index::getFilePathsMatching(const std::string & pattern) const
+{
+	const size_t literalLength = utils::filesys::getGlobLiteralPrefixLength(pattern);
+	return GlobList(getFilePathsWithPrefix(utils::StringView(pattern).substr(0, literalLength)), pattern);
+}
+
+TankFile::Index::PathList TankFile::Index::findPrefixRange(const utils::StringView prefix, const uint32_t * sorted,
+                                                           const uint32_t count, const bool isDir) const
+{
+	const auto pathOf = [this, isDir](const uint32_t index) -> utils::StringView
+	{
+		return isDir ? getPath(dirs[index]) : getPath(files[index]);
+	};
+
+	// Paths sharing a prefix are next to each other in the sorted table.
+	const uint32_t * const first = std::lower_bound(sorted, sorted + count, prefix,
+		[&pathOf](const uint32_t index, const utils::StringView key) { return pathOf(index) < key; });
+
+	const uint32_t * const last = std::partition_point(first, sorted + count,
+		[&pathOf, prefix](const uint32_t index) { return pathOf(index).startsWith(prefix); });
+
+	return PathList(*this, first, static_cast<uint32_t>(last - first), isDir);
+}
+
+// ========================================================
+// TankFile::Index::GlobList:
+// ========================================================
+
+uint32_t TankFile::Index::GlobList::findNextMatch(uint32_t first) const
+{
+	while (first < candidates.size() && !utils::filesys::matchGlob(pattern, candidates[first]))
+	{
+		++first;
+	}
+	return first;
+}
+
+// ========================================================
+// TankFile::Index::SourceKey:
+// ========================================================
+
+TankFile::Index::SourceKey TankFile::Index::SourceKey::fromTank(const TankFile & tank)
+{
+	SourceKey key;
+	key.guid          = tank.getFileHeader().guid;
+	key.indexCrc32    = tank.getFileHeader().indexCrc32;
+	key.reserved      = 0;
+	key.fileSizeBytes = tank.getFileSizeBytes();
+	return key;
+}
+
+bool TankFile::Index::SourceKey::operator == (const SourceKey & other) const noexcept
+{
+	return std::memcmp(&guid, &other.guid, sizeof(Guid)) == 0 &&
+	       indexCrc32 == other.indexCrc32 && fileSizeBytes == other.fileSizeBytes;
+}
+
+// ========================================================
+// TankFile::Index::PathList:
+// ========================================================
+
+utils::StringView TankFile::Index::PathList::operator[](const uint32_t i) const
+{
+	assert(i < numPaths);
+	return isDirList ? index->getPath(index->getDir(sortedRecords[i])) :
+	                   index->getPath(index->getFile(sortedRecords[i]));
+}
+
+} // namespace siege {}
@@ -13,6 +13,14 @@
 
 #include "siege/tank_file.hpp"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <list>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace siege
 {
@@ -26,15 +34,420 @@ namespace siege
 	#endif // TankReaderLog
 #endif // SIEGE_TANK_DEBUG
 
+// ========================================================
+// TankFile::Reader::IndexCursor:
+// ========================================================
+
+//
+// Bounds-checked sequential reads over the in-memory index region of a Tank.
+// Offsets are absolute file offsets, same as the ones in the Tank header.
+//
+class TankFile::Reader::IndexCursor final
+	: public utils::NonCopyable
+{
+public:
+
+	IndexCursor(const uint8_t * data, const size_t sizeBytes, const size_t baseOffset)
+		: indexData(data)
+		, indexSize(sizeBytes)
+		, indexBaseOffset(baseOffset)
+		, readPosition(0)
+	{ }
+
+	void seekAbsoluteOffset(const size_t offsetInBytes)
+	{
+		if (offsetInBytes < indexBaseOffset || (offsetInBytes - indexBaseOffset) > indexSize)
+		{
+			SiegeThrow(TankFile::Error, "Offset " << offsetInBytes << " is outside of the Tank index ["
+					<< indexBaseOffset << ", " << (indexBaseOffset + indexSize) << ")!");
+		}
+		readPosition = offsetInBytes - indexBaseOffset;
+	}
+
+	const uint8_t * readBytes(const size_t numBytes)
+	{
+		if (numBytes > (indexSize - readPosition))
+		{
+			SiegeThrow(TankFile::Error, "Read of " << numBytes << " bytes at offset "
+					<< (indexBaseOffset + readPosition) << " overruns the Tank index!");
+		}
+
+		const uint8_t * dataPtr = indexData + readPosition;
+		readPosition += numBytes;
+		return dataPtr;
+	}
+
+	uint16_t readU16()
+	{
+		uint16_t x;
+		std::memcpy(&x, readBytes(sizeof(x)), sizeof(x));
+		return x;
+	}
+
+	uint32_t readU32()
+	{
+		uint32_t x;
+		std::memcpy(&x, readBytes(sizeof(x)), sizeof(x));
+		return x;
+	}
+
+	FileTime readFileTime()
+	{
+		FileTime ft;
+		std::memcpy(&ft, readBytes(sizeof(ft)), sizeof(ft));
+		return ft;
+	}
+
+	// Same layout as TankFile::readNString(): a word with the length in
+	// chars, then the chars plus a null terminator, padded to a dword.
+	std::string readNString()
+	{
+		const uint16_t lenInChars = readU16();
+		const size_t paddedLen = ((lenInChars + 2) / 4 + 1) * 4 - 2;
+
+		const char * chars = reinterpret_cast<const char *>(readBytes(paddedLen));
+		return std::string(chars, std::find(chars, chars + std::min<size_t>(lenInChars, paddedLen), '\0'));
+	}
+
+private:
+
+	const uint8_t * indexData;
+	const size_t    indexSize;
+	const size_t    indexBaseOffset;
+	size_t          readPosition;
+};
+
+// ========================================================
+// TankFile::Reader::ChunkCache:
+// ========================================================
+
+//
+// Size-bounded LRU map of (tank, file, chunk) => decompressed chunk.
+// Chunks are reference counted, so one can still be copied out after
+// being evicted by another thread. All methods are thread safe.
+//
+class TankFile::Reader::ChunkCache final
+	: public utils::NonCopyable
+{
+public:
+
+	using ChunkPtr = std::shared_ptr<const ByteArray>;
+
+	struct Key
+	{
+		const TankFile * tank;
+		uint32_t         fileIndex;
+		uint32_t         chunkIndex;
+
+		bool operator == (const Key & other) const noexcept
+		{
+			return tank == other.tank && fileIndex == other.fileIndex && chunkIndex == other.chunkIndex;
+		}
+	};
+
+	explicit ChunkCache(const uint64_t maxBytes)
+		: maxBytesCached(maxBytes)
+	{ }
+
+	uint64_t getMaxBytes() const noexcept { return maxBytesCached; }
+
+	void setMaxBytes(const uint64_t maxBytes)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		maxBytesCached = maxBytes;
+		evictToFit(0);
+	}
+
+	// Null if not cached. Counts a hit or a miss.
+	ChunkPtr find(const Key & key)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		const auto it = entries.find(key);
+		if (it == std::end(entries))
+		{
+			++stats.misses;
+			return nullptr;
+		}
+
+		// Move to the front, the most recently used position.
+		lruList.splice(std::begin(lruList), lruList, it->second);
+		++stats.hits;
+		return it->second->chunk;
+	}
+
+	void insert(const Key & key, ChunkPtr chunk)
+	{
+		const uint64_t chunkBytes = chunk->size();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (chunkBytes > maxBytesCached || entries.find(key) != std::end(entries))
+		{
+			return; // Too big to ever fit or already added by another thread.
+		}
+
+		evictToFit(chunkBytes);
+		lruList.push_front({ key, std::move(chunk) });
+		entries.emplace(key, std::begin(lruList));
+
+		stats.bytesCached += chunkBytes;
+		++stats.chunksCached;
+	}
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.clear();
+		lruList.clear();
+		stats.bytesCached  = 0;
+		stats.chunksCached = 0;
+	}
+
+	ChunkCacheStats getStats() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return stats;
+	}
+
+private:
+
+	struct Entry
+	{
+		Key      key;
+		ChunkPtr chunk;
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key & key) const noexcept
+		{
+			const size_t h = std::hash<const void *>()(key.tank);
+			return h ^ ((size_t(key.fileIndex) << 16) + key.chunkIndex + 0x9E3779B9 + (h << 6) + (h >> 2));
+		}
+	};
+
+	// Drops least recently used chunks until 'numBytes' more can fit. Caller holds the lock.
+	void evictToFit(const uint64_t numBytes)
+	{
+		while (!lruList.empty() && (stats.bytesCached + numBytes) > maxBytesCached)
+		{
+			const Entry & oldest = lruList.back();
+			stats.bytesCached -= oldest.chunk->size();
+			--stats.chunksCached;
+			++stats.evictions;
+
+			entries.erase(oldest.key);
+			lruList.pop_back();
+		}
+	}
+
+	mutable std::mutex mutex;
+	uint64_t           maxBytesCached;
+	ChunkCacheStats    stats = {};
+	std::list<Entry>   lruList; // Front is the most recently used.
+	std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> entries;
+};
+
+// ========================================================
+// TankFile::Reader::AccessTrace:
+// ========================================================
+
+//
+// Time ordered log of the resources opened through a Reader.
+// All methods are thread safe.
+//
+class TankFile::Reader::AccessTrace final
+	: public utils::NonCopyable
+{
+public:
+
+	using Clock = std::chrono::steady_clock;
+
+	AccessTrace()
+		: startTime(Clock::now())
+	{ }
+
+	void record(const utils::StringView resourcePath)
+	{
+		const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - startTime);
+		AccessRecord rec = { resourcePath.toString(), static_cast<uint64_t>(elapsed.count()) };
+
+		std::lock_guard<std::mutex> lock(mutex);
+		records.push_back(std::move(rec));
+	}
+
+	std::vector<AccessRecord> getRecords() const
+	{
+		std::vector<AccessRecord> sorted;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			sorted = records;
+		}
+
+		// Threads may take the lock out of order.
+		std::stable_sort(std::begin(sorted), std::end(sorted), [](const AccessRecord & a, const AccessRecord & b)
+		{
+			return a.timeMicroseconds < b.timeMicroseconds;
+		});
+		return sorted;
+	}
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		records.clear();
+	}
+
+private:
+
+	mutable std::mutex        mutex;
+	const Clock::time_point   startTime;
+	std::vector<AccessRecord> records;
+};
+
 // ========================================================
 // TankFile::Reader:
 // ========================================================
 
+constexpr uint64_t TankFile::Reader::DefaultMaxBytesInFlight;
+constexpr uint32_t TankFile::Reader::DefaultParallelChunkDecodeThreshold;
+constexpr uint32_t TankFile::Reader::DefaultMaxCoalescedReadSize;
+
+TankFile::Reader::Reader()
+{
+}
+
 TankFile::Reader::Reader(TankFile & tank)
 {
 	indexFile(tank);
 }
 
+TankFile::Reader::~Reader()
+{
+}
+
+void TankFile::Reader::setChunkCacheSize(const uint64_t maxBytes)
+{
+	if (maxBytes == 0)
+	{
+		chunkCache.reset();
+	}
+	else if (chunkCache == nullptr)
+	{
+		chunkCache.reset(new ChunkCache(maxBytes));
+	}
+	else
+	{
+		chunkCache->setMaxBytes(maxBytes);
+	}
+}
+
+uint64_t TankFile::Reader::getChunkCacheSize() const noexcept
+{
+	return (chunkCache != nullptr) ? chunkCache->getMaxBytes() : 0;
+}
+
+void TankFile::Reader::clearChunkCache()
+{
+	if (chunkCache != nullptr)
+	{
+		chunkCache->clear();
+	}
+}
+
+TankFile::Reader::ChunkCacheStats TankFile::Reader::getChunkCacheStats() const
+{
+	if (chunkCache != nullptr)
+	{
+		return chunkCache->getStats();
+	}
+	const ChunkCacheStats noStats = {};
+	return noStats;
+}
+
+void TankFile::Reader::setAccessTraceEnabled(const bool enable)
+{
+	if (!enable)
+	{
+		accessTrace.reset();
+	}
+	else if (accessTrace == nullptr)
+	{
+		accessTrace.reset(new AccessTrace());
+	}
+}
+
+std::vector<TankFile::Reader::AccessRecord> TankFile::Reader::getAccessTrace() const
+{
+	if (accessTrace != nullptr)
+	{
+		return accessTrace->getRecords();
+	}
+	return {};
+}
+
+void TankFile::Reader::clearAccessTrace()
+{
+	if (accessTrace != nullptr)
+	{
+		accessTrace->clear();
+	}
+}
+
+bool TankFile::Reader::saveAccessTrace(const std::string & filename) const
+{
+	std::ofstream outFile;
+	if (!utils::filesys::tryOpen(outFile, filename))
+	{
+		return false;
+	}
+
+	for (const AccessRecord & rec : getAccessTrace())
+	{
+		outFile << rec.timeMicroseconds << " " << rec.resourcePath << "\n";
+	}
+	return outFile.good();
+}
+
+bool TankFile::Reader::loadAccessTrace(const std::string & filename, std::vector<AccessRecord> & records)
+{
+	records.clear();
+
+	std::ifstream inFile;
+	if (!utils::filesys::tryOpen(inFile, filename))
+	{
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(inFile, line))
+	{
+		if (line.empty())
+		{
+			continue;
+		}
+
+		// "<microseconds> <resource path>", the path being the rest of the line.
+		char * pathStart = nullptr;
+		const uint64_t timeMicroseconds = std::strtoull(line.c_str(), &pathStart, 10);
+		if (pathStart == line.c_str() || *pathStart != ' ' || pathStart[1] == '\0')
+		{
+			SiegeWarn("Malformed line in access trace \"" << filename << "\": \"" << line << "\"");
+			records.clear();
+			return false;
+		}
+
+		AccessRecord rec = { std::string(pathStart + 1), timeMicroseconds };
+		records.push_back(std::move(rec));
+	}
+
+	std::stable_sort(std::begin(records), std::end(records), [](const AccessRecord & a, const AccessRecord & b)
+	{
+		return a.timeMicroseconds < b.timeMicroseconds;
+	});
+	return true;
+}
+
 void TankFile::Reader::indexFile(TankFile & tank)
 {
 	if (!tank.isOpen())
@@ -51,23 +464,86 @@ void TankFile::Reader::indexFile(TankFile & tank)
 	TankReaderLog("Preparing to index Tank file...");
 
 	// Discard current metadata, if any, before loading new.
-	dirSet  = nullptr;
-	fileSet = nullptr;
-	fileTable.clear();
+	index.clear();
+	clearChunkCache();
+
+	// The DirSet and FileSet are stored back to back, either between the header
+	// and the data section or after the data section, at the end of the file.
+	// The whole region is brought in with a single read (or just pointed to if
+	// the Tank is mapped) and then parsed from memory.
+	const auto fileSize = tank.getFileSizeBytes();
+	const auto & header = tank.getFileHeader();
+	const size_t indexStart = std::min(header.dirsetOffset, header.filesetOffset);
+	const size_t indexEnd   = (indexStart < header.dataOffset) ? header.dataOffset : fileSize;
+
+	if (indexStart == 0 || indexStart >= indexEnd || indexEnd > fileSize)
+	{
+		SiegeThrow(TankFile::Error, "Tank file \"" << tank.getFileName() << "\" has an invalid index region: ["
+				<< indexStart << ", " << indexEnd << ")!");
+	}
+
+	ByteArray indexBuffer;
+	const uint8_t * indexData;
+	if (tank.isMemoryMapped())
+	{
+		indexData = tank.getMappedBytes(indexStart, indexEnd - indexStart);
+	}
+	else
+	{
+		indexBuffer.resize(indexEnd - indexStart);
+		tank.readBytesAt(indexStart, indexBuffer.data(), indexBuffer.size());
+		indexData = indexBuffer.data();
+	}
+
+	IndexCursor cursor(indexData, indexEnd - indexStart, indexStart);
+	const DirSetPtr  dirSet  = readDirSet(tank, cursor);
+	const FileSetPtr fileSet = readFileSet(tank, cursor);
+
+	// The parsed sets are only needed to build the compact index.
+	index.build(*dirSet, *fileSet, Index::SourceKey::fromTank(tank));
+
+	TankReaderLog("Tank indexed. " << index.getDirCount() << " dirs, " << index.getFileCount()
+			<< " files. Index size: " << utils::formatMemoryUnit(index.getSizeBytes()));
+}
+
+bool TankFile::Reader::indexFileCached(TankFile & tank, const std::string & cacheFile)
+{
+	if (!tank.isOpen())
+	{
+		SiegeThrow(TankFile::Error, "Tank file \"" << tank.getFileName() << "\" is not open!");
+	}
+
+	clearChunkCache();
+	if (index.loadFromFile(cacheFile, Index::SourceKey::fromTank(tank)))
+	{
+		TankReaderLog("Tank index loaded from cache \"" << cacheFile << "\". " << index.getDirCount()
+				<< " dirs, " << index.getFileCount() << " files.");
+		return true;
+	}
+
+	indexFile(tank);
+
+	if (!index.saveToFile(cacheFile))
+	{
+		SiegeWarn("Unable to write Tank index cache \"" << cacheFile << "\": " << utils::filesys::getLastFileError());
+	}
+	return false;
+}
 
-	readDirSet(tank);
-	readFileSet(tank);
+std::string TankFile::Reader::getDefaultIndexCacheFile(const TankFile & tank)
+{
+	return tank.getFileName() + ".tidx";
 }
 
-void TankFile::Reader::readDirSet(TankFile & tank)
+TankFile::Reader::DirSetPtr TankFile::Reader::readDirSet(const TankFile & tank, IndexCursor & cursor)
 {
 	const auto fileSize = tank.getFileSizeBytes();
 	const auto & header = tank.getFileHeader();
 
-	tank.seekAbsoluteOffset(header.dirsetOffset); // Seek DirSet position.
+	cursor.seekAbsoluteOffset(header.dirsetOffset); // Seek DirSet position.
 
-	const auto numDirectories = tank.readU32();
-	dirSet.reset(new DirSet(numDirectories));
+	const auto numDirectories = cursor.readU32();
+	DirSetPtr dirSet(new DirSet(numDirectories));
 
 	TankReaderLog("====== readDirSet() ======");
 	TankReaderLog("numDirectories = " << numDirectories);
@@ -76,7 +552,7 @@ void TankFile::Reader::readDirSet(TankFile & tank)
 	// Scan dir offset list:
 	for (uint32_t d = 0; d < numDirectories; ++d)
 	{
-		const auto dirOffs = tank.readU32();
+		const auto dirOffs = cursor.readU32();
 		if (dirOffs == TankFile::InvalidOffset || (header.dirsetOffset + dirOffs) > fileSize)
 		{
 			SiegeThrow(TankFile::Error, "Invalid directory offset: " << dirOffs);
@@ -90,12 +566,12 @@ void TankFile::Reader::readDirSet(TankFile & tank)
 	for (uint32_t d = 0; d < numDirectories; ++d)
 	{
 		const auto dirOffs = dirSet->dirOffsets[d];
-		tank.seekAbsoluteOffset(header.dirsetOffset + dirOffs);
+		cursor.seekAbsoluteOffset(header.dirsetOffset + dirOffs);
 
-		const auto dirParentOffset = tank.readU32();
-		const auto dirChildCount   = tank.readU32();
-		const auto dirFileTime     = tank.readFileTime();
-		dirEntryName               = tank.readNString();
+		const auto dirParentOffset = cursor.readU32();
+		const auto dirChildCount   = cursor.readU32();
+		const auto dirFileTime     = cursor.readFileTime();
+		dirEntryName               = cursor.readNString();
 
 		// Validate parent offset:
 		if (dirParentOffset == TankFile::InvalidOffset || (header.dirsetOffset + dirParentOffset) > fileSize)
@@ -114,7 +590,7 @@ void TankFile::Reader::readDirSet(TankFile & tank)
 		childOffsets.reserve(dirChildCount);
 		for (uint32_t c = 0; c < dirChildCount; ++c)
 		{
-			const auto childOffs = tank.readU32();
+			const auto childOffs = cursor.readU32();
 			if (childOffs == TankFile::InvalidOffset || (header.dirsetOffset + childOffs) > fileSize)
 			{
 				SiegeThrow(TankFile::Error, "Invalid directory child offset: " << childOffs);
@@ -134,19 +610,18 @@ void TankFile::Reader::readDirSet(TankFile & tank)
 		assert(childOffsets.empty());
 	}
 
-	// Fill 'fileTable' with the full directory paths:
-	buildDirPaths();
+	return dirSet;
 }
 
-void TankFile::Reader::readFileSet(TankFile & tank)
+TankFile::Reader::FileSetPtr TankFile::Reader::readFileSet(const TankFile & tank, IndexCursor & cursor)
 {
 	const auto fileSize = tank.getFileSizeBytes();
 	const auto & header = tank.getFileHeader();
 
-	tank.seekAbsoluteOffset(header.filesetOffset); // Seek FileSet position.
+	cursor.seekAbsoluteOffset(header.filesetOffset); // Seek FileSet position.
 
-	const auto numFiles = tank.readU32();
-	fileSet.reset(new FileSet(numFiles));
+	const auto numFiles = cursor.readU32();
+	FileSetPtr fileSet(new FileSet(numFiles));
 
 	TankReaderLog("====== readFileSet() ======");
 	TankReaderLog("numFiles = " << numFiles);
@@ -155,7 +630,7 @@ void TankFile::Reader::readFileSet(TankFile & tank)
 	// Scan file offset list:
 	for (uint32_t f = 0; f < numFiles; ++f)
 	{
-		const auto fileOffs = tank.readU32();
+		const auto fileOffs = cursor.readU32();
 		if (fileOffs == TankFile::InvalidOffset || (header.filesetOffset + fileOffs) > fileSize)
 		{
 			SiegeThrow(TankFile::Error, "Invalid file offset: " << fileOffs);
@@ -168,16 +643,16 @@ void TankFile::Reader::readFileSet(TankFile & tank)
 	for (uint32_t f = 0; f < numFiles; ++f)
 	{
 		const auto fileOffs = fileSet->fileOffsets[f];
-		tank.seekAbsoluteOffset(header.filesetOffset + fileOffs);
+		cursor.seekAbsoluteOffset(header.filesetOffset + fileOffs);
 
-		const auto fileParentOffset = tank.readU32();
-		const auto fileEntrySize    = tank.readU32();
-		const auto fileDataOffset   = tank.readU32();
-		const auto fileCrc32        = tank.readU32();
-		const auto fileTime         = tank.readFileTime();
-		const auto fileFormat       = tank.readU16();
-		const auto fileFlags        = tank.readU16();
-		fileEntryName               = tank.readNString();
+		const auto fileParentOffset = cursor.readU32();
+		const auto fileEntrySize    = cursor.readU32();
+		const auto fileDataOffset   = cursor.readU32();
+		const auto fileCrc32        = cursor.readU32();
+		const auto fileTime         = cursor.readFileTime();
+		const auto fileFormat       = cursor.readU16();
+		const auto fileFlags        = cursor.readU16();
+		fileEntryName               = cursor.readNString();
 
 		// Validate parent offset:
 		if (fileParentOffset == TankFile::InvalidOffset ||
@@ -206,8 +681,8 @@ void TankFile::Reader::readFileSet(TankFile & tank)
 		// We need to grab the compressed header for the compressed file entries.
 		if (TankFile::isDataFormatCompressed(fileDataFormat) && fileEntrySize != 0)
 		{
-			const auto compressedSize = tank.readU32();
-			const auto chunkSize      = tank.readU32();
+			const auto compressedSize = cursor.readU32();
+			const auto chunkSize      = cursor.readU32();
 
 			assert(compressedSize < fileSize);
 			FileEntry & fileEntry = fileSet->fileEntries.back();
@@ -219,10 +694,10 @@ void TankFile::Reader::readFileSet(TankFile & tank)
 			const auto numChunks = fileEntry.getCompressedHeader().numChunks;
 			for (uint32_t c = 0; c < numChunks; ++c)
 			{
-				const auto uncompressedBytes = tank.readU32();
-				const auto compressedBytes   = tank.readU32();
-				const auto extraBytes        = tank.readU32();
-				const auto offset            = tank.readU32();
+				const auto uncompressedBytes = cursor.readU32();
+				const auto compressedBytes   = cursor.readU32();
+				const auto extraBytes        = cursor.readU32();
+				const auto offset            = cursor.readU32();
 
 				// Add to compressedHeader:
 				fileEntry.getCompressedHeader().chunkHeaders.emplace_back(
@@ -231,8 +706,7 @@ void TankFile::Reader::readFileSet(TankFile & tank)
 		}
 	}
 
-	// Add full file paths to 'fileTable':
-	buildFilePaths();
+	return fileSet;
 }
 
 // ========================================================
@@ -242,29 +716,7 @@ void TankFile::Reader::readFileSet(TankFile & tank)
 namespace
 {
 
-void buildPathRecursive(const size_t entryIndex, const TankFile::DirSet & dirSet, std::string & path)
-{
-	if (dirSet.dirEntries[entryIndex].parentOffset == 0)
-	{
-		return; // Is the root directory.
-	}
-
-	const auto parentIter = std::find(std::begin(dirSet.dirOffsets),
-			std::end(dirSet.dirOffsets), dirSet.dirEntries[entryIndex].parentOffset);
-
-	if (parentIter == std::end(dirSet.dirOffsets))
-	{
-		SiegeThrow(TankFile::Error, "Found an orphan directory entry! '"
-				<< dirSet.dirEntries[entryIndex].name << "'.");
-	}
-
-	const auto parentIndex = std::distance(std::begin(dirSet.dirOffsets), parentIter);
-
-	buildPathRecursive(parentIndex, dirSet, path);
-	path += utils::filesys::getPathSeparator() + dirSet.dirEntries[entryIndex].name;
-}
-
-bool writeResourceFile(const std::string & destFileName, ByteArray fileContents)
+bool writeResourceFile(const std::string & destFileName, const uint8_t * fileContents, const size_t sizeBytes)
 {
 	std::ofstream outFile;
 	if (!utils::filesys::tryOpen(outFile, destFileName, std::ofstream::binary))
@@ -273,76 +725,42 @@ bool writeResourceFile(const std::string & destFileName, ByteArray fileContents)
 		return false;
 	}
 
-	if (fileContents.empty())
+	if (sizeBytes == 0)
 	{
 		SiegeWarn("Written an empty resource file...");
 		return true;
 	}
 
-	if (!outFile.write(reinterpret_cast<const char *>(fileContents.data()), fileContents.size()))
+	if (!outFile.write(reinterpret_cast<const char *>(fileContents), sizeBytes))
 	{
-		SiegeError("Failed to write " << fileContents.size() << " bytes to file \"" << destFileName << "\"!");
+		SiegeError("Failed to write " << sizeBytes << " bytes to file \"" << destFileName << "\"!");
 		return false;
 	}
 
 	return true;
 }
 
-} // namespace {}
-
-// ========================================================
-
-void TankFile::Reader::buildDirPaths()
+bool writeResourceFile(const std::string & destFileName, const ByteArray & fileContents)
 {
-	TankReaderLog("Building master directory table...");
-
-	std::string fullPath;
-	for (uint32_t d = 0; d < dirSet->numDirs; ++d)
-	{
-		fullPath.clear();
-		buildPathRecursive(d, *dirSet, fullPath);
-		fullPath += utils::filesys::getPathSeparator();
-
-		fileTable.emplace(fullPath, TankEntry(&dirSet->dirEntries[d]));
-
-		TankReaderLog("Dir: " << fullPath.c_str());
-	}
+	return writeResourceFile(destFileName, fileContents.data(), fileContents.size());
 }
 
-void TankFile::Reader::buildFilePaths()
+void checkResourceCrc(const std::string & resourcePath, const uint32_t contentsCrc, const uint32_t expectedCrc)
 {
-	TankReaderLog("Building master file table...");
-
-	std::string fullPath;
-	for (uint32_t f = 0; f < fileSet->numFiles; ++f)
+	if (contentsCrc != expectedCrc)
 	{
-		fullPath.clear();
-
-		// We don't need to do all that work if the file is at the root.
-		if (fileSet->fileEntries[f].parentOffset != 0)
-		{
-			const auto parentIter = std::find(std::begin(dirSet->dirOffsets),
-					std::end(dirSet->dirOffsets), fileSet->fileEntries[f].parentOffset);
-
-			if (parentIter == std::end(dirSet->dirOffsets))
-			{
-				SiegeThrow(TankFile::Error, "Found an orphan file entry! '"
-						<< fileSet->fileEntries[f].name << "' (parentOffset = "
-						<< fileSet->fileEntries[f].parentOffset << ")");
-			}
-
-			const auto parentIndex = std::distance(std::begin(dirSet->dirOffsets), parentIter);
-			buildPathRecursive(parentIndex, *dirSet, fullPath);
-		}
-
-		fullPath += utils::filesys::getPathSeparator() + fileSet->fileEntries[f].name;
-		fileTable.emplace(fullPath, TankEntry(&fileSet->fileEntries[f]));
+		auto errorInfo = utils::format("Tank resource \"%s\" CRC (0x%08X) does not match the expected (0x%08X)!",
+				resourcePath.c_str(), contentsCrc, expectedCrc);
 
-		TankReaderLog("File: " << fullPath.c_str());
+		SiegeThrow(TankFile::Error, errorInfo);
 	}
 }
 
-void TankFile::Reader::extractResourceToFile(TankFile & tank, const std::string & resourcePath,
+} // namespace {}
+
+// ========================================================
+
+void TankFile::Reader::extractResourceToFile(const TankFile & tank, const std::string & resourcePath,
                                              const std::string & destFile, const bool validateCRCs) const
 {
 	if (destFile.empty())
@@ -350,15 +768,15 @@ void TankFile::Reader::extractResourceToFile(TankFile & tank, const std::string
 		SiegeThrow(TankFile::Error, "No dest filename provided!");
 	}
 
-	auto fileContents = extractResourceToMemory(tank, resourcePath, validateCRCs);
-	if (!writeResourceFile(destFile, std::move(fileContents)))
+	const auto fileContents = extractResourceToMemory(tank, resourcePath, validateCRCs);
+	if (!writeResourceFile(destFile, fileContents))
 	{
 		SiegeThrow(TankFile::Error, "Failed write resource file \""
 				<< destFile << "\": '" << utils::filesys::getLastFileError() << "'.");
 	}
 }
 
-TankFile::Task TankFile::Reader::extractResourceToFileAsync(TankFile & tank, const std::string & resourcePath,
+TankFile::Task TankFile::Reader::extractResourceToFileAsync(const TankFile & tank, const std::string & resourcePath,
                                                             const std::string & destFile, const bool validateCRCs) const
 {
 	if (destFile.empty())
@@ -366,15 +784,27 @@ TankFile::Task TankFile::Reader::extractResourceToFileAsync(TankFile & tank, con
 		SiegeThrow(TankFile::Error, "No dest filename provided!");
 	}
 
-	// Attempt the data extraction.
-	// This must be done from the caller thread since we don't lock the Tank file.
-	auto fileContents = extractResourceToMemory(tank, resourcePath, validateCRCs);
-
-	// Fire the asynchronous task of writing the output and return the std::future handle.
-	return std::async(std::launch::async, writeResourceFile, destFile, std::move(fileContents));
-}
+	// Fail early if the resource is not in the Tank.
+	findFileEntry(tank, resourcePath);
 
-ByteArray TankFile::Reader::extractResourceToMemory(TankFile & tank, const std::string & resourcePath, const bool validateCRCs) const
+	// Extraction only does positional reads on the Tank, so it can
+	// safely run in the background task together with the file write.
+	return std::async(std::launch::async,
+		[this, &tank, resourcePath, destFile, validateCRCs]() -> bool
+		{
+			try
+			{
+				return writeResourceFile(destFile, extractResourceToMemory(tank, resourcePath, validateCRCs));
+			}
+			catch (std::exception & e)
+			{
+				SiegeError(e.what());
+				return false;
+			}
+		});
+}
+
+const TankFile::Index::FileRecord & TankFile::Reader::findFileEntry(const TankFile & tank, const std::string & resourcePath) const
 {
 	if (!tank.isOpen())
 	{
@@ -387,36 +817,131 @@ ByteArray TankFile::Reader::extractResourceToMemory(TankFile & tank, const std::
 				<< "\" must be opened for reading before you can extract data from it!");
 	}
 
-	const auto it = fileTable.find(resourcePath);
-	if (it == std::end(fileTable))
+	const uint32_t fileIndex = index.findFile(resourcePath);
+	if (fileIndex == Index::InvalidIndex)
 	{
+		if (index.findDir(resourcePath) != Index::InvalidIndex)
+		{
+			SiegeThrow(TankFile::Error, "Resource \"" << resourcePath << "\" in Tank file \""
+					<< tank.getFileName() << "\" is a directory and cannot be decompressed to file!");
+		}
+
 		SiegeThrow(TankFile::Error, "Resource \"" << resourcePath
 				<< "\" not found in Tank file \"" << tank.getFileName() << "\"!");
 	}
 
-	assert(it->first == resourcePath);
-	const Reader::TankEntry & entry = it->second;
+	return index.getFile(fileIndex);
+}
 
-	if (entry.type != TankEntry::TypeFile)
+void TankFile::Reader::recordAccess(const Index::FileRecord & resFile) const
+{
+	if (accessTrace != nullptr)
 	{
-		SiegeThrow(TankFile::Error, "Resource \"" << resourcePath << "\" in Tank file \""
-				<< tank.getFileName() << "\" is a directory and cannot be decompressed to file!");
+		accessTrace->record(index.getPath(resFile));
+	}
+}
+
+TankFile::Reader::ResourceView TankFile::Reader::getResourceView(const TankFile & tank, const std::string & resourcePath,
+                                                                 const bool validateCRCs) const
+{
+	if (!tank.isMemoryMapped())
+	{
+		SiegeThrow(TankFile::Error, "Tank file \"" << tank.getFileName()
+				<< "\" must be opened with IOMode::MemoryMapped to get resource views!");
 	}
 
-	assert(entry.ptr.file != nullptr);
-	const TankFile::FileEntry & resFile = *(entry.ptr.file);
+	const Index::FileRecord & resFile = findFileEntry(tank, resourcePath);
+	recordAccess(resFile);
 
-	ByteArray fileContents;
+	if (resFile.isCompressed())
+	{
+		SiegeThrow(TankFile::Error, "Resource \"" << resourcePath << "\" in Tank file \""
+				<< tank.getFileName() << "\" is compressed and cannot be viewed in-place!");
+	}
 
+	ResourceView view = { nullptr, 0 };
 	if (resFile.isInvalidFile() || resFile.size == 0)
+	{
+		SiegeWarn("Resource file entry \"" << index.getName(resFile) << "\" is flagged as invalid!");
+		return view; // Empty view.
+	}
+
+	view.data = tank.getMappedBytes(tank.getFileHeader().dataOffset + resFile.offset, resFile.size);
+	view.size = resFile.size;
+
+	if (validateCRCs)
+	{
+		checkResourceCrc(resourcePath, utils::computeCrc32(view.data, view.size), resFile.crc32);
+	}
+
+	return view;
+}
+
+ByteArray TankFile::Reader::extractResourceToMemory(const TankFile & tank, const std::string & resourcePath, const bool validateCRCs) const
+{
+	const Index::FileRecord & resFile = findFileEntry(tank, resourcePath);
+	recordAccess(resFile);
+
+	ByteArray fileContents(getExtractedSize(resFile));
+	extractResourceData(tank, resFile, resourcePath, fileContents.data(), validateCRCs);
+
+	return fileContents;
+}
+
+size_t TankFile::Reader::extractResourceInto(const TankFile & tank, const std::string & resourcePath, uint8_t * buffer,
+                                             const size_t bufferSizeBytes, const bool validateCRCs) const
+{
+	const Index::FileRecord & resFile = findFileEntry(tank, resourcePath);
+	recordAccess(resFile);
+
+	const size_t extractedSize = getExtractedSize(resFile);
+	if (extractedSize > bufferSizeBytes)
+	{
+		SiegeThrow(TankFile::Error, "Buffer of " << bufferSizeBytes << " bytes is too small for resource \""
+				<< resourcePath << "\" (" << extractedSize << " bytes)!");
+	}
+
+	extractResourceData(tank, resFile, resourcePath, buffer, validateCRCs);
+	return extractedSize;
+}
+
+size_t TankFile::Reader::getExtractedSize(const Index::FileRecord & resFile) noexcept
+{
+	return (resFile.isInvalidFile() || resFile.size == 0) ? 0 : resFile.size;
+}
+
+void TankFile::Reader::extractResourceData(const TankFile & tank, const Index::FileRecord & resFile,
+                                           const std::string & resourcePath, uint8_t * dest, const bool validateCRCs,
+                                           const uint8_t * storedData) const
+{
+	if (getExtractedSize(resFile) == 0)
 	{
 		// NOTE: Invalid files seem to exist in DSLOA Tank files, so this should be handled gracefully.
-		SiegeWarn("Resource file entry \"" << resFile.name << "\" is flagged as invalid!");
+		// 'devlogic.dsres' (one of our test Tanks from the game) also has a few empty dummy files.
+		SiegeWarn("Resource file entry \"" << index.getName(resFile) << "\" is flagged as invalid!");
+		return; // Empty file.
+	}
 
-		// Return an empty file.
-		return fileContents;
+	uint32_t contentsCrc = 0;
+	if (!decodeResourceData(tank, resFile, resourcePath, dest, validateCRCs, contentsCrc, storedData,
+	                        /* parallelChunks = */ true) && validateCRCs)
+	{
+		contentsCrc = utils::computeCrc32(dest, resFile.size);
+	}
+	if (validateCRCs)
+	{
+		checkResourceCrc(resourcePath, contentsCrc, resFile.crc32);
 	}
 
+	TankReaderLog("Tank resource \"" << resourcePath << "\" extracted without errors.");
+}
+
+bool TankFile::Reader::decodeResourceData(const TankFile & tank, const Index::FileRecord & resFile,
+                                          const std::string & resourcePath, uint8_t * dest, const bool computeCrc,
+                                          uint32_t & crcOut, const uint8_t * storedData, const bool parallelChunks) const
+{
+	assert(getExtractedSize(resFile) != 0);
+
 	const auto fileOffset = resFile.offset;
 	const auto fileSize   = resFile.size;
 	const auto dataOffset = tank.getFileHeader().dataOffset;
@@ -424,200 +949,1404 @@ ByteArray TankFile::Reader::extractResourceToMemory(TankFile & tank, const std::
 	if (!resFile.isCompressed()) // Simple raw resource file:
 	{
 		TankReaderLog("Extracting UNCOMPRESSED Tank resource \"" << resourcePath << "\"...");
-
-		// 'devlogic.dsres' (one of our test Tanks from the game) has
-		// a few empty uncompressed dummy files. This check handles those.
-		if (fileSize != 0)
+		if (storedData != nullptr)
+		{
+			std::memcpy(dest, storedData, fileSize);
+		}
+		else
 		{
-			tank.seekAbsoluteOffset(dataOffset + fileOffset);
-			fileContents.resize(fileSize);
-			tank.readBytes(fileContents.data(), fileContents.size());
+			tank.readBytesAt(dataOffset + fileOffset, dest, fileSize);
 		}
 	}
 	else // LZO/Zlib compressed:
 	{
 		TankReaderLog("Extracting COMPRESSED Tank resource \"" << resourcePath << "\". "
 				<< "Uncompressed size: " << utils::formatMemoryUnit(fileSize, true)
-				<< ", compression fmt: " << dataFormatToString(resFile.format));
+				<< ", compression fmt: " << dataFormatToString(resFile.getDataFormat()));
 
-		const auto & compressedHeader = resFile.getCompressedHeader();
+		const Index::ChunkRecord * const chunks = index.getChunks(resFile);
+		const uint32_t numChunks = resFile.numChunks;
 
-		ByteArray compressedData;
-		ByteArray uncompressedData;
-		unsigned long uncompressedLen;
+		// Each chunk decompresses to exactly 'uncompressedSize' bytes
+		// (inflated data + extraBytes), so its final position in the
+		// resource is the sum of the sizes of the chunks before it.
+		std::vector<size_t> chunkOutputOffsets(numChunks);
+		size_t totalSize = 0;
+		for (uint32_t c = 0; c < numChunks; ++c)
+		{
+			chunkOutputOffsets[c] = totalSize;
+			totalSize += chunks[c].uncompressedSize;
+		}
+
+		if (totalSize != fileSize)
+		{
+			SiegeThrow(TankFile::Error, "Chunks of resource \"" << resourcePath << "\" add up to "
+					<< totalSize << " bytes, but the resource size is " << fileSize << " bytes!");
+		}
 
-		fileContents.reserve(fileSize);
+		// With fused checksums each chunk is checksummed while it is still hot in the cache.
+		const bool checksumChunks = computeCrc && fusedChunkChecksums;
+		uint32_t contentsCrc = 0;
 
-		for (uint32_t c = 0; c < compressedHeader.numChunks; ++c)
+		if (parallelChunks && numChunks > 1 && parallelChunkDecodeThreshold != 0 &&
+		    fileSize >= parallelChunkDecodeThreshold)
 		{
-			const TankFile::FileEntryChunkHeader & chunk = compressedHeader.chunkHeaders[c];
+			// Chunks are independent and each one writes to its own slot of
+			// the output buffer, so they can all be inflated at the same time.
+			std::vector<uint32_t> chunkCrcs(checksumChunks ? numChunks : 0);
+			utils::JobGroup chunkJobs(getJobSystem());
+			for (uint32_t c = 0; c < numChunks; ++c)
+			{
+				uint8_t * chunkDest = dest + chunkOutputOffsets[c];
+				uint32_t * chunkCrc = checksumChunks ? &chunkCrcs[c] : nullptr;
+				const uint32_t chunkSize = chunks[c].uncompressedSize;
+				chunkJobs.run([this, &tank, &resFile, &resourcePath, c, chunkDest, chunkCrc, chunkSize, storedData]()
+				{
+					ByteArray compressedData;
+					decompressChunk(tank, resFile, resourcePath, c, chunkDest, compressedData, storedData);
+					if (chunkCrc != nullptr)
+					{
+						*chunkCrc = utils::computeCrc32(chunkDest, chunkSize);
+					}
+				});
+			}
+			chunkJobs.wait();
 
-			// Individual chunks of data inside a compressed file might
-			// be stored without compression. So this check is necessary.
-			if (chunk.isCompressed())
+			for (uint32_t c = 0; c < chunkCrcs.size(); ++c)
+			{
+				contentsCrc = utils::crc32::combine(contentsCrc, chunkCrcs[c], chunks[c].uncompressedSize);
+			}
+		}
+		else
+		{
+			ByteArray compressedData;
+			for (uint32_t c = 0; c < numChunks; ++c)
 			{
-				tank.seekAbsoluteOffset(dataOffset + fileOffset + chunk.offset);
-				compressedData.resize(chunk.compressedSize + chunk.extraBytes);
-				tank.readBytes(compressedData.data(), compressedData.size());
+				uint8_t * chunkDest = dest + chunkOutputOffsets[c];
+				decompressChunk(tank, resFile, resourcePath, c, chunkDest, compressedData, storedData);
+				if (checksumChunks)
+				{
+					contentsCrc = utils::computeCrc32(chunkDest, chunks[c].uncompressedSize, contentsCrc);
+				}
+			}
+		}
+
+		if (checksumChunks)
+		{
+			crcOut = contentsCrc;
+			return true;
+		}
+	}
 
-				uncompressedData.resize(chunk.uncompressedSize + chunk.extraBytes);
-				uncompressedLen = static_cast<unsigned long>(uncompressedData.size());
+	return false;
+}
 
-				TankReaderLog("Attempting to decompress resource chunk #" << (c + 1)
-						<< " of " << compressedHeader.numChunks << "...");
+ByteArray TankFile::Reader::extractResourceRange(const TankFile & tank, const std::string & resourcePath,
+                                                 const uint32_t offset, const uint32_t length) const
+{
+	const Index::FileRecord & resFile = findFileEntry(tank, resourcePath);
+	const uint32_t fileSize = resFile.isInvalidFile() ? 0 : resFile.size;
+	recordAccess(resFile);
 
-				// Let Mini-Z do the decompression:
-				const int errorCode = utils::compression::decompress(uncompressedData.data(), &uncompressedLen,
-							compressedData.data(), static_cast<unsigned long>(compressedData.size() - chunk.extraBytes));
+	if (offset > fileSize)
+	{
+		SiegeThrow(TankFile::Error, "Range offset " << offset << " is past the end of resource \""
+				<< resourcePath << "\" (" << fileSize << " bytes)!");
+	}
 
-				assert(uncompressedLen != 0 && "Nothing was decompressed!");
-				assert(uncompressedLen <= uncompressedData.size() && "Buffer overrun!");
+	const uint32_t rangeEnd = offset + std::min(length, fileSize - offset);
+	ByteArray rangeContents(rangeEnd - offset);
+	if (rangeContents.empty())
+	{
+		return rangeContents;
+	}
 
-				if (errorCode != 0)
-				{
-					auto errorInfo = utils::compression::getErrorString(errorCode);
-					SiegeThrow(TankFile::Error, "Failed to decompress resource \"" << resourcePath
-							<< "\"! Mini-Z error: '" << errorInfo << "'");
-				}
-			}
-			else
-			{
-				TankReaderLog("Chunk #" << (c + 1) << " of " << compressedHeader.numChunks << " is stored without compression...");
+	const size_t dataOffset = tank.getFileHeader().dataOffset + resFile.offset;
+	if (!resFile.isCompressed())
+	{
+		tank.readBytesAt(dataOffset + offset, rangeContents.data(), rangeContents.size());
+		return rangeContents;
+	}
 
-				compressedData.clear();
-				assert(chunk.uncompressedSize == chunk.compressedSize);
+	TankReaderLog("Extracting range [" << offset << ", " << rangeEnd << ") of COMPRESSED Tank resource \""
+			<< resourcePath << "\"...");
 
-				tank.seekAbsoluteOffset(dataOffset + fileOffset + chunk.offset);
-				uncompressedData.resize(chunk.uncompressedSize);
-				tank.readBytes(uncompressedData.data(), uncompressedData.size());
+	ByteArray chunkContents;
+	ByteArray compressedData;
+	const Index::ChunkRecord * const chunks = index.getChunks(resFile);
 
-				uncompressedLen = static_cast<unsigned long>(uncompressedData.size());
-			}
+	// Chunks are laid out back to back in the uncompressed resource, each
+	// 'uncompressedSize' bytes. Skip the ones before the range and stop after it.
+	uint64_t chunkStart = 0;
+	for (uint32_t c = 0; c < resFile.numChunks && chunkStart < rangeEnd; ++c)
+	{
+		const Index::ChunkRecord & chunk = chunks[c];
+		const uint64_t chunkEnd = chunkStart + chunk.uncompressedSize;
+
+		if (chunkEnd > offset)
+		{
+			// Part of the chunk that falls inside the range:
+			const uint32_t sliceStart = static_cast<uint32_t>(std::max<uint64_t>(offset, chunkStart) - chunkStart);
+			const uint32_t sliceEnd   = static_cast<uint32_t>(std::min<uint64_t>(rangeEnd, chunkEnd) - chunkStart);
+			uint8_t * const sliceDest = rangeContents.data() + (chunkStart + sliceStart - offset);
 
-			// Append decompressed chunk to the whole resource:
-			//
-			// extraBytes are not decompressed, they should be copied unchanged to the
-			// end of the decompressed chunk. Refer to "gpg/TankStructure.h" for a nice
-			// ASCII drawing of the process.
-			//
-			fileContents.insert(std::end(fileContents), std::begin(uncompressedData),
-					std::begin(uncompressedData) + uncompressedLen);
-
-			// Append extraBytes at the end of this chunk:
-			// (compressedData is only empty for an uncompressed chunk)
-			if (chunk.extraBytes != 0 && !compressedData.empty())
+			if (!chunk.isCompressed())
+			{
+				// Stored chunks can be read partially.
+				tank.readBytesAt(dataOffset + chunk.offset + sliceStart, sliceDest, sliceEnd - sliceStart);
+			}
+			else if (sliceStart == 0 && sliceEnd == chunk.uncompressedSize)
+			{
+				decompressChunk(tank, resFile, resourcePath, c, sliceDest, compressedData);
+			}
+			else
 			{
-				fileContents.insert(std::end(fileContents), std::begin(compressedData) + chunk.compressedSize,
-						std::begin(compressedData) + chunk.compressedSize + chunk.extraBytes);
+				chunkContents.resize(chunk.uncompressedSize);
+				decompressChunk(tank, resFile, resourcePath, c, chunkContents.data(), compressedData);
+				std::memcpy(sliceDest, chunkContents.data() + sliceStart, sliceEnd - sliceStart);
 			}
 		}
+		chunkStart = chunkEnd;
 	}
 
-	if (validateCRCs && !fileContents.empty())
+	if (chunkStart < rangeEnd)
 	{
-		const auto expectedCrc = resFile.crc32;
-		const auto contentsCrc = utils::computeCrc32(fileContents.data(), fileContents.size());
+		SiegeThrow(TankFile::Error, "Chunks of resource \"" << resourcePath << "\" add up to "
+				<< chunkStart << " bytes, but the resource size is " << fileSize << " bytes!");
+	}
+
+	return rangeContents;
+}
+
+void TankFile::Reader::decompressChunk(const TankFile & tank, const Index::FileRecord & resFile, const std::string & resourcePath,
+                                       const uint32_t chunkIndex, uint8_t * dest, ByteArray & compressedData,
+                                       const uint8_t * storedData) const
+{
+	assert(chunkIndex < resFile.numChunks);
+	const Index::ChunkRecord & chunk = index.getChunks(resFile)[chunkIndex];
+	const size_t chunkOffset = tank.getFileHeader().dataOffset + resFile.offset + chunk.offset;
 
-		if (contentsCrc != expectedCrc)
+	// Individual chunks of data inside a compressed file might
+	// be stored without compression. So this check is necessary.
+	if (!chunk.isCompressed())
+	{
+		TankReaderLog("Chunk #" << (chunkIndex + 1) << " of " << resFile.numChunks << " is stored without compression...");
+		if (storedData != nullptr)
+		{
+			std::memcpy(dest, storedData + chunk.offset, chunk.uncompressedSize);
+		}
+		else
 		{
-			auto errorInfo = utils::format("Tank resource \"%s\" CRC (0x%08X) does not match the expected (0x%08X)!",
-					resourcePath.c_str(), contentsCrc, expectedCrc);
+			tank.readBytesAt(chunkOffset, dest, chunk.uncompressedSize);
+		}
+		return;
+	}
 
-			SiegeThrow(TankFile::Error, errorInfo);
+	// Serve it from the cache if we can, otherwise decompress and cache a copy.
+	ChunkCache::Key cacheKey = {};
+	if (chunkCache != nullptr)
+	{
+		cacheKey = { &tank, index.getFileIndex(resFile), chunkIndex };
+		if (const ChunkCache::ChunkPtr cached = chunkCache->find(cacheKey))
+		{
+			assert(cached->size() == chunk.uncompressedSize);
+			std::memcpy(dest, cached->data(), cached->size());
+			return;
 		}
 	}
 
-	TankReaderLog("Tank resource \"" << resourcePath << "\" extracted without errors.");
-	return fileContents;
+	decompressChunkData(tank, resFile, resourcePath, chunkIndex, dest, compressedData, storedData);
+
+	if (chunkCache != nullptr)
+	{
+		chunkCache->insert(cacheKey, std::make_shared<const ByteArray>(dest, dest + chunk.uncompressedSize));
+	}
 }
 
-void TankFile::Reader::extractWholeTank(TankFile & tank, const std::string & destPath, const bool validateCRCs) const
+void TankFile::Reader::decompressChunkData(const TankFile & tank, const Index::FileRecord & resFile, const std::string & resourcePath,
+                                           const uint32_t chunkIndex, uint8_t * dest, ByteArray & compressedData,
+                                           const uint8_t * storedData) const
+{
+	const Index::ChunkRecord & chunk = index.getChunks(resFile)[chunkIndex];
+	const size_t chunkOffset = tank.getFileHeader().dataOffset + resFile.offset + chunk.offset;
+
+	// extraBytes are not compressed, they follow the compressed data and should
+	// be copied unchanged to the end of the decompressed chunk. Refer to
+	// "gpg/TankStructure.h" for a nice ASCII drawing of the process.
+	if (chunk.extraBytes > chunk.uncompressedSize)
+	{
+		SiegeThrow(TankFile::Error, "Chunk #" << (chunkIndex + 1) << " of resource \"" << resourcePath
+				<< "\" has more extra bytes than uncompressed bytes!");
+	}
+
+	// When the Tank is memory mapped we can inflate straight from the mapping.
+	const uint8_t * compressedPtr;
+	if (storedData != nullptr)
+	{
+		compressedPtr = storedData + chunk.offset;
+	}
+	else if (tank.isMemoryMapped())
+	{
+		compressedPtr = tank.getMappedBytes(chunkOffset, chunk.compressedSize + chunk.extraBytes);
+	}
+	else
+	{
+		compressedData.resize(chunk.compressedSize + chunk.extraBytes);
+		tank.readBytesAt(chunkOffset, compressedData.data(), compressedData.size());
+		compressedPtr = compressedData.data();
+	}
+
+	TankReaderLog("Attempting to decompress resource chunk #" << (chunkIndex + 1)
+			<< " of " << resFile.numChunks << "...");
+
+	// The codec is selected by the data format of the resource:
+	utils::compression::Codec::Enum codec;
+	switch (resFile.getDataFormat())
+	{
+	case DataFormat::Zlib : codec = utils::compression::Codec::Zlib;  break;
+	case DataFormat::Lzo  : codec = utils::compression::Codec::Lzo1x; break;
+	default :
+		SiegeThrow(TankFile::Error, "Resource \"" << resourcePath << "\" has an unknown data format ("
+				<< resFile.format << ")!");
+	} // switch (resFile.getDataFormat())
+
+	const unsigned long expectedLen = chunk.uncompressedSize - chunk.extraBytes;
+	unsigned long uncompressedLen = expectedLen;
+	const int errorCode = utils::compression::decompress(codec, dest, &uncompressedLen,
+				compressedPtr, static_cast<unsigned long>(chunk.compressedSize));
+
+	if (errorCode != utils::compression::Error::Ok)
+	{
+		auto errorInfo = utils::compression::getErrorString(errorCode);
+		SiegeThrow(TankFile::Error, "Failed to decompress resource \"" << resourcePath << "\"! "
+				<< dataFormatToString(resFile.getDataFormat()) << " error: '" << errorInfo << "'");
+	}
+
+	if (uncompressedLen != expectedLen)
+	{
+		SiegeThrow(TankFile::Error, "Chunk #" << (chunkIndex + 1) << " of resource \"" << resourcePath
+				<< "\" decompressed to " << uncompressedLen << " bytes, expected " << expectedLen << "!");
+	}
+
+	// Append extraBytes at the end of this chunk:
+	if (chunk.extraBytes != 0)
+	{
+		std::memcpy(dest + expectedLen, compressedPtr + chunk.compressedSize, chunk.extraBytes);
+	}
+}
+
+namespace
+{
+
+// destPath + '/' + tankName:
+std::string getWholeTankPath(const TankFile & tank, const std::string & destPath)
 {
-	// destPath + '/' + tankName:
 	std::string basePath = destPath;
 	if (basePath.back() != utils::filesys::getPathSeparator()[0])
 	{
 		basePath += utils::filesys::getPathSeparator();
 	}
 	basePath += utils::filesys::removeFilenameExtension(tank.getFileName());
+	return basePath;
+}
+
+// Writes each resource to basePath + resource path. Directories come from the cache.
+TankFile::Reader::ResourceSink makeFileSink(const std::string & basePath, utils::filesys::DirectoryCache & dirCache)
+{
+	TankFile::Reader::ResourceSink sink;
+	sink.write = [&basePath, &dirCache](const std::string & resourcePath, TankFile::Reader::ResourceBuffer & contents)
+	{
+		const std::string destFile = basePath + resourcePath;
+		if (!dirCache.createPath(destFile))
+		{
+			SiegeThrow(siege::Exception, "Failed to create path \"" << destFile << "\": " << utils::filesys::getLastFileError());
+		}
+		return writeResourceFile(destFile, contents.data(), contents.size());
+	};
+	return sink;
+}
 
+} // namespace {}
+
+unsigned int TankFile::Reader::extractWholeTank(const TankFile & tank, const std::string & destPath, const bool validateCRCs) const
+{
+	const std::string basePath = getWholeTankPath(tank, destPath);
 	TankReaderLog("Extracting whole Tank to \"" << basePath << "\"...");
 
-	// Create the base path if not there yet:
-	if (!utils::filesys::createPath(basePath))
+	// Base path plus all the directories, before any file is written:
+	utils::filesys::DirectoryCache dirCache;
+	createDirectoryTree(basePath, dirCache);
+
+	const ExtractionStats stats = extractAllResources(tank, makeFileSink(basePath, dirCache), validateCRCs);
+
+	TankReaderLog("extractWholeTank() successfully written " <<
+			stats.filesWritten << " files to path: \"" << basePath << "\"");
+
+	return stats.filesWritten;
+}
+
+TankFile::Reader::IncrementalExtraction TankFile::Reader::extractWholeTankIncremental(const TankFile & tank, const std::string & destPath,
+                                                                                      const bool validateCRCs) const
+{
+	const std::string basePath = getWholeTankPath(tank, destPath);
+	TankReaderLog("Incrementally extracting whole Tank to \"" << basePath << "\"...");
+
+	// Cheap when the tree is already there, just a stat() per directory.
+	utils::filesys::DirectoryCache dirCache;
+	createDirectoryTree(basePath, dirCache);
+
+	return extractAllResourcesIncremental(tank, makeFileSink(basePath, dirCache), basePath, basePath + ".manifest", validateCRCs);
+}
+
+// ========================================================
+// Extraction manifest:
+// ========================================================
+
+namespace
+{
+
+// What the manifest remembers of an extracted resource.
+struct ManifestEntry
+{
+	uint32_t crc32;
+	uint32_t size;
+	uint64_t fileTime;
+
+	bool operator == (const ManifestEntry & other) const noexcept
+	{
+		return crc32 == other.crc32 && size == other.size && fileTime == other.fileTime;
+	}
+};
+
+using Manifest = std::map<std::string, ManifestEntry>;
+
+const char ManifestHeader[] = "# Tank extraction manifest v1";
+
+ManifestEntry makeManifestEntry(const TankFile::Index::FileRecord & resFile)
+{
+	return { resFile.crc32, resFile.size, resFile.fileTime.toU64() };
+}
+
+// Text, sorted by path. After the header, one "<crc32> <size> <time> <resource path>" line per resource.
+bool loadManifest(const std::string & filename, Manifest & manifest)
+{
+	manifest.clear();
+
+	std::ifstream inFile;
+	if (!utils::filesys::tryOpen(inFile, filename))
 	{
-		SiegeThrow(siege::Exception, "Failed to create path \"" << basePath << "\": " << utils::filesys::getLastFileError());
+		return false;
 	}
 
-	// Preallocate for the table size. All entries are potentially files.
-	std::vector<Task> tasks;
-	tasks.reserve(fileTable.size());
+	std::string line;
+	if (!std::getline(inFile, line) || line != ManifestHeader)
+	{
+		SiegeWarn("\"" << filename << "\" is not an extraction manifest.");
+		return false;
+	}
 
-	// Walk the file table and decompress each resource file:
-	std::string destFile;
-	for (const auto & entry : fileTable)
+	while (std::getline(inFile, line))
 	{
-		if (entry.second.type == TankEntry::TypeDir)
+		if (line.empty())
 		{
 			continue;
 		}
 
-		destFile = basePath + entry.first;
+		char * fieldEnd = nullptr;
+		ManifestEntry entry;
+		entry.crc32    = static_cast<uint32_t>(std::strtoul(line.c_str(), &fieldEnd, 16));
+		entry.size     = static_cast<uint32_t>(std::strtoul(fieldEnd, &fieldEnd, 10));
+		entry.fileTime = std::strtoull(fieldEnd, &fieldEnd, 10);
+		if (*fieldEnd != ' ' || fieldEnd[1] == '\0')
+		{
+			SiegeWarn("Malformed line in extraction manifest \"" << filename << "\": \"" << line << "\"");
+			manifest.clear();
+			return false;
+		}
+		manifest[fieldEnd + 1] = entry;
+	}
+	return true;
+}
 
-		if (!utils::filesys::createPath(destFile))
+// Written to a temporary file first, so a run that is cut short leaves the old manifest intact.
+bool saveManifest(const std::string & filename, const Manifest & manifest)
+{
+	const std::string tempFilename = filename + ".tmp";
+	{
+		std::ofstream outFile;
+		if (!utils::filesys::tryOpen(outFile, tempFilename))
 		{
-			SiegeThrow(siege::Exception, "Failed to create path \"" << destFile << "\": " << utils::filesys::getLastFileError());
+			return false;
 		}
 
-		auto task = extractResourceToFileAsync(tank, entry.first, destFile, validateCRCs);
-		tasks.emplace_back(std::move(task));
+		outFile << ManifestHeader << "\n";
+		for (const auto & file : manifest)
+		{
+			outFile << utils::format("%08X %u %llu ", file.second.crc32, file.second.size,
+					static_cast<unsigned long long>(file.second.fileTime)) << file.first << "\n";
+		}
+		outFile.close();
+
+		if (outFile.fail())
+		{
+			std::remove(tempFilename.c_str());
+			return false;
+		}
 	}
 
-	// Once all files are done, we synchronize.
-	// NOTE: Should we allow for the caller to synchronize instead?
-	//
-	int filesSuccessfullyWritten = 0;
-	for (auto & task : tasks)
+	return utils::filesys::replaceFile(tempFilename, filename);
+}
+
+} // namespace {}
+
+TankFile::Reader::IncrementalExtraction TankFile::Reader::extractAllResourcesIncremental(const TankFile & tank, const ResourceSink & sink,
+                                                                                         const std::string & outputPath,
+                                                                                         const std::string & manifestFile,
+                                                                                         const bool validateCRCs) const
+{
+	IncrementalExtraction result;
+
+	Manifest previousManifest;
+	if (!loadManifest(manifestFile, previousManifest))
 	{
-		filesSuccessfullyWritten += int(task.get());
+		TankReaderLog("No previous extraction manifest at \"" << manifestFile << "\", extracting all resources.");
 	}
 
-	TankReaderLog("extractWholeTank() successfully written " <<
-			filesSuccessfullyWritten << " files to path: \"" << basePath << "\"");
+	// Unchanged resources carry over to the new manifest, the rest
+	// are added as they are written, so failed ones aren't recorded.
+	// The same goes for the added and changed lists of the result.
+	Manifest newManifest;
+	std::mutex manifestMutex;
+	std::unordered_set<std::string> selectedAsAdded; // Only read once the extraction starts.
+
+	ResourceSink incrementalSink = sink;
+	incrementalSink.select = [&](const std::string & resourcePath, const Index::FileRecord & resFile)
+	{
+		if (sink.select && !sink.select(resourcePath, resFile))
+		{
+			return false;
+		}
+
+		const ManifestEntry entry = makeManifestEntry(resFile);
+		const auto previous = previousManifest.find(resourcePath);
+		if (previous == previousManifest.end())
+		{
+			selectedAsAdded.insert(resourcePath);
+			return true;
+		}
+
+		// Converted files have sizes of their own, so those only need to exist.
+		// Invalid entries are written as empty files.
+		const std::string outputName = sink.outputName ? sink.outputName(resourcePath) : resourcePath;
+		size_t outputSize = 0;
+		if (previous->second == entry && utils::filesys::queryFileSize(outputPath + outputName, outputSize) &&
+		    (outputSize == getExtractedSize(resFile) || outputName != resourcePath))
+		{
+			newManifest[resourcePath] = entry;
+			++result.unchanged;
+			return false;
+		}
+
+		return true;
+	};
+	incrementalSink.write = [&](const std::string & resourcePath, ResourceBuffer & contents)
+	{
+		if (!sink.write(resourcePath, contents))
+		{
+			return false;
+		}
+
+		const ManifestEntry entry = makeManifestEntry(index.getFile(index.findFile(resourcePath)));
+		std::lock_guard<std::mutex> lock(manifestMutex);
+		newManifest[resourcePath] = entry;
+		if (selectedAsAdded.count(resourcePath) != 0)
+		{
+			result.added.push_back(resourcePath);
+		}
+		else
+		{
+			result.changed.push_back(resourcePath);
+		}
+		return true;
+	};
+
+	result.stats = extractAllResources(tank, incrementalSink, validateCRCs);
+
+	for (const auto & file : previousManifest)
+	{
+		if (index.findFile(file.first) == Index::InvalidIndex)
+		{
+			result.removed.push_back(file.first);
+		}
+	}
+
+	// Written in whatever order the write threads got to them.
+	std::sort(std::begin(result.added),   std::end(result.added));
+	std::sort(std::begin(result.changed), std::end(result.changed));
+
+	if (!saveManifest(manifestFile, newManifest))
+	{
+		SiegeWarn("Failed to write extraction manifest \"" << manifestFile << "\": " << utils::filesys::getLastFileError());
+	}
+
+	TankReaderLog("Incremental extraction: " << result.added.size() << " added, " << result.changed.size() << " changed, "
+			<< result.removed.size() << " removed, " << result.unchanged << " unchanged.");
+
+	return result;
 }
 
-std::vector<std::string> TankFile::Reader::getFileList() const
+void TankFile::Reader::createDirectoryTree(const std::string & destPath, utils::filesys::DirectoryCache & dirCache) const
 {
-	std::vector<std::string> fileList;
-	fileList.reserve(getFileCount());
+	// Always at least the root. The list is sorted, so parents come before their subdirectories.
+	if (!dirCache.createPath(destPath + utils::filesys::getPathSeparator()))
+	{
+		SiegeThrow(siege::Exception, "Failed to create path \"" << destPath << "\": " << utils::filesys::getLastFileError());
+	}
 
-	for (const auto & entry : fileTable)
+	for (const utils::StringView dirPath : index.getDirPaths())
 	{
-		if (entry.second.type == TankEntry::TypeDir)
+		const std::string fullPath = destPath + dirPath.toString();
+		if (!dirCache.createPath(fullPath))
 		{
-			continue;
+			SiegeThrow(siege::Exception, "Failed to create path \"" << fullPath << "\": " << utils::filesys::getLastFileError());
+		}
+	}
+}
+
+// ========================================================
+// TankFile::Reader extraction pipeline:
+// ========================================================
+
+namespace
+{
+
+using PooledBuffer = TankFile::Reader::ResourceBuffer;
+
+// A resource on its way through the stages of extractAllResources().
+struct PipelineItem
+{
+	uint32_t                      fileIndex    = 0;
+	uint64_t                      budgetBytes  = 0; // Extracted size, held from the read stage to the write stage.
+	std::string                   resourcePath;
+	std::shared_ptr<PooledBuffer> storedSpan;       // Owns 'storedData' when it was read into memory.
+	const uint8_t *               storedData   = nullptr;
+	PooledBuffer                  contents;
+	uint32_t                      contentsCrc  = 0;
+	bool                          crcComputed  = false;
+	bool                          contentsRead = false; // Uncompressed resource read straight into 'contents'.
+};
+
+using PipelineBatch = std::vector<PipelineItem>;
+using PipelineQueue = utils::BoundedQueue<PipelineBatch>;
+using PipelineClock = std::chrono::steady_clock;
+
+double secondsSince(const PipelineClock::time_point start)
+{
+	return std::chrono::duration<double>(PipelineClock::now() - start).count();
+}
+
+//
+// Threads running one stage of the pipeline. The stage loop adds the
+// time it spends working to its 'busySeconds' argument. The queue the
+// stage feeds is closed when its last thread returns, which lets the
+// next stage drain it and finish in turn. If a loop throws, the first
+// exception is kept for join() to return and 'abort' is called to stop
+// all the stages, so none is left waiting on a dead one.
+//
+class PipelineStage final
+	: public utils::NonCopyable
+{
+public:
+
+	using Loop  = std::function<void(double & busySeconds)>;
+	using Abort = std::function<void()>;
+
+	PipelineStage(const unsigned int numThreads, PipelineQueue * output, const Loop & loop, const Abort & abort)
+		: runningThreads(std::max(numThreads, 1u))
+		, totalBusySeconds(0.0)
+	{
+		const unsigned int threadCount = runningThreads;
+		try
+		{
+			for (unsigned int t = 0; t < threadCount; ++t)
+			{
+				threads.emplace_back([this, output, loop, abort]()
+				{
+					double busySeconds = 0.0;
+					try
+					{
+						loop(busySeconds);
+					}
+					catch (...)
+					{
+						recordError(std::current_exception());
+						abort();
+					}
+
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						totalBusySeconds += busySeconds;
+					}
+					if (--runningThreads == 0 && output != nullptr)
+					{
+						output->close();
+					}
+				});
+			}
+		}
+		catch (...)
+		{
+			// Couldn't start all the threads. The ones started are stopped with the rest of the pipeline.
+			abort();
+			join();
+			throw;
+		}
+	}
+
+	~PipelineStage()
+	{
+		join();
+	}
+
+	// Waits for the threads and returns the time they were busy.
+	double join()
+	{
+		for (auto & thread : threads)
+		{
+			if (thread.joinable())
+			{
+				thread.join();
+			}
+		}
+		return totalBusySeconds;
+	}
+
+	// First exception thrown by a loop of the stage, null if none. Valid after join().
+	std::exception_ptr getError() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return firstError;
+	}
+
+private:
+
+	void recordError(std::exception_ptr error)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!firstError)
+		{
+			firstError = std::move(error);
 		}
-		fileList.push_back(entry.first);
 	}
 
-	return fileList;
+	std::vector<std::thread>  threads;
+	std::atomic<unsigned int> runningThreads;
+	mutable std::mutex        mutex;
+	double                    totalBusySeconds;
+	std::exception_ptr        firstError;
+};
+
+} // namespace {}
+
+// ========================================================
+
+unsigned int TankFile::Reader::getDecodeThreadCount(const PipelineConfig & config) const
+{
+	if (config.decodeThreads != 0)
+	{
+		return config.decodeThreads;
+	}
+
+	const unsigned int workers = getJobSystem().getWorkerCount();
+	return (workers > config.verifyThreads) ? workers - config.verifyThreads : 1;
 }
 
-std::vector<std::string> TankFile::Reader::getDirectoryList() const
+TankFile::Reader::ExtractionStats TankFile::Reader::extractAllResources(const TankFile & tank, const ResourceSink & sink,
+                                                                        const bool validateCRCs) const
 {
-	std::vector<std::string> dirList;
-	dirList.reserve(getDirectoryCount());
+	return extractAllResources(tank, sink, validateCRCs, pipelineConfig);
+}
+
+TankFile::Reader::ExtractionStats TankFile::Reader::extractAllResources(const TankFile & tank, const ResourceSink & sink,
+                                                                        const bool validateCRCs, const PipelineConfig & config) const
+{
+	if (!sink.write)
+	{
+		SiegeThrow(TankFile::Error, "extractAllResources() needs a sink with a write function!");
+	}
+
+	const PipelineClock::time_point startTime = PipelineClock::now();
 
-	for (const auto & entry : fileTable)
+	// A batch is a run of neighbors with no more than DataSectionAlignment bytes between them,
+	// fetched with one read if they fit in maxCoalescedReadSize. A resource bigger than that
+	// is a batch of its own. Batches are planned in the order the files are stored, so the
+	// Tank is read front to back. The resources of a batch go through the stages together,
+	// which keeps the hand-offs between threads down to a few per megabyte.
+	struct ReadBatch
 	{
-		if (entry.second.type == TankEntry::TypeFile)
+		size_t   first;
+		size_t   last;
+		uint64_t readStart;
+		uint64_t readSize;
+		uint64_t extractedBytes;
+	};
+
+	std::vector<uint32_t> files = getFilesInDataOrder();
+	if (sink.select)
+	{
+		files.erase(std::remove_if(std::begin(files), std::end(files), [this, &sink](const uint32_t fileIndex)
 		{
-			continue;
+			const Index::FileRecord & resFile = index.getFile(fileIndex);
+			return !sink.select(index.getPath(resFile).toString(), resFile);
+		}), std::end(files));
+	}
+
+	std::vector<ReadBatch> readBatches;
+
+	for (size_t first = 0; first < files.size();)
+	{
+		const Index::FileRecord & firstFile = index.getFile(files[first]);
+		const uint64_t readStart = firstFile.offset;
+		uint64_t readEnd = readStart + index.getStoredSize(firstFile);
+		uint64_t extractedBytes = getExtractedSize(firstFile);
+		size_t last = first + 1;
+
+		for (; last < files.size(); ++last)
+		{
+			const Index::FileRecord & resFile = index.getFile(files[last]);
+			const uint64_t fileEnd = std::max<uint64_t>(readEnd, uint64_t(resFile.offset) + index.getStoredSize(resFile));
+			if (resFile.offset > readEnd + DataSectionAlignment || (fileEnd - readStart) > maxCoalescedReadSize)
+			{
+				break;
+			}
+			readEnd = fileEnd;
+			extractedBytes += getExtractedSize(resFile);
+		}
+
+		readBatches.push_back({ first, last, readStart, readEnd - readStart, extractedBytes });
+		first = last;
+	}
+
+	const unsigned int decodeThreads = getDecodeThreadCount(config);
+	const unsigned int totalThreads = config.readThreads + decodeThreads +
+			config.verifyThreads + config.writeThreads;
+
+	// The budget is taken by the read stage for the stored bytes and the extracted bytes of
+	// a batch before reading it. Stored bytes are given back once all the resources of the
+	// batch are decoded (converted, if the sink has a 'convert') and extracted bytes once each
+	// resource is written. This throttles the
+	// reads whenever the later stages fall behind, on top of the limit of the queues.
+	utils::ByteBudget budget(maxBytesInFlight);
+	utils::BufferPool buffers(totalThreads * 2);
+
+	PipelineQueue decodeQueue(config.queueDepth);
+	PipelineQueue verifyQueue(config.queueDepth);
+	PipelineQueue writeQueue(config.queueDepth);
+
+	// Stops every stage once one of them has failed. The queues drop the batches
+	// still in them and the read stage stops waiting on the budget.
+	auto abortPipeline = [&budget, &decodeQueue, &verifyQueue, &writeQueue]()
+	{
+		budget.cancel();
+		decodeQueue.cancel();
+		verifyQueue.cancel();
+		writeQueue.cancel();
+	};
+
+	std::atomic<size_t>       nextBatch(0);
+	std::atomic<uint64_t>     readCalls(0);
+	std::atomic<uint64_t>     bytesRead(0);
+	std::atomic<uint64_t>     bytesExtracted(0);
+	std::atomic<unsigned int> filesWritten(0);
+	std::atomic<unsigned int> filesFailed(0);
+
+	const size_t dataOffset = tank.getFileHeader().dataOffset;
+
+	// Drops a resource that failed in one of the stages.
+	auto failItem = [&sink, &buffers, &budget, &filesFailed](PipelineItem & item, const std::string & errorText)
+	{
+		SiegeError(errorText);
+		if (sink.error)
+		{
+			sink.error(item.resourcePath, errorText);
+		}
+
+		item.storedSpan.reset();
+		buffers.release(std::move(item.contents));
+		budget.release(item.budgetBytes);
+		++filesFailed;
+	};
+
+	// Runs 'process' on each resource of a batch, dropping the ones it returns false for.
+	auto processBatch = [](PipelineBatch & batch, const std::function<bool(PipelineItem &)> & process)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < batch.size(); ++i)
+		{
+			if (process(batch[i]))
+			{
+				if (kept != i)
+				{
+					batch[kept] = std::move(batch[i]);
+				}
+				++kept;
+			}
+		}
+		batch.resize(kept);
+	};
+
+	// Output writer stage:
+	PipelineStage writeStage(config.writeThreads, nullptr,
+		[&](double & busySeconds)
+		{
+			PipelineBatch batch;
+			while (writeQueue.pop(batch))
+			{
+				const auto start = PipelineClock::now();
+				for (auto & item : batch)
+				{
+					std::string errorText;
+					try
+					{
+						if (!sink.write(item.resourcePath, item.contents))
+						{
+							errorText = "Failed to write resource \"" + item.resourcePath + "\"!";
+						}
+					}
+					catch (std::exception & e)
+					{
+						errorText = e.what();
+					}
+
+					if (errorText.empty())
+					{
+						bytesExtracted += item.budgetBytes;
+						buffers.release(std::move(item.contents));
+						budget.release(item.budgetBytes);
+						++filesWritten;
+					}
+					else
+					{
+						failItem(item, errorText);
+					}
+				}
+				busySeconds += secondsSince(start);
+			}
+		}, abortPipeline);
+
+	// CRC check and conversion stage:
+	PipelineStage verifyStage(config.verifyThreads, &writeQueue,
+		[&](double & busySeconds)
+		{
+			PipelineBatch batch;
+			while (verifyQueue.pop(batch))
+			{
+				const auto start = PipelineClock::now();
+				processBatch(batch, [&](PipelineItem & item)
+				{
+					try
+					{
+						if (validateCRCs && !item.contents.empty())
+						{
+							if (!item.crcComputed)
+							{
+								item.contentsCrc = utils::computeCrc32(item.contents.data(), item.contents.size());
+							}
+							checkResourceCrc(item.resourcePath, item.contentsCrc, index.getFile(item.fileIndex).crc32);
+						}
+
+						if (sink.convert && !sink.convert(item.resourcePath, item.storedData, item.contents))
+						{
+							SiegeThrow(TankFile::Error, "Failed to convert resource \"" << item.resourcePath << "\"!");
+						}
+						item.storedSpan.reset();
+						item.storedData = nullptr;
+					}
+					catch (std::exception & e)
+					{
+						failItem(item, e.what());
+						return false;
+					}
+					return true;
+				});
+				busySeconds += secondsSince(start);
+
+				if (!batch.empty())
+				{
+					writeQueue.push(std::move(batch));
+				}
+			}
+		}, abortPipeline);
+
+	// Decompression stage:
+	PipelineStage decodeStage(decodeThreads, &verifyQueue,
+		[&](double & busySeconds)
+		{
+			PipelineBatch batch;
+			while (decodeQueue.pop(batch))
+			{
+				const auto start = PipelineClock::now();
+				processBatch(batch, [&](PipelineItem & item)
+				{
+					const Index::FileRecord & resFile = index.getFile(item.fileIndex);
+					try
+					{
+						if (item.contentsRead)
+						{
+							return true;
+						}
+
+						item.contents = buffers.acquire(getExtractedSize(resFile));
+						if (!item.contents.empty())
+						{
+							item.crcComputed = decodeResourceData(tank, resFile, item.resourcePath, item.contents.data(),
+									validateCRCs, item.contentsCrc, item.storedData, /* parallelChunks = */ false);
+						}
+						else
+						{
+							SiegeWarn("Resource file entry \"" << index.getName(resFile) << "\" is flagged as invalid!");
+						}
+					}
+					catch (std::exception & e)
+					{
+						failItem(item, e.what());
+						return false;
+					}
+
+					// The read buffer goes back once the last of its resources is decoded,
+					// or converted, if the sink has a 'convert' that gets the stored bytes.
+					if (!sink.convert)
+					{
+						item.storedSpan.reset();
+						item.storedData = nullptr;
+					}
+					return true;
+				});
+				busySeconds += secondsSince(start);
+
+				if (!batch.empty())
+				{
+					verifyQueue.push(std::move(batch));
+				}
+			}
+		}, abortPipeline);
+
+	// I/O stage:
+	PipelineStage readStage(config.readThreads, &decodeQueue,
+		[&](double & busySeconds)
+		{
+			size_t b;
+			while ((b = nextBatch++) < readBatches.size())
+			{
+				const ReadBatch & readBatch = readBatches[b];
+				const Index::FileRecord & firstFile = index.getFile(files[readBatch.first]);
+
+				// An uncompressed resource on its own is read straight into its output buffer.
+				const bool readContents = !tank.isMemoryMapped() && (readBatch.last - readBatch.first) == 1 &&
+				                          !firstFile.isCompressed() && getExtractedSize(firstFile) != 0;
+
+				const uint64_t spanBudget = (tank.isMemoryMapped() || readContents) ? 0 : readBatch.readSize;
+				if (!budget.acquire(readBatch.extractedBytes + spanBudget))
+				{
+					break; // Pipeline aborted.
+				}
+
+				const auto start = PipelineClock::now();
+
+				// If the read fails, each resource is still tried on its own by the decode stage.
+				std::shared_ptr<PooledBuffer> storedSpan;
+				const uint8_t * storedData = nullptr;
+				PooledBuffer contents;
+				if (readContents)
+				{
+					contents = buffers.acquire(getExtractedSize(firstFile));
+					try
+					{
+						tank.readBytesAt(dataOffset + firstFile.offset, contents.data(), contents.size());
+						bytesRead += contents.size();
+						++readCalls;
+					}
+					catch (std::exception & e)
+					{
+						SiegeError(e.what());
+						buffers.release(std::move(contents));
+						contents.clear();
+					}
+				}
+				else if (spanBudget != 0)
+				{
+					storedSpan = std::shared_ptr<PooledBuffer>(new PooledBuffer(buffers.acquire(spanBudget)),
+						[&buffers, &budget, spanBudget](PooledBuffer * span)
+						{
+							buffers.release(std::move(*span));
+							budget.release(spanBudget);
+							delete span;
+						});
+					try
+					{
+						tank.readBytesAt(dataOffset + readBatch.readStart, storedSpan->data(), spanBudget);
+						storedData = storedSpan->data();
+						bytesRead += spanBudget;
+						++readCalls;
+					}
+					catch (std::exception & e)
+					{
+						SiegeError(e.what());
+						storedSpan.reset();
+					}
+				}
+				else if (tank.isMemoryMapped() && readBatch.readSize != 0)
+				{
+					try
+					{
+						storedData = tank.getMappedBytes(dataOffset + readBatch.readStart, readBatch.readSize);
+					}
+					catch (std::exception & e)
+					{
+						SiegeError(e.what());
+					}
+				}
+
+				PipelineBatch batch(readBatch.last - readBatch.first);
+				for (size_t f = readBatch.first; f < readBatch.last; ++f)
+				{
+					const Index::FileRecord & resFile = index.getFile(files[f]);
+					recordAccess(resFile);
+
+					PipelineItem & item = batch[f - readBatch.first];
+					item.fileIndex    = files[f];
+					item.budgetBytes  = getExtractedSize(resFile);
+					item.resourcePath = index.getPath(resFile).toString();
+					item.storedSpan   = storedSpan;
+					item.storedData   = (storedData != nullptr) ? storedData + (resFile.offset - readBatch.readStart) : nullptr;
+				}
+				if (!contents.empty())
+				{
+					batch[0].contents     = std::move(contents);
+					batch[0].contentsRead = true;
+				}
+
+				busySeconds += secondsSince(start);
+				if (!decodeQueue.push(std::move(batch)))
+				{
+					break; // Pipeline aborted.
+				}
+			}
+		}, abortPipeline);
+
+	ExtractionStats stats;
+	stats.readSeconds    = readStage.join();
+	stats.decodeSeconds  = decodeStage.join();
+	stats.verifySeconds  = verifyStage.join();
+	stats.writeSeconds   = writeStage.join();
+	stats.elapsedSeconds = secondsSince(startTime);
+
+	// The resources of a failed stage, and of any batch not read yet, were never
+	// written nor reported to the sink, so the failure is passed on to the caller.
+	for (const PipelineStage * stage : { &readStage, &decodeStage, &verifyStage, &writeStage })
+	{
+		if (const std::exception_ptr error = stage->getError())
+		{
+			std::rethrow_exception(error);
 		}
-		dirList.push_back(entry.first);
 	}
 
-	return dirList;
+	stats.filesWritten      = filesWritten;
+	stats.filesFailed       = filesFailed;
+	stats.readCalls         = readCalls;
+	stats.bytesRead         = bytesRead;
+	stats.bytesExtracted    = bytesExtracted;
+	stats.peakBytesInFlight = budget.getPeakBytesInFlight();
+	return stats;
+}
+
+// ========================================================
+// TankFile::Reader integrity check:
+// ========================================================
+
+namespace
+{
+
+// Bytes of the index or data section checksummed by each job of verify().
+constexpr uint64_t VerifyBlockSize = 8 * 1024 * 1024;
+
+// Empty if the chunk headers of a resource add up and its stored bytes are all inside
+// the data section, otherwise what is wrong. In 64 bits, since the values might be garbage.
+std::string checkResourceLayout(const TankFile::Index & index, const TankFile::Index::FileRecord & resFile,
+                                const std::string & resourcePath, const uint64_t dataSectionSize)
+{
+	uint64_t storedEnd = uint64_t(resFile.offset) + resFile.size;
+
+	if (resFile.isCompressed() && resFile.size != 0)
+	{
+		if (resFile.getDataFormat() != TankFile::DataFormat::Zlib && resFile.getDataFormat() != TankFile::DataFormat::Lzo)
+		{
+			return utils::format("Resource \"%s\" has an unknown data format (%u)!", resourcePath.c_str(), resFile.format);
+		}
+
+		const uint64_t expectedChunks = (resFile.chunkSize != 0) ?
+				(uint64_t(resFile.size) + resFile.chunkSize - 1) / resFile.chunkSize : 0;
+		if (resFile.numChunks != expectedChunks)
+		{
+			return utils::format("Resource \"%s\" has %u chunks of up to %u bytes for %u bytes!",
+					resourcePath.c_str(), resFile.numChunks, resFile.chunkSize, resFile.size);
+		}
+
+		uint64_t uncompressedTotal = 0;
+		storedEnd = resFile.offset;
+
+		const TankFile::Index::ChunkRecord * chunks = index.getChunks(resFile);
+		for (uint32_t c = 0; c < resFile.numChunks; ++c)
+		{
+			const TankFile::Index::ChunkRecord & chunk = chunks[c];
+			if (chunk.uncompressedSize == 0 || chunk.uncompressedSize > resFile.chunkSize || chunk.compressedSize == 0)
+			{
+				return utils::format("Chunk #%u of resource \"%s\" has bad sizes (%u compressed, %u uncompressed, chunk size %u)!",
+						c + 1, resourcePath.c_str(), chunk.compressedSize, chunk.uncompressedSize, resFile.chunkSize);
+			}
+
+			const uint32_t extraBytes = chunk.isCompressed() ? chunk.extraBytes : 0;
+			if (extraBytes > chunk.uncompressedSize)
+			{
+				return utils::format("Chunk #%u of resource \"%s\" has more extra bytes than uncompressed bytes!",
+						c + 1, resourcePath.c_str());
+			}
+
+			uncompressedTotal += chunk.uncompressedSize;
+			storedEnd = std::max(storedEnd, uint64_t(resFile.offset) + chunk.offset + chunk.compressedSize + extraBytes);
+		}
+
+		if (uncompressedTotal != resFile.size)
+		{
+			return utils::format("Chunks of resource \"%s\" add up to %llu bytes, expected %u!",
+					resourcePath.c_str(), static_cast<unsigned long long>(uncompressedTotal), resFile.size);
+		}
+	}
+
+	if (storedEnd > dataSectionSize)
+	{
+		return utils::format("Resource \"%s\" is stored past the end of the data section (%llu > %llu bytes)!",
+				resourcePath.c_str(), static_cast<unsigned long long>(storedEnd),
+				static_cast<unsigned long long>(dataSectionSize));
+	}
+	return {};
+}
+
+} // namespace {}
+
+TankFile::Reader::VerifyReport TankFile::Reader::verify(const TankFile & tank) const
+{
+	const PipelineClock::time_point startTime = PipelineClock::now();
+
+	VerifyReport report;
+	report.tankSizeBytes = tank.getFileSizeBytes();
+
+	// Same sections as indexFile(). The index either sits between the header and the
+	// data, ending at indexSize (header plus index), or after the data, up to the end.
+	const auto & header = tank.getFileHeader();
+	const bool indexFirst = std::min(header.dirsetOffset, header.filesetOffset) < header.dataOffset;
+	const uint64_t indexStart = std::min(header.dirsetOffset, header.filesetOffset);
+	const uint64_t indexEnd   = indexFirst ? header.indexSize : report.tankSizeBytes;
+	const uint64_t dataStart  = header.dataOffset;
+	const uint64_t dataEnd    = indexFirst ? report.tankSizeBytes : indexStart;
+
+	// CRC-32 of a range of the Tank, in blocks checksummed by the JobSystem
+	// and merged in file order. Mapped Tanks are checksummed in place.
+	const auto computeRangeCrc = [this, &tank](const uint64_t start, const uint64_t end)
+	{
+		std::vector<uint32_t> blockCrcs(static_cast<size_t>((end - start + VerifyBlockSize - 1) / VerifyBlockSize));
+
+		utils::JobGroup jobs(getJobSystem());
+		for (size_t b = 0; b < blockCrcs.size(); ++b)
+		{
+			jobs.run([&tank, &blockCrcs, start, end, b]()
+			{
+				const uint64_t blockStart = start + b * VerifyBlockSize;
+				const size_t   blockSize  = static_cast<size_t>(std::min(end - blockStart, VerifyBlockSize));
+				if (tank.isMemoryMapped())
+				{
+					blockCrcs[b] = utils::computeCrc32(tank.getMappedBytes(blockStart, blockSize), blockSize);
+				}
+				else
+				{
+					ByteArray block(blockSize);
+					tank.readBytesAt(blockStart, block.data(), blockSize);
+					blockCrcs[b] = utils::computeCrc32(block.data(), blockSize);
+				}
+			});
+		}
+		jobs.wait();
+
+		uint32_t crc = 0;
+		for (size_t b = 0; b < blockCrcs.size(); ++b)
+		{
+			const uint64_t blockStart = start + b * VerifyBlockSize;
+			crc = utils::crc32::combine(crc, blockCrcs[b], std::min(end - blockStart, VerifyBlockSize));
+		}
+		return crc;
+	};
+
+	if (indexStart >= indexEnd || indexEnd > report.tankSizeBytes)
+	{
+		report.tankErrors.push_back(utils::format("Index section [%llu, %llu) is out of the file bounds!",
+				static_cast<unsigned long long>(indexStart), static_cast<unsigned long long>(indexEnd)));
+	}
+	else if (header.indexCrc32 != InvalidChecksum)
+	{
+		report.indexCrcChecked    = true;
+		report.computedIndexCrc32 = computeRangeCrc(indexStart, indexEnd);
+		if (report.computedIndexCrc32 != header.indexCrc32)
+		{
+			report.tankErrors.push_back(utils::format("Index CRC (0x%08X) does not match the header's (0x%08X)!",
+					report.computedIndexCrc32, header.indexCrc32));
+		}
+	}
+
+	// Checked first, so the resources below are read from the file cache.
+	if (dataStart > dataEnd || dataEnd > report.tankSizeBytes)
+	{
+		report.tankErrors.push_back(utils::format("Data section [%llu, %llu) is out of the file bounds!",
+				static_cast<unsigned long long>(dataStart), static_cast<unsigned long long>(dataEnd)));
+	}
+	else if (header.dataCrc32 != InvalidChecksum)
+	{
+		report.dataCrcChecked    = true;
+		report.computedDataCrc32 = computeRangeCrc(dataStart, dataEnd);
+		if (report.computedDataCrc32 != header.dataCrc32)
+		{
+			report.tankErrors.push_back(utils::format("Data CRC (0x%08X) does not match the header's (0x%08X)!",
+					report.computedDataCrc32, header.dataCrc32));
+		}
+	}
+
+	const uint64_t dataSectionSize = (dataStart <= dataEnd) ? dataEnd - dataStart : 0;
+	std::mutex failuresMutex;
+
+	// Resources with broken chunk headers are reported right away and never read.
+	// The rest are decompressed and checked by the pipeline, then dropped.
+	ResourceSink sink;
+	sink.select = [&](const std::string & resourcePath, const Index::FileRecord & resFile)
+	{
+		if (resFile.isInvalidFile())
+		{
+			++report.invalidFiles;
+			return false;
+		}
+
+		++report.filesChecked;
+		std::string errorText = checkResourceLayout(index, resFile, resourcePath, dataSectionSize);
+		if (!errorText.empty())
+		{
+			SiegeError(errorText);
+			report.failures.push_back({ resourcePath, std::move(errorText) });
+			return false;
+		}
+		return true;
+	};
+	sink.write = [](const std::string &, ResourceBuffer &)
+	{
+		return true;
+	};
+	sink.error = [&](const std::string & resourcePath, const std::string & errorText)
+	{
+		std::lock_guard<std::mutex> lock(failuresMutex);
+		report.failures.push_back({ resourcePath, errorText });
+	};
+
+	report.stats = extractAllResources(tank, sink, /* validateCRCs = */ true);
+
+	std::sort(std::begin(report.failures), std::end(report.failures),
+		[](const VerifyReport::Failure & a, const VerifyReport::Failure & b)
+		{
+			return a.resourcePath < b.resourcePath;
+		});
+
+	report.elapsedSeconds = secondsSince(startTime);
+
+	TankReaderLog("Verified Tank \"" << tank.getFileName() << "\": " << report.failures.size() << " of "
+			<< report.filesChecked << " resources failed, " << report.tankErrors.size() << " Tank errors.");
+
+	return report;
+}
+
+uint32_t TankFile::Reader::getResourceSize(const TankFile & tank, const std::string & resourcePath) const
+{
+	return findFileEntry(tank, resourcePath).size;
+}
+
+namespace
+{
+
+// Tank paths are absolute. Lets the queries below take "art/maps" for "/art/maps".
+std::string makeAbsoluteTankPath(const std::string & path)
+{
+	const char pathSeparator = utils::filesys::getPathSeparator()[0];
+	return (!path.empty() && path[0] == pathSeparator) ? path : (pathSeparator + path);
+}
+
+} // namespace {}
+
+TankFile::Reader::DirectoryListing TankFile::Reader::listDirectory(const std::string & dirPath) const
+{
+	std::string fullPath = makeAbsoluteTankPath(dirPath);
+	if (fullPath.back() != utils::filesys::getPathSeparator()[0])
+	{
+		fullPath += utils::filesys::getPathSeparator();
+	}
+
+	const uint32_t dirIndex = index.findDir(fullPath);
+	if (dirIndex == Index::InvalidIndex)
+	{
+		SiegeThrow(TankFile::Error, "Directory \"" << fullPath << "\" not found in Tank!");
+	}
+
+	const Index::DirRecord & dir = index.getDir(dirIndex);
+	return { index.getSubdirPaths(dir), index.getFilePaths(dir) };
+}
+
+TankFile::Index::PathList TankFile::Reader::getFileListWithPrefix(const std::string & prefix) const
+{
+	return index.getFilePathsWithPrefix(makeAbsoluteTankPath(prefix));
+}
+
+TankFile::Index::GlobList TankFile::Reader::getFileListMatching(const std::string & pattern) const
+{
+	return index.getFilePathsMatching(makeAbsoluteTankPath(pattern));
+}
+
+std::vector<utils::StringView> TankFile::Reader::getFileListInDataOrder() const
+{
+	std::vector<utils::StringView> paths;
+	for (const uint32_t fileIndex : getFilesInDataOrder())
+	{
+		paths.push_back(index.getPath(index.getFile(fileIndex)));
+	}
+	return paths;
+}
+
+std::vector<uint32_t> TankFile::Reader::getFilesInDataOrder() const
+{
+	std::vector<uint32_t> files;
+	files.reserve(index.getFileCount());
+
+	// Duplicate paths are adjacent in the sorted list. Only the one found by path is kept.
+	utils::StringView previousPath;
+	for (const utils::StringView path : index.getFilePaths())
+	{
+		if (path != previousPath)
+		{
+			files.push_back(index.findFile(path));
+			previousPath = path;
+		}
+	}
+
+	std::sort(std::begin(files), std::end(files), [this](const uint32_t a, const uint32_t b)
+	{
+		const uint32_t offsetA = index.getFile(a).offset;
+		const uint32_t offsetB = index.getFile(b).offset;
+		return (offsetA != offsetB) ? (offsetA < offsetB) : (a < b);
+	});
+	return files;
 }
 
 #undef TankReaderLog
@@ -0,0 +1,166 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: tank_file_resource_stream.cpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: TankFile::ResourceStream inner class implementation.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "siege/tank_file.hpp"
+#include <algorithm>
+
+namespace siege
+{
+
+// ========================================================
+// TankFile::ResourceStream:
+// ========================================================
+
+constexpr uint32_t TankFile::ResourceStream::RawBlockSize;
+
+TankFile::ResourceStream::ResourceStream(const Reader & rdr, const TankFile & tankFile,
+                                         const std::string & path, const bool validate)
+	: reader(rdr)
+	, tank(tankFile)
+	, resourcePath(path)
+	, resFile(rdr.findFileEntry(tankFile, path))
+	, validateCRCs(validate)
+{
+	reader.recordAccess(resFile);
+
+	if (resFile.isInvalidFile() || resFile.size == 0)
+	{
+		// Same as Reader::extractResourceToMemory(), these are just empty.
+		SiegeWarn("Resource file entry \"" << reader.index.getName(resFile) << "\" is flagged as invalid!");
+		return;
+	}
+
+	resourceSize = resFile.size;
+
+	if (resFile.isCompressed())
+	{
+		const Index::ChunkRecord * const chunks = reader.index.getChunks(resFile);
+		uint64_t totalSize = 0;
+		for (uint32_t c = 0; c < resFile.numChunks; ++c)
+		{
+			totalSize += chunks[c].uncompressedSize;
+		}
+
+		if (totalSize != resFile.size)
+		{
+			SiegeThrow(TankFile::Error, "Chunks of resource \"" << resourcePath << "\" add up to "
+					<< totalSize << " bytes, but the resource size is " << resFile.size << " bytes!");
+		}
+		numChunks = resFile.numChunks;
+	}
+	else
+	{
+		numChunks = (resFile.size + RawBlockSize - 1) / RawBlockSize;
+	}
+}
+
+bool TankFile::ResourceStream::nextChunk()
+{
+	chunkData    = nullptr;
+	chunkSize    = 0;
+	chunkReadPos = 0;
+
+	if (nextChunkIndex == numChunks)
+	{
+		return false;
+	}
+
+	const uint32_t chunkIndex = nextChunkIndex++;
+	const size_t dataOffset = tank.getFileHeader().dataOffset + resFile.offset;
+
+	if (resFile.isCompressed())
+	{
+		const Index::ChunkRecord & chunk = reader.index.getChunks(resFile)[chunkIndex];
+		chunkSize = chunk.uncompressedSize;
+
+		if (!chunk.isCompressed() && tank.isMemoryMapped())
+		{
+			chunkData = tank.getMappedBytes(dataOffset + chunk.offset, chunkSize);
+		}
+		else
+		{
+			// Buffers only grow up to the biggest chunk of the resource.
+			if (chunkBuffer.size() < chunkSize)
+			{
+				chunkBuffer.resize(chunkSize);
+			}
+			reader.decompressChunk(tank, resFile, resourcePath, chunkIndex, chunkBuffer.data(), compressedData);
+			chunkData = chunkBuffer.data();
+		}
+	}
+	else
+	{
+		const size_t blockOffset = size_t(chunkIndex) * RawBlockSize;
+		chunkSize = std::min<size_t>(RawBlockSize, resFile.size - blockOffset);
+
+		if (tank.isMemoryMapped())
+		{
+			chunkData = tank.getMappedBytes(dataOffset + blockOffset, chunkSize);
+		}
+		else
+		{
+			if (chunkBuffer.size() < chunkSize)
+			{
+				chunkBuffer.resize(chunkSize);
+			}
+			tank.readBytesAt(dataOffset + blockOffset, chunkBuffer.data(), chunkSize);
+			chunkData = chunkBuffer.data();
+		}
+	}
+
+	bytesStreamed += chunkSize;
+
+	if (validateCRCs)
+	{
+		if (chunkSize != 0)
+		{
+			runningCrc = utils::computeCrc32(chunkData, chunkSize, runningCrc);
+		}
+
+		if (nextChunkIndex == numChunks && runningCrc != resFile.crc32)
+		{
+			auto errorInfo = utils::format("Tank resource \"%s\" CRC (0x%08X) does not match the expected (0x%08X)!",
+					resourcePath.c_str(), runningCrc, resFile.crc32);
+
+			SiegeThrow(TankFile::Error, errorInfo);
+		}
+	}
+
+	return true;
+}
+
+size_t TankFile::ResourceStream::read(void * buffer, const size_t numBytes)
+{
+	assert(buffer != nullptr || numBytes == 0);
+
+	auto * dest = static_cast<uint8_t *>(buffer);
+	size_t bytesCopied = 0;
+
+	while (bytesCopied < numBytes)
+	{
+		if (chunkReadPos == chunkSize && !nextChunk())
+		{
+			break;
+		}
+
+		const size_t count = std::min(numBytes - bytesCopied, chunkSize - chunkReadPos);
+		std::memcpy(dest + bytesCopied, chunkData + chunkReadPos, count);
+
+		chunkReadPos += count;
+		bytesCopied  += count;
+	}
+
+	return bytesCopied;
+}
+
+} // namespace siege {}
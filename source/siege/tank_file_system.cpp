@@ -0,0 +1,271 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: tank_file_system.cpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: Virtual file system that merges several Tank files into a single tree.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "siege/tank_file_system.hpp"
+#include <algorithm>
+
+namespace siege
+{
+
+// ========================================================
+// TankFileSystem:
+// ========================================================
+
+TankFileSystem::TankFileSystem(const TankFile::IOMode ioMode)
+	: tankIOMode(ioMode)
+{
+}
+
+void TankFileSystem::mountTank(const std::string & tankFilename)
+{
+	openTank(tankFilename);
+	rebuildTable();
+}
+
+unsigned int TankFileSystem::mountDirectory(const std::string & dirPath, const std::vector<std::string> & extensions)
+{
+	std::vector<std::string> dirFiles;
+	if (!utils::filesys::listFiles(dirPath, dirFiles, /* recursive = */ true))
+	{
+		SiegeThrow(TankFile::Error, "Unable to list directory \"" << dirPath << "\": "
+				<< utils::filesys::getLastFileError());
+	}
+
+	// Sorted so the mount order of same priority Tanks doesn't depend on the file system.
+	std::sort(std::begin(dirFiles), std::end(dirFiles));
+
+	unsigned int tanksMounted = 0;
+	for (const auto & filename : dirFiles)
+	{
+		const std::string extension = utils::filesys::getFilenameExtension(filename);
+		if (std::find(std::begin(extensions), std::end(extensions), extension) == std::end(extensions))
+		{
+			continue;
+		}
+
+		try
+		{
+			openTank(filename);
+			++tanksMounted;
+		}
+		catch (const TankFile::Error & e)
+		{
+			SiegeWarn("Skipping \"" << filename << "\": " << e.what());
+		}
+	}
+
+	rebuildTable();
+	return tanksMounted;
+}
+
+void TankFileSystem::unmountAll()
+{
+	table.clear();
+	tanks.clear();
+	numUniqueFiles = 0;
+}
+
+void TankFileSystem::setAccessTraceEnabled(const bool enable)
+{
+	traceAccesses = enable;
+	for (auto & tank : tanks)
+	{
+		tank.reader->setAccessTraceEnabled(enable);
+	}
+}
+
+bool TankFileSystem::findFile(const utils::StringView path, Location & locationOut) const
+{
+	if (table.empty())
+	{
+		return false;
+	}
+
+	const uint32_t hash = hashPath(path);
+	const uint32_t mask = static_cast<uint32_t>(table.size() - 1);
+
+	for (uint32_t i = hash & mask; ; i = (i + 1) & mask)
+	{
+		const Slot & slot = table[i];
+		if (slot.tankIndex == TankFile::Index::InvalidIndex)
+		{
+			return false;
+		}
+		if (slot.hash == hash && getSlotPath(slot) == path)
+		{
+			locationOut.tankIndex = slot.tankIndex;
+			locationOut.fileIndex = slot.fileIndex;
+			return true;
+		}
+	}
+}
+
+bool TankFileSystem::fileExists(const utils::StringView path) const
+{
+	Location location;
+	return findFile(path, location);
+}
+
+ByteArray TankFileSystem::extractResourceToMemory(const std::string & resourcePath, const bool validateCRCs) const
+{
+	Location location;
+	if (!findFile(resourcePath, location))
+	{
+		SiegeThrow(TankFile::Error, "Resource \"" << resourcePath << "\" not found in any mounted Tank!");
+	}
+
+	const MountedTank & tank = tanks[location.tankIndex];
+	return tank.reader->extractResourceToMemory(*tank.file, resourcePath, validateCRCs);
+}
+
+void TankFileSystem::extractResourceToFile(const std::string & resourcePath,
+                                           const std::string & destFile, const bool validateCRCs) const
+{
+	Location location;
+	if (!findFile(resourcePath, location))
+	{
+		SiegeThrow(TankFile::Error, "Resource \"" << resourcePath << "\" not found in any mounted Tank!");
+	}
+
+	const MountedTank & tank = tanks[location.tankIndex];
+	tank.reader->extractResourceToFile(*tank.file, resourcePath, destFile, validateCRCs);
+}
+
+uint32_t TankFileSystem::getResourceSize(const std::string & resourcePath) const
+{
+	Location location;
+	if (!findFile(resourcePath, location))
+	{
+		SiegeThrow(TankFile::Error, "Resource \"" << resourcePath << "\" not found in any mounted Tank!");
+	}
+
+	return tanks[location.tankIndex].reader->getIndex().getFile(location.fileIndex).size;
+}
+
+const TankFile & TankFileSystem::getTank(const unsigned int tankIndex) const
+{
+	assert(tankIndex < tanks.size());
+	return *tanks[tankIndex].file;
+}
+
+const TankFile::Reader & TankFileSystem::getTankReader(const unsigned int tankIndex) const
+{
+	assert(tankIndex < tanks.size());
+	return *tanks[tankIndex].reader;
+}
+
+uint32_t TankFileSystem::hashPath(const utils::StringView path) noexcept
+{
+	// 32-bit FNV-1a.
+	uint32_t hash = 2166136261u;
+	for (const char c : path)
+	{
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+utils::StringView TankFileSystem::getSlotPath(const Slot & slot) const
+{
+	const TankFile::Index & index = tanks[slot.tankIndex].reader->getIndex();
+	return index.getPath(index.getFile(slot.fileIndex));
+}
+
+void TankFileSystem::openTank(const std::string & tankFilename)
+{
+	MountedTank tank;
+	tank.file.reset(new TankFile());
+	tank.reader.reset(new TankFile::Reader());
+
+	tank.file->openForReading(tankFilename, tankIOMode);
+	if (useIndexCache)
+	{
+		tank.reader->indexFileCached(*tank.file, TankFile::Reader::getDefaultIndexCacheFile(*tank.file));
+	}
+	else
+	{
+		tank.reader->indexFile(*tank.file);
+	}
+	tank.reader->setAccessTraceEnabled(traceAccesses);
+
+	tanks.push_back(std::move(tank));
+}
+
+void TankFileSystem::rebuildTable()
+{
+	size_t totalFiles = 0;
+	for (const auto & tank : tanks)
+	{
+		totalFiles += tank.reader->getFileCount();
+	}
+
+	// Keep the load factor at or below 50%.
+	size_t tableSize = 16;
+	while (tableSize < totalFiles * 2)
+	{
+		tableSize *= 2;
+	}
+
+	const Slot emptySlot = { 0, TankFile::Index::InvalidIndex, TankFile::Index::InvalidIndex };
+	table.assign(tableSize, emptySlot);
+	numUniqueFiles = 0;
+
+	// Insert from lowest to highest priority. An insert replaces any
+	// previous entry with the same path, so the last insert wins.
+	std::vector<uint32_t> mountOrder(tanks.size());
+	for (uint32_t t = 0; t < mountOrder.size(); ++t)
+	{
+		mountOrder[t] = t;
+	}
+	std::stable_sort(std::begin(mountOrder), std::end(mountOrder), [this](const uint32_t a, const uint32_t b)
+	{
+		return tanks[a].file->getFileHeader().priority < tanks[b].file->getFileHeader().priority;
+	});
+
+	const uint32_t mask = static_cast<uint32_t>(tableSize - 1);
+	for (const uint32_t t : mountOrder)
+	{
+		const TankFile::Index & index = tanks[t].reader->getIndex();
+		const uint32_t numFiles = index.getFileCount();
+
+		for (uint32_t f = 0; f < numFiles; ++f)
+		{
+			const utils::StringView path = index.getPath(index.getFile(f));
+			const uint32_t hash = hashPath(path);
+
+			for (uint32_t i = hash & mask; ; i = (i + 1) & mask)
+			{
+				Slot & slot = table[i];
+				if (slot.tankIndex == TankFile::Index::InvalidIndex)
+				{
+					slot = { hash, t, f };
+					++numUniqueFiles;
+					break;
+				}
+				if (slot.hash == hash && getSlotPath(slot) == path)
+				{
+					// Within one Tank, the first duplicate stays, same as the Reader.
+					if (slot.tankIndex != t)
+					{
+						slot.tankIndex = t;
+						slot.fileIndex = f;
+					}
+					break;
+				}
+			}
+		}
+	}
+}
+
+} // namespace siege {}
@@ -0,0 +1,121 @@
+#pragma once
+// ================================================================================================
+// -*- C++ -*-
+// File: tank_file_system.hpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: Virtual file system that merges several Tank files into a single tree.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "siege/tank_file.hpp"
+
+namespace siege
+{
+
+// ========================================================
+// TankFileSystem:
+// ========================================================
+
+//
+// Mounts any number of Tank files and resolves resource paths across all of
+// them, like the master index of the original engine. When the same path is
+// present in more than one Tank, the one with the highest TankFile::Priority
+// wins (e.g. a Patch overrides the Factory Tanks). For Tanks of equal priority,
+// the last one mounted wins.
+//
+// All paths are kept in one merged hash table that only refers back to the
+// index of each Tank, so a lookup is O(1) regardless of how many Tanks are mounted.
+//
+// Mounting is not thread safe. Once all Tanks are mounted, any number of
+// threads may look up and extract resources at the same time.
+//
+class TankFileSystem final
+	: public utils::NonCopyable
+{
+public:
+
+	// Where a path resolved to.
+	struct Location
+	{
+		uint32_t tankIndex; // Index of the mounted Tank, see getTank().
+		uint32_t fileIndex; // Index of the FileRecord in that Tank's index.
+	};
+
+	explicit TankFileSystem(TankFile::IOMode ioMode = TankFile::IOMode::MemoryMapped);
+
+	// Opens and indexes a single Tank file. Throws TankFile::Error on failure.
+	void mountTank(const std::string & tankFilename);
+
+	// Mounts every file under 'dirPath' (and its subdirectories) with one of the given extensions
+	// (".dsres" and ".dsmap" by default), in alphabetical order of path. Files that are not valid
+	// Tanks are skipped with a warning. Returns the number of Tanks mounted. Throws TankFile::Error
+	// if the directory can't be read.
+	unsigned int mountDirectory(const std::string & dirPath,
+	                            const std::vector<std::string> & extensions = { ".dsres", ".dsmap" });
+
+	// Closes all the Tanks.
+	void unmountAll();
+
+	// Tanks are indexed with TankFile::Reader::indexFileCached() and the default
+	// cache file if this is enabled before mounting. Off by default.
+	void setUseIndexCache(bool useCache) noexcept { useIndexCache = useCache; }
+	bool getUseIndexCache() const noexcept { return useIndexCache; }
+
+	// Enables TankFile::Reader::setAccessTraceEnabled() on all mounted Tanks and the ones mounted
+	// after. Each Tank keeps its own trace, see getTankReader(). Off by default.
+	void setAccessTraceEnabled(bool enable);
+	bool isAccessTraceEnabled() const noexcept { return traceAccesses; }
+
+	// Finds the winning copy of a file. Returns false if no mounted Tank has it.
+	bool findFile(utils::StringView path, Location & locationOut) const;
+	bool fileExists(utils::StringView path) const;
+
+	// Same as the TankFile::Reader methods, but for the winning copy of the file.
+	// Throw TankFile::Error if the path is not found in any of the mounted Tanks.
+	ByteArray extractResourceToMemory(const std::string & resourcePath, bool validateCRCs) const;
+	void extractResourceToFile(const std::string & resourcePath, const std::string & destFile, bool validateCRCs) const;
+	uint32_t getResourceSize(const std::string & resourcePath) const;
+
+	// Mounted Tanks, in mount order.
+	unsigned int getTankCount() const noexcept { return static_cast<unsigned int>(tanks.size()); }
+	const TankFile & getTank(unsigned int tankIndex) const;
+	const TankFile::Reader & getTankReader(unsigned int tankIndex) const;
+
+	// Number of unique file paths across all mounted Tanks.
+	unsigned int getFileCount() const noexcept { return numUniqueFiles; }
+
+private:
+
+	struct MountedTank
+	{
+		std::unique_ptr<TankFile>         file;
+		std::unique_ptr<TankFile::Reader> reader;
+	};
+
+	// Slot of the open addressing hash table. Empty if tankIndex is InvalidIndex.
+	struct Slot
+	{
+		uint32_t hash;
+		uint32_t tankIndex;
+		uint32_t fileIndex;
+	};
+
+	static uint32_t hashPath(utils::StringView path) noexcept;
+	utils::StringView getSlotPath(const Slot & slot) const;
+
+	void openTank(const std::string & tankFilename);
+	void rebuildTable();
+
+	const TankFile::IOMode   tankIOMode;
+	bool                     useIndexCache  = false;
+	bool                     traceAccesses  = false;
+	unsigned int             numUniqueFiles = 0;
+	std::vector<MountedTank> tanks;
+	std::vector<Slot>        table; // Size is always a power of two.
+};
+
+} // namespace siege {}
@@ -0,0 +1,1021 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: tank_file_writer.cpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: TankFile::Writer inner class implementation.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "siege/tank_file.hpp"
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <functional>
+#include <map>
+#include <random>
+
+namespace siege
+{
+
+// ========================================================
+// Local helpers:
+// ========================================================
+
+namespace
+{
+
+template<typename T>
+inline T alignUp(const T value, const T alignment) noexcept
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// Little endian serialization of the Tank structures.
+class ByteWriter final
+{
+public:
+
+	explicit ByteWriter(ByteArray & out) noexcept
+		: bytes(out)
+	{ }
+
+	void writeBytes(const void * data, const size_t numBytes)
+	{
+		const auto * ptr = static_cast<const uint8_t *>(data);
+		bytes.insert(bytes.end(), ptr, ptr + numBytes);
+	}
+
+	void writeU16(const uint16_t x) { writeBytes(&x, sizeof(x)); }
+	void writeU32(const uint32_t x) { writeBytes(&x, sizeof(x)); }
+
+	// NSTRING: a word with the length, the chars plus a null terminator, padded to a dword.
+	void writeNString(const std::string & str)
+	{
+		writeU16(static_cast<uint16_t>(str.length()));
+		writeBytes(str.c_str(), str.length() + 1);
+		padToDword();
+	}
+
+	// WNSTRING: same as above, with 2-byte chars.
+	void writeWNString(const WideString & str)
+	{
+		writeU16(static_cast<uint16_t>(str.length()));
+		writeBytes(str.c_str(), (str.length() + 1) * sizeof(WideChar));
+		padToDword();
+	}
+
+	void padToDword()
+	{
+		bytes.resize(alignUp<size_t>(bytes.size(), 4), 0);
+	}
+
+	size_t getSize() const noexcept { return bytes.size(); }
+
+private:
+
+	ByteArray & bytes;
+};
+
+// Size of an NSTRING written by the above.
+inline uint32_t getNStringSize(const std::string & str) noexcept
+{
+	return alignUp<uint32_t>(static_cast<uint32_t>(sizeof(uint16_t) + str.length() + 1), 4);
+}
+
+template<size_t N>
+void copyToWideChars(WideChar (&dest)[N], const std::string & text)
+{
+	// Plain widening, the reverse of wideStringToStdString().
+	const size_t count = std::min(text.length(), N - 1);
+	for (size_t i = 0; i < count; ++i)
+	{
+		dest[i] = static_cast<uint8_t>(text[i]);
+	}
+	std::fill(dest + count, dest + N, WideChar(0));
+}
+
+Guid makeRandomGuid()
+{
+	std::random_device device;
+	std::mt19937 random(device() ^ static_cast<uint32_t>(std::time(nullptr)));
+
+	Guid guid;
+	guid.data1 = random();
+	guid.data2 = static_cast<uint16_t>(random());
+	guid.data3 = static_cast<uint16_t>((random() & 0x0FFF) | 0x4000); // Version 4 (random)
+	for (auto & b : guid.data4)
+	{
+		b = static_cast<uint8_t>(random());
+	}
+	guid.data4[0] = static_cast<uint8_t>((guid.data4[0] & 0x3F) | 0x80); // RFC 4122 variant
+	return guid;
+}
+
+SystemTime makeUtcSystemTime(const time_t t)
+{
+	std::tm utc = {};
+	#ifdef _MSC_VER
+	gmtime_s(&utc, &t);
+	#else // _MSC_VER
+	gmtime_r(&t, &utc);
+	#endif // _MSC_VER
+
+	SystemTime st;
+	st.year         = static_cast<uint16_t>(utc.tm_year + 1900);
+	st.month        = static_cast<uint16_t>(utc.tm_mon + 1);
+	st.dayOfWeek    = static_cast<uint16_t>(utc.tm_wday);
+	st.day          = static_cast<uint16_t>(utc.tm_mday);
+	st.hour         = static_cast<uint16_t>(utc.tm_hour);
+	st.minute       = static_cast<uint16_t>(utc.tm_min);
+	st.second       = static_cast<uint16_t>(utc.tm_sec);
+	st.milliseconds = 0;
+	return st;
+}
+
+ByteArray serializeHeader(const TankFile::Header & header)
+{
+	ByteArray bytes;
+	ByteWriter writer(bytes);
+
+	writer.writeBytes(&header.productId, sizeof(header.productId));
+	writer.writeBytes(&header.tankId,    sizeof(header.tankId));
+	writer.writeU32(header.headerVersion);
+	writer.writeU32(header.dirsetOffset);
+	writer.writeU32(header.filesetOffset);
+	writer.writeU32(header.indexSize);
+	writer.writeU32(header.dataOffset);
+	writer.writeBytes(&header.productVersion, sizeof(header.productVersion));
+	writer.writeBytes(&header.minimumVersion, sizeof(header.minimumVersion));
+	writer.writeU32(static_cast<uint32_t>(header.priority));
+	writer.writeU32(header.flags);
+	writer.writeBytes(&header.creatorId, sizeof(header.creatorId));
+	writer.writeBytes(&header.guid, sizeof(header.guid));
+	writer.writeU32(header.indexCrc32);
+	writer.writeU32(header.dataCrc32);
+	writer.writeBytes(&header.utcBuildTime,  sizeof(header.utcBuildTime));
+	writer.writeBytes(header.copyrightText,  sizeof(header.copyrightText));
+	writer.writeBytes(header.buildText,      sizeof(header.buildText));
+	writer.writeBytes(header.titleText,      sizeof(header.titleText));
+	writer.writeBytes(header.authorText,     sizeof(header.authorText));
+	writer.writeWNString(header.descriptionText);
+
+	return bytes;
+}
+
+} // namespace {}
+
+// ========================================================
+// TankFile::Writer internal types:
+// ========================================================
+
+struct TankFile::Writer::PackedChunk
+{
+	uint32_t  uncompressedSize;
+	uint32_t  compressedSize; // Same as uncompressedSize if the chunk is stored.
+	uint32_t  extraBytes;
+	uint32_t  offset;         // From the start of the resource data.
+	ByteArray data;           // Compressed bytes followed by the extra bytes. Empty if stored.
+};
+
+struct TankFile::Writer::PackedResource
+{
+	uint32_t                 resourceIndex = 0;
+	DataFormat               format        = DataFormat::Raw;
+	uint16_t                 flags         = FileFlagNone;
+	uint32_t                 crc32         = 0;
+	uint32_t                 dataOffset    = 0; // (DO)
+	uint32_t                 storedSize    = 0; // Bytes taken in the data section.
+	uint32_t                 chunkSize     = 0;
+	bool                     copied        = false; // Contents are the stored data of another Tank.
+	std::vector<PackedChunk> chunks;                // Empty for Raw resources.
+};
+
+struct TankFile::Writer::DirNode
+{
+	std::string           name;
+	uint32_t              parent;
+	std::vector<uint32_t> subdirs; // DirNode indexes, sorted by name.
+	std::vector<uint32_t> files;   // Resource indexes, sorted by name.
+};
+
+// ========================================================
+// TankFile::Writer:
+// ========================================================
+
+constexpr uint32_t TankFile::Writer::DefaultChunkSize;
+
+TankFile::Writer::Writer()
+{
+	header.productId     = TankFile::ProductId_DS1;
+	header.tankId        = TankFile::TankId;
+	header.headerVersion = Header::ExpectedVersion_DS1;
+	header.priority      = Priority::User;
+	header.flags         = TankFlagNone;
+	header.creatorId     = TankFile::CreatorIdUser;
+}
+
+TankFile::Writer::~Writer()
+{
+	// Defined here, where PackedResource & co are complete.
+}
+
+void TankFile::Writer::setTitleText(const std::string & text)
+{
+	copyToWideChars(header.titleText, text);
+}
+
+void TankFile::Writer::setAuthorText(const std::string & text)
+{
+	copyToWideChars(header.authorText, text);
+}
+
+void TankFile::Writer::setCopyrightText(const std::string & text)
+{
+	copyToWideChars(header.copyrightText, text);
+}
+
+void TankFile::Writer::setBuildText(const std::string & text)
+{
+	copyToWideChars(header.buildText, text);
+}
+
+void TankFile::Writer::setDescriptionText(const std::string & text)
+{
+	header.descriptionText.assign(text.begin(), text.end());
+}
+
+void TankFile::Writer::setChunkSize(const uint32_t sizeBytes) noexcept
+{
+	constexpr uint32_t PageSize = 4 * 1024;
+	chunkSize = std::max(PageSize, alignUp(sizeBytes, PageSize));
+}
+
+void TankFile::Writer::addResource(const std::string & resourcePath, ByteArray contents,
+                                   const DataFormat format, const FileTime fileTime)
+{
+	if (format != DataFormat::Raw && format != DataFormat::Zlib)
+	{
+		SiegeThrow(TankFile::Error, "Can't write resource \"" << resourcePath << "\" as "
+				<< dataFormatToString(format) << ". Only Raw and Zlib are supported.");
+	}
+	if (contents.size() > UINT32_MAX)
+	{
+		SiegeThrow(TankFile::Error, "Resource \"" << resourcePath << "\" is too big for a Tank file!");
+	}
+
+	Resource res;
+	res.path     = normalizePath(resourcePath);
+	res.format   = format;
+	res.fileTime = fileTime;
+	res.size     = static_cast<uint32_t>(contents.size());
+	res.contents = std::move(contents);
+	resources.push_back(std::move(res));
+}
+
+void TankFile::Writer::addResourceFromFile(const std::string & resourcePath, const std::string & sourceFile,
+                                           const DataFormat format, const FileTime fileTime)
+{
+	size_t fileSize = 0;
+	if (!utils::filesys::queryFileSize(sourceFile, fileSize))
+	{
+		SiegeThrow(TankFile::Error, "Unable to access file \"" << sourceFile << "\": "
+				<< utils::filesys::getLastFileError());
+	}
+
+	// Keeps the time the file was last changed, as the game's Tank builder does.
+	FileTime resourceTime = fileTime;
+	std::time_t modificationTime = 0;
+	if (resourceTime.toU64() == 0 && utils::filesys::queryFileModificationTime(sourceFile, modificationTime))
+	{
+		resourceTime = FileTime::fromPortableTime(modificationTime);
+	}
+
+	addResource(resourcePath, ByteArray(), format, resourceTime);
+	if (fileSize > UINT32_MAX)
+	{
+		resources.pop_back();
+		SiegeThrow(TankFile::Error, "Resource \"" << resourcePath << "\" is too big for a Tank file!");
+	}
+
+	resources.back().sourceFile = sourceFile;
+	resources.back().size       = static_cast<uint32_t>(fileSize);
+}
+
+unsigned int TankFile::Writer::addResourcesFromDirectory(const std::string & sourceDir, const std::string & tankDir,
+                                                         const DataFormat format)
+{
+	std::string dirPath = sourceDir;
+	while (dirPath.size() > 1 && (dirPath.back() == '/' || dirPath.back() == '\\'))
+	{
+		dirPath.pop_back();
+	}
+
+	std::vector<std::string> dirFiles;
+	if (!utils::filesys::listFiles(dirPath, dirFiles, /* recursive = */ true))
+	{
+		SiegeThrow(TankFile::Error, "Unable to list directory \"" << sourceDir << "\": "
+				<< utils::filesys::getLastFileError());
+	}
+
+	std::string tankPrefix = tankDir;
+	if (tankPrefix.empty() || tankPrefix.back() != '/')
+	{
+		tankPrefix += '/';
+	}
+
+	for (const auto & filename : dirFiles)
+	{
+		// listFiles() returns dirPath + separator + relative path.
+		addResourceFromFile(tankPrefix + filename.substr(dirPath.length() + 1), filename, format);
+	}
+
+	return static_cast<unsigned int>(dirFiles.size());
+}
+
+void TankFile::Writer::addResourceFromTank(const Reader & reader, const TankFile & tank, const std::string & resourcePath)
+{
+	const Index & index = reader.getIndex();
+	const uint32_t fileIndex = index.findFile(resourcePath);
+	if (fileIndex == Index::InvalidIndex)
+	{
+		SiegeThrow(TankFile::Error, "Resource \"" << resourcePath << "\" not found in Tank file \""
+				<< tank.getFileName() << "\"!");
+	}
+
+	const Index::FileRecord & resFile = index.getFile(fileIndex);
+	const uint64_t storedEnd = uint64_t(tank.getFileHeader().dataOffset) + resFile.offset + index.getStoredSize(resFile);
+	if (storedEnd > tank.getFileSizeBytes())
+	{
+		SiegeThrow(TankFile::Error, "Data of resource \"" << resourcePath << "\" is past the end of Tank file \""
+				<< tank.getFileName() << "\"!");
+	}
+
+	Resource res;
+	res.path            = normalizePath(index.getPath(resFile).toString(), /* lowerCase = */ false);
+	res.format          = resFile.getDataFormat();
+	res.fileTime        = resFile.fileTime;
+	res.size            = resFile.size;
+	res.sourceReader    = &reader;
+	res.sourceTank      = &tank;
+	res.sourceFileIndex = fileIndex;
+	resources.push_back(std::move(res));
+}
+
+unsigned int TankFile::Writer::addAllResourcesFromTank(const Reader & reader, const TankFile & tank)
+{
+	const Header & source = tank.getFileHeader();
+	header.productVersion = source.productVersion;
+	header.minimumVersion = source.minimumVersion;
+	header.priority       = source.priority;
+	header.flags          = source.flags;
+	header.creatorId      = source.creatorId;
+	std::copy(std::begin(source.copyrightText), std::end(source.copyrightText), header.copyrightText);
+	std::copy(std::begin(source.buildText),     std::end(source.buildText),     header.buildText);
+	std::copy(std::begin(source.titleText),     std::end(source.titleText),     header.titleText);
+	std::copy(std::begin(source.authorText),    std::end(source.authorText),    header.authorText);
+	header.descriptionText = source.descriptionText;
+
+	unsigned int filesAdded = 0;
+	utils::StringView previousPath;
+	for (const utils::StringView path : reader.getFileList())
+	{
+		// Duplicate paths are adjacent in the sorted list. Only the first one can be looked up.
+		if (path == previousPath)
+		{
+			SiegeWarn("Skipping duplicate resource \"" << path << "\" in Tank file \"" << tank.getFileName() << "\"");
+			continue;
+		}
+		previousPath = path;
+
+		addResourceFromTank(reader, tank, path.toString());
+		++filesAdded;
+	}
+
+	return filesAdded;
+}
+
+void TankFile::Writer::setPlacementOrder(const std::vector<std::string> & resourcePaths)
+{
+	placementOrder = resourcePaths;
+}
+
+std::string TankFile::Writer::normalizePath(const std::string & resourcePath, const bool lowerCase)
+{
+	std::string path;
+	path.reserve(resourcePath.length() + 1);
+
+	if (resourcePath.empty() || (resourcePath[0] != '/' && resourcePath[0] != '\\'))
+	{
+		path += '/';
+	}
+	for (const char c : resourcePath)
+	{
+		if (c == '\\')
+		{
+			path += '/';
+		}
+		else
+		{
+			path += lowerCase ? static_cast<char>(std::tolower(static_cast<unsigned char>(c))) : c;
+		}
+	}
+
+	// Every component between the separators must be a proper name.
+	size_t nameStart = 1;
+	for (;;)
+	{
+		const size_t nameEnd = std::min(path.find('/', nameStart), path.length());
+		const size_t nameLen = nameEnd - nameStart;
+
+		if (nameLen == 0 || nameLen > UINT16_MAX ||
+		    path.compare(nameStart, nameLen, ".") == 0 || path.compare(nameStart, nameLen, "..") == 0)
+		{
+			SiegeThrow(TankFile::Error, "Invalid Tank resource path: \"" << resourcePath << "\"");
+		}
+
+		if (nameEnd == path.length())
+		{
+			break;
+		}
+		nameStart = nameEnd + 1;
+	}
+
+	return path;
+}
+
+void TankFile::Writer::loadContents(Resource & res) const
+{
+	if (res.sourceTank != nullptr)
+	{
+		// Stored data as is, compressed or not.
+		const Index & index = res.sourceReader->getIndex();
+		const Index::FileRecord & resFile = index.getFile(res.sourceFileIndex);
+
+		res.contents.resize(index.getStoredSize(resFile));
+		res.sourceTank->readBytesAt(res.sourceTank->getFileHeader().dataOffset + resFile.offset,
+		                            res.contents.data(), res.contents.size());
+		return;
+	}
+
+	if (res.sourceFile.empty() || res.size == 0)
+	{
+		return;
+	}
+
+	std::ifstream inFile;
+	if (!utils::filesys::tryOpen(inFile, res.sourceFile, std::ifstream::binary))
+	{
+		SiegeThrow(TankFile::Error, "Failed to open file \"" << res.sourceFile << "\": "
+				<< utils::filesys::getLastFileError());
+	}
+
+	// One extra byte to find out if the file grew since it was added.
+	res.contents.resize(size_t(res.size) + 1);
+	inFile.read(reinterpret_cast<char *>(res.contents.data()), res.contents.size());
+
+	if (static_cast<size_t>(inFile.gcount()) != res.size)
+	{
+		res.contents.clear();
+		SiegeThrow(TankFile::Error, "File \"" << res.sourceFile << "\" changed size after being added to the Tank!");
+	}
+	res.contents.pop_back();
+}
+
+void TankFile::Writer::packChunk(const uint8_t * data, const uint32_t sizeBytes, PackedChunk & chunk) const
+{
+	chunk.uncompressedSize = sizeBytes;
+	chunk.compressedSize   = sizeBytes;
+	chunk.extraBytes       = 0;
+
+	//
+	// The game reads the compressed bytes into the end of the chunk's buffer and inflates
+	// in place, then copies the extra bytes over the tail. Inflating must never overwrite
+	// compressed bytes not yet read, so the extra bytes must cover the most the output gets
+	// ahead of the input. From "TankStructure.h": start with 16, then double it until it
+	// works. Chunks that don't get smaller are stored.
+	//
+	ByteArray compressed(utils::compression::compressBound(sizeBytes));
+	ByteArray scratch(sizeBytes);
+	uint32_t extraBytes = 16;
+
+	while (extraBytes < sizeBytes)
+	{
+		const uint32_t deflatedSize = sizeBytes - extraBytes;
+		unsigned long compressedSize = static_cast<unsigned long>(compressed.size());
+
+		if (utils::compression::compress(compressed.data(), &compressedSize, data, deflatedSize,
+		                                 compressionLevel) != utils::compression::Error::Ok)
+		{
+			SiegeThrow(TankFile::Error, "Failed to compress Tank chunk of " << sizeBytes << " bytes!");
+		}
+		if (compressedSize + extraBytes >= sizeBytes)
+		{
+			return; // Stored.
+		}
+
+		unsigned long inflatedSize = deflatedSize;
+		long maxLead = 0;
+		if (utils::compression::decompressMeasuringLead(scratch.data(), &inflatedSize, compressed.data(),
+		                                                compressedSize, &maxLead) != utils::compression::Error::Ok ||
+		    inflatedSize != deflatedSize)
+		{
+			SiegeThrow(TankFile::Error, "Compressed Tank chunk failed to decompress back!");
+		}
+
+		// Buffer is sizeBytes, compressed data sits at its end, output must stay behind the input.
+		const long extraNeeded = maxLead - long(deflatedSize) + long(compressedSize);
+		if (extraNeeded <= long(extraBytes))
+		{
+			chunk.compressedSize = static_cast<uint32_t>(compressedSize);
+			chunk.extraBytes     = extraBytes;
+			chunk.data.reserve(compressedSize + extraBytes);
+			chunk.data.assign(compressed.data(), compressed.data() + compressedSize);
+			chunk.data.insert(chunk.data.end(), data + deflatedSize, data + sizeBytes);
+			return;
+		}
+
+		extraBytes = std::max(extraBytes * 2, alignUp(static_cast<uint32_t>(extraNeeded), 16u));
+	}
+}
+
+void TankFile::Writer::startPacking(PackedResource & packed, utils::JobGroup & jobs)
+{
+	const Resource & res = resources[packed.resourceIndex];
+	const uint8_t * data = res.contents.data();
+
+	if (res.sourceTank != nullptr)
+	{
+		// Only the offset changes. Chunk offsets are relative to the resource, so they stay.
+		const Index & index = res.sourceReader->getIndex();
+		const Index::FileRecord & resFile = index.getFile(res.sourceFileIndex);
+
+		packed.copied     = true;
+		packed.format     = resFile.getDataFormat();
+		packed.flags      = resFile.flags;
+		packed.crc32      = resFile.crc32;
+		packed.storedSize = resFile.compressedSize;
+		packed.chunkSize  = resFile.chunkSize;
+
+		const Index::ChunkRecord * chunks = index.getChunks(resFile);
+		packed.chunks.resize(resFile.numChunks);
+		for (uint32_t c = 0; c < resFile.numChunks; ++c)
+		{
+			packed.chunks[c].uncompressedSize = chunks[c].uncompressedSize;
+			packed.chunks[c].compressedSize   = chunks[c].compressedSize;
+			packed.chunks[c].extraBytes       = chunks[c].extraBytes;
+			packed.chunks[c].offset           = chunks[c].offset;
+		}
+		return;
+	}
+
+	packed.format    = (res.size != 0) ? res.format : DataFormat::Raw;
+	packed.chunkSize = chunkSize;
+	jobs.run([&packed, data, &res]()
+	{
+		packed.crc32 = utils::computeCrc32(data, res.size);
+	});
+
+	if (packed.format == DataFormat::Zlib)
+	{
+		// Chunks are independent, so they all get compressed at the same time.
+		const uint32_t numChunks = (res.size + chunkSize - 1) / chunkSize;
+		packed.chunks.resize(numChunks);
+
+		for (uint32_t c = 0; c < numChunks; ++c)
+		{
+			const uint32_t chunkOffset = c * chunkSize;
+			const uint32_t chunkBytes  = std::min(chunkSize, res.size - chunkOffset);
+			PackedChunk & chunk = packed.chunks[c];
+
+			jobs.run([this, data, chunkOffset, chunkBytes, &chunk]()
+			{
+				packChunk(data + chunkOffset, chunkBytes, chunk);
+			});
+		}
+	}
+}
+
+void TankFile::Writer::buildDirTree(const std::vector<uint32_t> & fileOrder, std::vector<DirNode> & dirsOut) const
+{
+	// Dirs are created as found, then renumbered in depth-first order below.
+	std::vector<DirNode> dirs;
+	std::map<std::string, uint32_t> dirsByPath;
+
+	dirs.push_back({ std::string(), Index::InvalidIndex, {}, {} });
+	dirsByPath["/"] = 0;
+
+	const std::function<uint32_t(const std::string &)> findOrAddDir = [&](const std::string & dirPath) -> uint32_t
+	{
+		const auto iter = dirsByPath.find(dirPath);
+		if (iter != dirsByPath.end())
+		{
+			return iter->second;
+		}
+
+		// dirPath is "/parent/path/name/".
+		const size_t nameStart = dirPath.rfind('/', dirPath.length() - 2) + 1;
+		const uint32_t parent  = findOrAddDir(dirPath.substr(0, nameStart));
+		const uint32_t dir     = static_cast<uint32_t>(dirs.size());
+
+		dirs.push_back({ dirPath.substr(nameStart, dirPath.length() - nameStart - 1), parent, {}, {} });
+		dirs[parent].subdirs.push_back(dir);
+		dirsByPath[dirPath] = dir;
+		return dir;
+	};
+
+	for (const uint32_t r : fileOrder)
+	{
+		const std::string & path = resources[r].path;
+		const uint32_t dir = findOrAddDir(path.substr(0, path.rfind('/') + 1));
+		dirs[dir].files.push_back(r);
+	}
+
+	// Done after all dirs are known, since a file may come before a dir of the same name.
+	for (const uint32_t r : fileOrder)
+	{
+		if (dirsByPath.count(resources[r].path + "/") != 0)
+		{
+			SiegeThrow(TankFile::Error, "Tank path \"" << resources[r].path << "\" is both a file and a directory!");
+		}
+	}
+
+	// Depth-first, each level sorted by name.
+	dirsOut.clear();
+	dirsOut.reserve(dirs.size());
+
+	const std::function<void(uint32_t, uint32_t)> visit = [&](const uint32_t d, const uint32_t newParent)
+	{
+		const uint32_t newIndex = static_cast<uint32_t>(dirsOut.size());
+		dirsOut.push_back({ dirs[d].name, newParent, {}, std::move(dirs[d].files) });
+
+		auto subdirs = std::move(dirs[d].subdirs);
+		std::sort(std::begin(subdirs), std::end(subdirs), [&dirs](const uint32_t a, const uint32_t b)
+		{
+			return dirs[a].name < dirs[b].name;
+		});
+
+		for (const uint32_t s : subdirs)
+		{
+			dirsOut[newIndex].subdirs.push_back(static_cast<uint32_t>(dirsOut.size()));
+			visit(s, newIndex);
+		}
+	};
+	visit(0, Index::InvalidIndex);
+}
+
+ByteArray TankFile::Writer::buildIndex(const std::vector<PackedResource> & packed, const std::vector<DirNode> & dirs,
+                                       const std::vector<uint32_t> & fileOrder, const FileTime buildFileTime,
+                                       uint32_t & dirSetSizeOut) const
+{
+	const uint32_t numDirs  = static_cast<uint32_t>(dirs.size());
+	const uint32_t numFiles = static_cast<uint32_t>(fileOrder.size());
+
+	// DirSet offsets (DSO):
+	std::vector<uint32_t> dirOffsets(numDirs);
+	uint32_t dirSetSize = sizeof(uint32_t) * (1 + numDirs);
+	for (uint32_t d = 0; d < numDirs; ++d)
+	{
+		const uint32_t childCount = static_cast<uint32_t>(dirs[d].subdirs.size() + dirs[d].files.size());
+		dirOffsets[d] = dirSetSize;
+		dirSetSize += 4 + 4 + sizeof(FileTime) + getNStringSize(dirs[d].name) + 4 * childCount;
+	}
+
+	// FileSet offsets (FSO), in alphabetical order of path:
+	std::vector<uint32_t> fileOffsets(resources.size());
+	std::vector<uint32_t> fileParents(resources.size());
+	uint32_t fileSetSize = sizeof(uint32_t) * (1 + numFiles);
+	for (const uint32_t r : fileOrder)
+	{
+		const std::string & path = resources[r].path;
+		const size_t numChunks = packed[r].chunks.size();
+
+		fileOffsets[r] = fileSetSize;
+		fileSetSize += 4 * 4 + sizeof(FileTime) + 2 * 2 + getNStringSize(path.substr(path.rfind('/') + 1));
+		if (isDataFormatCompressed(packed[r].format) && resources[r].size != 0)
+		{
+			fileSetSize += 4 * 2 + 4 * 4 * static_cast<uint32_t>(numChunks);
+		}
+	}
+
+	ByteArray index;
+	index.reserve(dirSetSize + fileSetSize);
+	ByteWriter writer(index);
+
+	// DirSet:
+	writer.writeU32(numDirs);
+	for (const uint32_t offset : dirOffsets)
+	{
+		writer.writeU32(offset);
+	}
+	for (uint32_t d = 0; d < numDirs; ++d)
+	{
+		const DirNode & dir = dirs[d];
+
+		// Children sorted by name, dirs and files mixed. Files point into the FileSet, right after the DirSet.
+		std::vector<std::pair<std::string, uint32_t>> children;
+		for (const uint32_t s : dir.subdirs)
+		{
+			children.emplace_back(dirs[s].name, dirOffsets[s]);
+		}
+		for (const uint32_t r : dir.files)
+		{
+			const std::string & path = resources[r].path;
+			children.emplace_back(path.substr(path.rfind('/') + 1), dirSetSize + fileOffsets[r]);
+			fileParents[r] = dirOffsets[d];
+		}
+		std::sort(std::begin(children), std::end(children));
+
+		writer.writeU32(dir.parent == Index::InvalidIndex ? 0 : dirOffsets[dir.parent]);
+		writer.writeU32(static_cast<uint32_t>(children.size()));
+		writer.writeBytes(&buildFileTime, sizeof(buildFileTime));
+		writer.writeNString(dir.name);
+		for (const auto & child : children)
+		{
+			writer.writeU32(child.second);
+		}
+	}
+	assert(writer.getSize() == dirSetSize);
+
+	// FileSet:
+	writer.writeU32(numFiles);
+	for (const uint32_t r : fileOrder)
+	{
+		writer.writeU32(fileOffsets[r]);
+	}
+	for (const uint32_t r : fileOrder)
+	{
+		const Resource & res = resources[r];
+		const PackedResource & p = packed[r];
+		const FileTime fileTime = (res.fileTime.toU64() != 0) ? res.fileTime : buildFileTime;
+
+		writer.writeU32(fileParents[r]);
+		writer.writeU32(res.size);
+		writer.writeU32(p.dataOffset);
+		writer.writeU32(p.crc32);
+		writer.writeBytes(&fileTime, sizeof(fileTime));
+		writer.writeU16(static_cast<uint16_t>(p.format));
+		writer.writeU16(p.flags);
+		writer.writeNString(res.path.substr(res.path.rfind('/') + 1));
+
+		if (isDataFormatCompressed(p.format) && res.size != 0)
+		{
+			writer.writeU32(p.storedSize);
+			writer.writeU32(p.chunkSize);
+			for (const PackedChunk & chunk : p.chunks)
+			{
+				writer.writeU32(chunk.uncompressedSize);
+				writer.writeU32(chunk.compressedSize);
+				writer.writeU32(chunk.extraBytes);
+				writer.writeU32(chunk.offset);
+			}
+		}
+	}
+	assert(writer.getSize() == size_t(dirSetSize) + fileSetSize);
+
+	dirSetSizeOut = dirSetSize;
+	return index;
+}
+
+void TankFile::Writer::writeTank(const std::string & filename)
+{
+	if (filename.empty())
+	{
+		SiegeThrow(TankFile::Error, "No Tank filename provided!");
+	}
+
+	// FileSet order is alphabetical by path.
+	std::vector<uint32_t> fileOrder(resources.size());
+	for (uint32_t r = 0; r < fileOrder.size(); ++r)
+	{
+		fileOrder[r] = r;
+	}
+	std::sort(std::begin(fileOrder), std::end(fileOrder), [this](const uint32_t a, const uint32_t b)
+	{
+		return resources[a].path < resources[b].path;
+	});
+	for (size_t i = 1; i < fileOrder.size(); ++i)
+	{
+		if (resources[fileOrder[i]].path == resources[fileOrder[i - 1]].path)
+		{
+			SiegeThrow(TankFile::Error, "Tank resource \"" << resources[fileOrder[i]].path << "\" was added twice!");
+		}
+	}
+
+	std::vector<DirNode> dirs;
+	buildDirTree(fileOrder, dirs);
+
+	// Data order: the placement order, if any, then small files, then the large ones.
+	std::vector<uint32_t> dataOrder;
+	std::vector<bool> placed(resources.size(), false);
+	dataOrder.reserve(resources.size());
+
+	for (const std::string & placementPath : placementOrder)
+	{
+		const auto iter = std::lower_bound(std::begin(fileOrder), std::end(fileOrder), placementPath,
+			[this](const uint32_t r, const std::string & path) { return resources[r].path < path; });
+
+		if (iter != std::end(fileOrder) && resources[*iter].path == placementPath && !placed[*iter])
+		{
+			placed[*iter] = true;
+			dataOrder.push_back(*iter);
+		}
+	}
+
+	const auto firstUnplaced = dataOrder.size();
+	for (const uint32_t r : fileOrder)
+	{
+		if (!placed[r])
+		{
+			dataOrder.push_back(r);
+		}
+	}
+	std::stable_partition(std::begin(dataOrder) + firstUnplaced, std::end(dataOrder), [this](const uint32_t r)
+	{
+		return resources[r].size < LargeFileSize;
+	});
+
+	const time_t buildTime = std::time(nullptr);
+	const FileTime buildFileTime = FileTime::fromPortableTime(buildTime);
+
+	header.dirsetOffset  = 0;
+	header.filesetOffset = 0;
+	header.indexSize     = 0;
+	header.dataOffset    = 0;
+	header.indexCrc32    = 0;
+	header.dataCrc32     = 0;
+	header.guid          = makeRandomGuid();
+	header.utcBuildTime  = makeUtcSystemTime(buildTime);
+
+	const uint32_t headerSize = static_cast<uint32_t>(serializeHeader(header).size());
+	header.dataOffset = alignUp(headerSize + Header::RawHeaderPad, DataSectionAlignment);
+
+	// Never write over the destination directly. It could be mounted by someone else.
+	const std::string tempFilename = filename + ".tmp";
+	std::ofstream outFile;
+	if (!utils::filesys::tryOpen(outFile, tempFilename, std::ofstream::binary))
+	{
+		SiegeThrow(TankFile::Error, "Failed to open file \"" << tempFilename << "\" for writing: "
+				<< utils::filesys::getLastFileError());
+	}
+
+	try
+	{
+		const ByteArray zeros(DataSectionAlignment, 0);
+		outFile.write(reinterpret_cast<const char *>(zeros.data()), header.dataOffset); // Header goes here last.
+
+		uint64_t dataSize = 0;
+		uint32_t dataCrc  = 0;
+		const auto writeData = [&outFile, &dataSize, &dataCrc](const uint8_t * data, const size_t numBytes)
+		{
+			outFile.write(reinterpret_cast<const char *>(data), numBytes);
+			dataCrc   = utils::computeCrc32(data, numBytes, dataCrc);
+			dataSize += numBytes;
+		};
+
+		std::vector<PackedResource> packed(resources.size());
+
+		// Resources being compressed, in data order. Written as soon as
+		// the oldest one is done, while the ones after it keep compressing.
+		std::deque<std::pair<uint32_t, std::unique_ptr<utils::JobGroup>>> inFlight;
+		uint64_t bytesInFlight = 0;
+
+		const auto writeOldest = [&]()
+		{
+			const uint32_t r = inFlight.front().first;
+			inFlight.front().second->wait();
+
+			Resource & res = resources[r];
+			PackedResource & p = packed[r];
+
+			// Compressed resources where no chunk got smaller are just stored.
+			if (!p.copied && p.format == DataFormat::Zlib &&
+			    std::all_of(std::begin(p.chunks), std::end(p.chunks), [](const PackedChunk & c) { return c.data.empty(); }))
+			{
+				p.format = DataFormat::Raw;
+				p.chunks.clear();
+			}
+
+			writeData(zeros.data(), alignUp<uint64_t>(dataSize, DataAlignment) - dataSize);
+			p.dataOffset = static_cast<uint32_t>(dataSize);
+
+			if (p.copied)
+			{
+				writeData(res.contents.data(), res.contents.size());
+			}
+			else if (p.chunks.empty())
+			{
+				writeData(res.contents.data(), res.size);
+			}
+			else
+			{
+				for (uint32_t c = 0, chunkStart = 0; c < p.chunks.size(); ++c)
+				{
+					PackedChunk & chunk = p.chunks[c];
+					chunk.offset = static_cast<uint32_t>(dataSize - p.dataOffset);
+					if (chunk.data.empty())
+					{
+						writeData(res.contents.data() + chunkStart, chunk.uncompressedSize);
+					}
+					else
+					{
+						writeData(chunk.data.data(), chunk.data.size());
+						ByteArray().swap(chunk.data);
+					}
+					chunkStart += chunk.uncompressedSize;
+				}
+			}
+			if (!p.copied)
+			{
+				p.storedSize = static_cast<uint32_t>(dataSize - p.dataOffset);
+			}
+
+			if (!res.sourceFile.empty() || p.copied)
+			{
+				ByteArray().swap(res.contents);
+			}
+			if (!outFile)
+			{
+				SiegeThrow(TankFile::Error, "Failed to write to file \"" << tempFilename << "\": "
+						<< utils::filesys::getLastFileError());
+			}
+			if (header.dataOffset + dataSize > UINT32_MAX)
+			{
+				SiegeThrow(TankFile::Error, "Tank data is over the 4GB limit of the format!");
+			}
+
+			bytesInFlight -= res.size;
+			inFlight.pop_front();
+		};
+
+		for (const uint32_t r : dataOrder)
+		{
+			const uint32_t size = resources[r].size;
+			while (!inFlight.empty() && maxBytesInFlight != 0 && bytesInFlight + size > maxBytesInFlight)
+			{
+				writeOldest();
+			}
+
+			loadContents(resources[r]);
+			packed[r].resourceIndex = r;
+
+			std::unique_ptr<utils::JobGroup> jobs(new utils::JobGroup(getJobSystem()));
+			startPacking(packed[r], *jobs);
+
+			inFlight.emplace_back(r, std::move(jobs));
+			bytesInFlight += size;
+		}
+		while (!inFlight.empty())
+		{
+			writeOldest();
+		}
+
+		writeData(zeros.data(), alignUp<uint64_t>(dataSize, 4) - dataSize);
+
+		// Index after the data:
+		uint32_t dirSetSize = 0;
+		const ByteArray index = buildIndex(packed, dirs, fileOrder, buildFileTime, dirSetSize);
+
+		outFile.write(reinterpret_cast<const char *>(index.data()), index.size());
+
+		header.dirsetOffset  = static_cast<uint32_t>(header.dataOffset + dataSize);
+		header.filesetOffset = header.dirsetOffset + dirSetSize;
+		header.indexSize     = headerSize + static_cast<uint32_t>(index.size());
+		header.indexCrc32    = utils::computeCrc32(index.data(), index.size());
+		header.dataCrc32     = dataCrc;
+
+		const ByteArray headerBytes = serializeHeader(header);
+		assert(headerBytes.size() == headerSize);
+
+		outFile.seekp(0);
+		outFile.write(reinterpret_cast<const char *>(headerBytes.data()), headerBytes.size());
+		outFile.close();
+
+		if (outFile.fail())
+		{
+			SiegeThrow(TankFile::Error, "Failed to write to file \"" << tempFilename << "\": "
+					<< utils::filesys::getLastFileError());
+		}
+	}
+	catch (...)
+	{
+		outFile.close();
+		std::remove(tempFilename.c_str());
+		throw;
+	}
+
+	if (!utils::filesys::replaceFile(tempFilename, filename))
+	{
+		SiegeThrow(TankFile::Error, "Failed to rename \"" << tempFilename << "\" to \"" << filename << "\": "
+				<< utils::filesys::getLastFileError());
+	}
+
+	SiegeLog("Written Tank file \"" << filename << "\" with " << resources.size() << " resources in "
+			<< dirs.size() << " directories.");
+}
+
+} // namespace siege {}
@@ -0,0 +1,388 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: tank_file_zip.cpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: TankFile::Reader transcoding of a whole Tank to a ZIP archive.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "siege/tank_file.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+
+namespace siege
+{
+namespace
+{
+
+// ZIP names use forward slashes and have no leading separator: "/art/maps/" => "art/maps/".
+std::string makeZipEntryName(const utils::StringView tankPath)
+{
+	const char pathSeparator = utils::filesys::getPathSeparator()[0];
+
+	std::string name = tankPath.toString();
+	if (!name.empty() && name[0] == pathSeparator)
+	{
+		name.erase(0, 1);
+	}
+	std::replace(std::begin(name), std::end(name), pathSeparator, '/');
+	return name;
+}
+
+// Compresses the contents to raw Deflate data, in pieces of 'sliceSize' bytes when bigger than that.
+// The pieces are deflated in order on the calling thread, which is already one of the pipeline's
+// convert threads. All but the last end with a full flush, so together they are a single valid stream.
+// Throws TankFile::Error on failure.
+ByteArray deflateContents(const uint8_t * contents, const size_t contentsSize,
+                          const unsigned int compressionLevel, const uint32_t sliceSize,
+                          const std::string & resourcePath)
+{
+	const size_t numSlices = (sliceSize != 0) ? std::max<size_t>((contentsSize + sliceSize - 1) / sliceSize, 1) : 1;
+	const size_t sliceBytes = (numSlices > 1) ? sliceSize : contentsSize;
+
+	ByteArray deflated;
+	for (size_t s = 0; s < numSlices; ++s)
+	{
+		const size_t sliceStart = s * sliceBytes;
+		const unsigned long sliceSizeBytes = static_cast<unsigned long>(std::min(contentsSize - sliceStart, sliceBytes));
+
+		// Each piece is deflated straight to the end of the output.
+		const size_t deflatedStart = deflated.size();
+		unsigned long deflatedSize = utils::compression::compressBound(sliceSizeBytes);
+		deflated.resize(deflatedStart + deflatedSize);
+
+		const int errorCode = utils::compression::deflateRaw(deflated.data() + deflatedStart, &deflatedSize,
+				contents + sliceStart, sliceSizeBytes, compressionLevel, /* finalPiece = */ s == numSlices - 1);
+		if (errorCode != utils::compression::Error::Ok)
+		{
+			SiegeThrow(TankFile::Error, "Failed to deflate resource \"" << resourcePath << "\": "
+					<< utils::compression::getErrorString(errorCode));
+		}
+		deflated.resize(deflatedStart + deflatedSize);
+	}
+	return deflated;
+}
+
+// Joins the chunks of a Zlib resource into a single raw Deflate stream, copying the compressed data as it is.
+// A Zlib chunk is a Deflate stream between a 2 bytes header and a 4 bytes trailer. Its extra bytes, and the
+// chunks stored without compression, go in stored blocks. 'storedData' has the Index::getStoredSize() bytes
+// of the resource. Returns false if a chunk is out of bounds or not a valid Zlib stream.
+bool joinZlibChunks(const TankFile::Index & index, const TankFile::Index::FileRecord & resFile,
+                    const uint8_t * storedData, const uint32_t storedSize,
+                    utils::compression::DeflateStreamBuilder & builder)
+{
+	const TankFile::Index::ChunkRecord * chunks = index.getChunks(resFile);
+	for (uint32_t c = 0; c < resFile.numChunks; ++c)
+	{
+		const TankFile::Index::ChunkRecord & chunk = chunks[c];
+		const uint8_t * chunkData = storedData + chunk.offset;
+
+		if (!chunk.isCompressed())
+		{
+			if (uint64_t(chunk.offset) + chunk.uncompressedSize > storedSize)
+			{
+				return false;
+			}
+			builder.appendStored(chunkData, chunk.uncompressedSize);
+			continue;
+		}
+
+		unsigned long deflateOffset = 0;
+		unsigned long deflateSize   = 0;
+		if (uint64_t(chunk.offset) + chunk.compressedSize + chunk.extraBytes > storedSize ||
+		    !utils::compression::findZlibDeflateData(chunkData, chunk.compressedSize, &deflateOffset, &deflateSize) ||
+		    builder.appendDeflate(chunkData + deflateOffset, deflateSize) != utils::compression::Error::Ok)
+		{
+			return false;
+		}
+		builder.appendStored(chunkData + chunk.compressedSize, chunk.extraBytes);
+	}
+
+	builder.finish();
+	return true;
+}
+
+} // namespace {}
+
+// ========================================================
+// TankFile::Reader ZIP transcoding:
+// ========================================================
+
+constexpr uint32_t TankFile::Reader::DefaultZipSliceSize;
+
+TankFile::Reader::ZipReport TankFile::Reader::transcodeToZip(const TankFile & tank, const std::string & zipFile,
+                                                             const ZipOptions & options) const
+{
+	const auto startTime = std::chrono::steady_clock::now();
+
+	ZipReport report;
+	const std::string tempFilename = zipFile + ".tmp";
+
+	utils::ZipWriter zip;
+	if (!zip.open(tempFilename))
+	{
+		SiegeThrow(TankFile::Error, "Failed to open ZIP archive \"" << tempFilename << "\" for writing: "
+				<< utils::filesys::getLastFileError());
+	}
+
+	// Drops the unfinished archive.
+	const auto failArchive = [&zip, &tempFilename](const std::string & errorText)
+	{
+		zip.close();
+		std::remove(tempFilename.c_str());
+		SiegeThrow(TankFile::Error, "Failed to write ZIP archive \"" << tempFilename << "\": " << errorText);
+	};
+
+	// Directories go first, parents before children, like `zip -r` does. The root has no entry.
+	const Index::PathList dirPaths = index.getDirPaths();
+	for (uint32_t d = 0; d < dirPaths.size(); ++d)
+	{
+		const Index::DirRecord & dir = index.getDir(dirPaths.getRecordIndex(d));
+		if (dir.isRoot())
+		{
+			continue;
+		}
+		if (!zip.addDirectory(makeZipEntryName(dirPaths[d]), dir.fileTime.toPortableTime()))
+		{
+			failArchive(utils::filesys::getLastFileError());
+		}
+		++report.directories;
+	}
+
+	// What happened to a resource on its way to the archive. Resources are
+	// slotted in the order the pipeline reads them, which is also the order
+	// they are added to the archive, no matter the order they finish in.
+	enum class SlotState
+	{
+		Pending,
+		Ready,
+		Failed
+	};
+	struct ZipSlot
+	{
+		const Index::FileRecord * resFile = nullptr;
+		std::string               name;
+		ByteArray                 data;     // Deflate data, if Deflated.
+		ResourceBuffer            contents; // If Stored.
+		utils::ZipWriter::Method  method   = utils::ZipWriter::Method::Stored;
+		bool                      passedThrough = false;
+		SlotState                 state    = SlotState::Pending;
+	};
+
+	std::vector<ZipSlot> slots;
+	std::unordered_map<std::string, size_t> slotByPath;
+	std::mutex slotsMutex;
+	size_t nextSlot = 0;
+
+	std::atomic<bool> zipFailed(false);
+	std::string zipError;
+
+	// Adds the resources that are done, in slot order, up to the first one still on its way.
+	// Their data is freed as they go, so only the ones waiting on an earlier slot stay in memory.
+	const auto addReadySlots = [&]()
+	{
+		for (; nextSlot < slots.size() && slots[nextSlot].state != SlotState::Pending; ++nextSlot)
+		{
+			ZipSlot & slot = slots[nextSlot];
+			if (slot.state == SlotState::Ready && !zipFailed)
+			{
+				const Index::FileRecord & resFile = *slot.resFile;
+				const uint32_t crc = (resFile.size != 0) ? resFile.crc32 : 0;
+
+				const bool stored = slot.method == utils::ZipWriter::Method::Stored;
+				if (zip.addFile(slot.name, slot.method, stored ? slot.contents.data() : slot.data.data(),
+				                stored ? slot.contents.size() : slot.data.size(),
+				                crc, resFile.size, resFile.fileTime.toPortableTime()))
+				{
+					if (slot.passedThrough)                                    { ++report.filesPassedThrough; }
+					else if (slot.method == utils::ZipWriter::Method::Deflated) { ++report.filesDeflated;      }
+					else                                                        { ++report.filesStored;        }
+				}
+				else
+				{
+					zipError  = utils::filesys::getLastFileError();
+					zipFailed = true;
+				}
+			}
+			ByteArray().swap(slot.data);
+			ResourceBuffer().swap(slot.contents);
+		}
+	};
+
+	ResourceSink sink;
+	sink.select = [&](const std::string & resourcePath, const Index::FileRecord & resFile)
+	{
+		if (resFile.isInvalidFile())
+		{
+			++report.invalidFiles;
+			return false;
+		}
+
+		slotByPath.emplace(resourcePath, slots.size());
+		slots.emplace_back();
+		slots.back().resFile = &resFile;
+		slots.back().name    = makeZipEntryName(resourcePath);
+		return true;
+	};
+
+	// Runs on several threads, one resource each. Each slot is only touched by
+	// the thread converting it until it is handed to the write stage.
+	// The Deflate data goes in the slot and the contents are only kept if stored.
+	sink.convert = [&](const std::string & resourcePath, const uint8_t * storedData, ResourceBuffer & contents)
+	{
+		if (zipFailed)
+		{
+			return false; // No point in compressing anything else.
+		}
+
+		ZipSlot & slot = slots[slotByPath.at(resourcePath)];
+		const Index::FileRecord & resFile = *slot.resFile;
+
+		if (contents.empty() || options.compressionLevel == utils::compression::Level::NoCompression)
+		{
+			slot.method = utils::ZipWriter::Method::Stored;
+			return true;
+		}
+
+		// Zlib data only needs its chunks joined, which is a lot cheaper than deflating it again. The
+		// stored data comes from the pipeline's read and the contents were already inflated from it
+		// and checked against the CRC, so it is known to be good. If it doesn't come out smaller than
+		// the contents, the chunks were mostly stored without compression by the Tank builder, so the
+		// contents are stored too. Without the stored data (its read failed and the resource was read
+		// again on its own), the contents are just deflated.
+		if (options.passThroughZlib && storedData != nullptr &&
+		    resFile.getDataFormat() == DataFormat::Zlib && resFile.numChunks != 0)
+		{
+			const uint32_t storedSize = index.getStoredSize(resFile);
+
+			utils::compression::DeflateStreamBuilder builder;
+			builder.reserve(storedSize + 64);
+			if (joinZlibChunks(index, resFile, storedData, storedSize, builder))
+			{
+				if (builder.getData().size() < contents.size())
+				{
+					slot.data          = std::move(builder.getData());
+					slot.method        = utils::ZipWriter::Method::Deflated;
+					slot.passedThrough = true;
+				}
+				else
+				{
+					slot.method = utils::ZipWriter::Method::Stored;
+				}
+				return true;
+			}
+		}
+
+		ByteArray deflated = deflateContents(contents.data(), contents.size(), options.compressionLevel,
+		                                     options.sliceSize, resourcePath);
+		if (deflated.size() < contents.size())
+		{
+			slot.data   = std::move(deflated);
+			slot.method = utils::ZipWriter::Method::Deflated;
+		}
+		else
+		{
+			slot.method = utils::ZipWriter::Method::Stored;
+		}
+		return true;
+	};
+
+	// Contents not taken go back to the pipeline's buffer pool.
+	sink.write = [&](const std::string & resourcePath, ResourceBuffer & contents)
+	{
+		std::lock_guard<std::mutex> lock(slotsMutex);
+		ZipSlot & slot = slots[slotByPath.at(resourcePath)];
+		if (slot.method == utils::ZipWriter::Method::Stored)
+		{
+			slot.contents = std::move(contents);
+		}
+		slot.state = SlotState::Ready;
+		addReadySlots();
+		return true;
+	};
+
+	sink.error = [&](const std::string & resourcePath, const std::string & errorText)
+	{
+		std::lock_guard<std::mutex> lock(slotsMutex);
+		if (!zipFailed)
+		{
+			report.failures.push_back({ resourcePath, errorText });
+		}
+		slots[slotByPath.at(resourcePath)].state = SlotState::Failed;
+		addReadySlots();
+	};
+
+	// Compression is the bulk of the work here, so of the threads for the CPU stages (the decode threads
+	// asked for, or one per JobSystem worker) the convert stage gets three in four and the decoding the
+	// rest. A single writer is enough, as it only copies data that is ready into the archive.
+	PipelineConfig & config = report.pipelineConfig;
+	config = pipelineConfig;
+	const unsigned int cpuThreads = (config.decodeThreads != 0) ? config.decodeThreads : getJobSystem().getWorkerCount();
+	config.decodeThreads = std::max(cpuThreads / 4, 1u);
+	config.verifyThreads = std::max(cpuThreads - config.decodeThreads, 1u);
+	config.writeThreads  = 1;
+
+	try
+	{
+		report.stats = extractAllResources(tank, sink, /* validateCRCs = */ true, config);
+	}
+	catch (std::exception & e)
+	{
+		failArchive(e.what());
+	}
+
+	// Every resource should have been written or failed by now. One still pending would
+	// leave a hole in the archive, so it is an error rather than a silently short ZIP.
+	if (!zipFailed && nextSlot != slots.size())
+	{
+		std::string pendingNames;
+		unsigned int numPending = 0;
+		for (size_t s = nextSlot; s < slots.size(); ++s)
+		{
+			if (slots[s].state != SlotState::Pending)
+			{
+				continue;
+			}
+			if (numPending++ < 8)
+			{
+				pendingNames += (pendingNames.empty() ? "\"" : ", \"") + slots[s].name + "\"";
+			}
+		}
+		if (numPending > 8)
+		{
+			pendingNames += utils::format(" and %u more", numPending - 8);
+		}
+		failArchive(utils::format("%u resources were never written nor failed by the extraction: ", numPending) + pendingNames);
+	}
+
+	if (zipFailed || !zip.finish())
+	{
+		failArchive(!zipError.empty() ? zipError : utils::filesys::getLastFileError());
+	}
+
+	if (!utils::filesys::replaceFile(tempFilename, zipFile))
+	{
+		SiegeThrow(TankFile::Error, "Failed to rename \"" << tempFilename << "\" to \"" << zipFile << "\": "
+				<< utils::filesys::getLastFileError());
+	}
+
+	std::sort(std::begin(report.failures), std::end(report.failures),
+		[](const VerifyReport::Failure & a, const VerifyReport::Failure & b)
+		{
+			return a.resourcePath < b.resourcePath;
+		});
+
+	report.zipSizeBytes   = zip.getSizeBytes();
+	report.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return report;
+}
+
+} // namespace siege {}
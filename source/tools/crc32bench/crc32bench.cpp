@@ -0,0 +1,267 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: crc32bench.cpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: Command line tool that cross-checks and benchmarks the CRC-32 engines.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "utils/utils.hpp"
+#include "utils/simple_cmdline_parser.hpp"
+
+#include <iostream>
+#include <chrono>
+#include <random>
+
+namespace tools
+{
+
+// ========================================================
+// Crc32Bench:
+// ========================================================
+
+class Crc32Bench final
+{
+public:
+
+	Crc32Bench(int argc, const char * argv[]);
+	~Crc32Bench() = default;
+
+	int run();
+
+private:
+
+	// Checks every supported engine and crc32::combine() against the
+	// Nibble engine over random buffers. Returns the number of mismatches.
+	unsigned int crossCheck();
+
+	// Prints the throughput of each supported engine over one large buffer.
+	void benchmark();
+
+	// Prints some help text to STDOUT.
+	void printHelpText() const;
+
+	// Value of a --flag=N, or the default if not given.
+	uint64_t getNumericFlag(const std::string & flagName, uint64_t defaultValue) const;
+
+	const std::string programName; // argv[0]
+	utils::SimpleCmdLineParser cmdLine;
+	std::mt19937 random;
+
+	// Options:
+	const bool     verbose;
+	const uint64_t numChecks;
+	const uint64_t maxCheckSize;
+	const uint64_t benchSizeMBytes;
+	const uint64_t benchRuns;
+};
+
+Crc32Bench::Crc32Bench(const int argc, const char * argv[])
+	: programName(argv[0])
+	, cmdLine(argc, argv)
+	, random(static_cast<std::mt19937::result_type>(getNumericFlag("seed", 1234)))
+	, verbose(cmdLine.hasFlag("v") || cmdLine.hasFlag("verbose"))
+	, numChecks(getNumericFlag("checks", 200000))
+	, maxCheckSize(getNumericFlag("max_check_size", 4096))
+	, benchSizeMBytes(getNumericFlag("size", 64))
+	, benchRuns(getNumericFlag("runs", 5))
+{
+}
+
+int Crc32Bench::run()
+{
+	if (cmdLine.hasFlag("h") || cmdLine.hasFlag("help"))
+	{
+		printHelpText();
+		return 0;
+	}
+
+	std::cout << "Engines..:";
+	for (int e = 0; e < utils::crc32::Engine::Count; ++e)
+	{
+		const auto engine = static_cast<utils::crc32::Engine::Enum>(e);
+		std::cout << " " << utils::crc32::getEngineName(engine)
+		          << (utils::crc32::isEngineSupported(engine) ? "" : " (unsupported)");
+	}
+	std::cout << "\nBest.....: " << utils::crc32::getEngineName(utils::crc32::getBestEngine()) << "\n";
+
+	if (!cmdLine.hasFlag("no_check"))
+	{
+		const unsigned int mismatches = crossCheck();
+		if (mismatches != 0)
+		{
+			std::cerr << "ERROR.: " << mismatches << " CRC mismatches!" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!cmdLine.hasFlag("no_bench"))
+	{
+		benchmark();
+	}
+
+	return 0;
+}
+
+unsigned int Crc32Bench::crossCheck()
+{
+	using utils::crc32::Engine;
+
+	// Room for a misaligned start, so the engines also get to run their unaligned heads and tails.
+	std::vector<uint8_t> buffer(static_cast<size_t>(maxCheckSize) + 16);
+	std::uniform_int_distribution<uint32_t> randomByte(0, 255);
+	std::uniform_int_distribution<uint32_t> randomCrc;
+	std::uniform_int_distribution<uint64_t> randomSize(0, maxCheckSize);
+	std::uniform_int_distribution<size_t>   randomAlign(0, 15);
+
+	unsigned int mismatches = 0;
+	for (uint64_t check = 0; check < numChecks; ++check)
+	{
+		const size_t size  = static_cast<size_t>(randomSize(random));
+		const size_t align = randomAlign(random);
+		uint8_t * data = buffer.data() + align;
+		for (size_t i = 0; i < size; ++i)
+		{
+			data[i] = static_cast<uint8_t>(randomByte(random));
+		}
+
+		// A non-zero starting CRC half of the time, as when a buffer is checksummed in pieces.
+		const uint32_t seed = (check & 1) ? randomCrc(random) : 0;
+		const uint32_t expected = utils::crc32::compute(Engine::Nibble, data, size, seed);
+
+		for (int e = 0; e < Engine::Count; ++e)
+		{
+			const auto engine = static_cast<Engine::Enum>(e);
+			if (engine == Engine::Nibble || !utils::crc32::isEngineSupported(engine))
+			{
+				continue;
+			}
+
+			const uint32_t crc = utils::crc32::compute(engine, data, size, seed);
+			if (crc != expected)
+			{
+				if (verbose)
+				{
+					std::cout << utils::format("Mismatch: %s size=%zu align=%zu seed=%08X: %08X, expected %08X\n",
+							utils::crc32::getEngineName(engine), size, align, seed, crc, expected);
+				}
+				++mismatches;
+			}
+		}
+
+		const size_t split = (size != 0) ? static_cast<size_t>(randomSize(random) % (size + 1)) : 0;
+		const uint32_t crcA = utils::crc32::compute(Engine::Nibble, data, split, seed);
+		const uint32_t crcB = utils::crc32::compute(Engine::Nibble, data + split, size - split);
+		const uint32_t combined = utils::crc32::combine(crcA, crcB, size - split);
+		if (combined != expected)
+		{
+			if (verbose)
+			{
+				std::cout << utils::format("Mismatch: combine() size=%zu split=%zu seed=%08X: %08X, expected %08X\n",
+						size, split, seed, combined, expected);
+			}
+			++mismatches;
+		}
+	}
+
+	std::cout << "Checked..: " << numChecks << " random buffers of up to " << maxCheckSize
+	          << " bytes, " << mismatches << " mismatches.\n";
+	return mismatches;
+}
+
+void Crc32Bench::benchmark()
+{
+	using namespace std::chrono;
+	using utils::crc32::Engine;
+
+	std::vector<uint8_t> buffer(static_cast<size_t>(benchSizeMBytes * 1024 * 1024));
+	std::uniform_int_distribution<uint32_t> randomByte(0, 255);
+	for (uint8_t & byte : buffer)
+	{
+		byte = static_cast<uint8_t>(randomByte(random));
+	}
+
+	std::cout << "Buffer...: " << benchSizeMBytes << "MB, best of " << benchRuns << " runs\n";
+
+	for (int e = 0; e < Engine::Count; ++e)
+	{
+		const auto engine = static_cast<Engine::Enum>(e);
+		if (!utils::crc32::isEngineSupported(engine))
+		{
+			continue;
+		}
+
+		double bestSeconds = 0.0;
+		uint32_t crc = 0;
+		for (uint64_t r = 0; r < benchRuns; ++r)
+		{
+			const auto t0 = steady_clock::now();
+			crc = utils::crc32::compute(engine, buffer.data(), buffer.size());
+			const duration<double> seconds(steady_clock::now() - t0);
+
+			if (r == 0 || seconds.count() < bestSeconds)
+			{
+				bestSeconds = seconds.count();
+			}
+		}
+
+		const double mbPerSec = (bestSeconds > 0.0) ? (buffer.size() / (1024.0 * 1024.0)) / bestSeconds : 0.0;
+		std::cout << utils::format("%-11s %10.1f MB/s (CRC %08X)\n", utils::crc32::getEngineName(engine), mbPerSec, crc);
+	}
+}
+
+void Crc32Bench::printHelpText() const
+{
+	std::cout << "Usage:\n";
+	std::cout << "$ " << programName << " [options]\n";
+	std::cout << " Checks every CRC-32 engine this CPU supports, and crc32::combine(), against the\n";
+	std::cout << " original Nibble engine over random buffers, then prints the throughput of each engine.\n";
+	std::cout << " Exits with an error if any CRC doesn't match.\n";
+	std::cout << " Options are:\n";
+	std::cout << "  -h, --help           Prints this help text and exits.\n";
+	std::cout << "  -v, --verbose        Prints each mismatch found.\n";
+	std::cout << "  --checks=N           Number of random buffers to check. Default is 200000.\n";
+	std::cout << "  --max_check_size=N   Largest random buffer, in bytes. Default is 4096.\n";
+	std::cout << "  --size=N             Size of the benchmark buffer, in megabytes. Default is 64.\n";
+	std::cout << "  --runs=N             Benchmark runs per engine. The best one is printed. Default is 5.\n";
+	std::cout << "  --seed=N             Seed of the random data. Default is 1234.\n";
+	std::cout << "  --no_check           Skips the cross-check.\n";
+	std::cout << "  --no_bench           Skips the benchmark.\n";
+	std::cout << "\n";
+	std::cout << "Created by Guilherme R. Lampert, " << __DATE__ << ".\n";
+}
+
+uint64_t Crc32Bench::getNumericFlag(const std::string & flagName, const uint64_t defaultValue) const
+{
+	utils::CmdLineFlag flag;
+	if (!cmdLine.getFlag(flagName, flag) || flag.value.empty())
+	{
+		return defaultValue;
+	}
+	return std::strtoull(flag.value.c_str(), nullptr, 10);
+}
+
+} // namespace tools {}
+
+// ========================================================
+// main():
+// ========================================================
+
+int main(int argc, const char * argv[])
+{
+	try
+	{
+		tools::Crc32Bench crc32bench(argc, argv);
+		return crc32bench.run();
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << "ERROR.: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,247 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: indexbench.cpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: Command line tool that benchmarks the indexing of a Tank.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "siege/siege.hpp"
+#include "utils/utils.hpp"
+#include "utils/simple_cmdline_parser.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+
+namespace tools
+{
+
+// ========================================================
+// IndexBench:
+// ========================================================
+
+class IndexBench final
+{
+public:
+
+	IndexBench(int argc, const char * argv[]);
+	~IndexBench() = default;
+
+	int run();
+
+private:
+
+	// Writes a Tank of 'numFiles' small resources spread over 'numDirs' directories with TankFile::Writer.
+	// The directories are nested in chains of 'dirDepth', so resolving their paths has to walk the parents.
+	void writeTestTank(const std::string & tankFilename);
+
+	// Prints the best time of indexFile() and of indexFileCached(), loading the cache and writing it.
+	void benchmarkTank(const std::string & tankFilename, siege::TankFile::IOMode ioMode);
+
+	// Path of a directory of the generated Tank. Each one is a child of the one before it,
+	// up to 'dirDepth' levels, then a new chain starts at the root.
+	std::string makeDirPath(unsigned int dirIndex) const;
+
+	// Prints some help text to STDOUT.
+	void printHelpText() const;
+
+	// Value of a --flag=N, or the default if not given.
+	uint64_t getNumericFlag(const std::string & flagName, uint64_t defaultValue) const;
+
+	const std::string programName; // argv[0]
+	utils::SimpleCmdLineParser cmdLine;
+
+	// Options:
+	const bool         verbose;
+	const unsigned int numFiles;
+	const unsigned int numDirs;
+	const unsigned int dirDepth;
+	const unsigned int numRuns;
+};
+
+IndexBench::IndexBench(const int argc, const char * argv[])
+	: programName(argv[0])
+	, cmdLine(argc, argv)
+	, verbose(cmdLine.hasFlag("v") || cmdLine.hasFlag("verbose"))
+	, numFiles(static_cast<unsigned int>(getNumericFlag("files", 60000)))
+	, numDirs(std::max(static_cast<unsigned int>(getNumericFlag("dirs", 800)), 1u))
+	, dirDepth(std::max(static_cast<unsigned int>(getNumericFlag("depth", 1)), 1u))
+	, numRuns(std::max(static_cast<unsigned int>(getNumericFlag("runs", 7)), 1u))
+{
+	if (verbose)
+	{
+		siege::defaultLogVerbosity = siege::LogVerbosity::All;
+	}
+	else
+	{
+		siege::defaultLogVerbosity = siege::LogVerbosity::Silent;
+	}
+}
+
+int IndexBench::run()
+{
+	if (cmdLine.hasFlag("h") || cmdLine.hasFlag("help"))
+	{
+		printHelpText();
+		return 0;
+	}
+
+	if (cmdLine.getArgCount() == 0 || cmdLine.getArg(0)[0] == '-')
+	{
+		std::cout << "Not enough arguments!\n";
+		printHelpText();
+		return 0;
+	}
+
+	const std::string tankFilename = cmdLine.getArg(0);
+	const bool useExistingTank = cmdLine.hasFlag("existing");
+
+	if (!useExistingTank)
+	{
+		writeTestTank(tankFilename);
+	}
+
+	benchmarkTank(tankFilename, siege::TankFile::IOMode::Stream);
+	benchmarkTank(tankFilename, siege::TankFile::IOMode::MemoryMapped);
+
+	if (!useExistingTank && !cmdLine.hasFlag("keep"))
+	{
+		std::remove(tankFilename.c_str());
+	}
+	return 0;
+}
+
+std::string IndexBench::makeDirPath(const unsigned int dirIndex) const
+{
+	std::string path;
+	for (unsigned int d = dirIndex - dirIndex % dirDepth; d <= dirIndex; ++d)
+	{
+		path += utils::format("/dir%05u", d);
+	}
+	return path;
+}
+
+void IndexBench::writeTestTank(const std::string & tankFilename)
+{
+	// The contents don't matter here, only the number of entries, so they are tiny and stored Raw.
+	siege::TankFile::Writer writer;
+	for (unsigned int f = 0; f < numFiles; ++f)
+	{
+		const std::string contents = utils::format("resource %u\n", f);
+		writer.addResource(makeDirPath(f % numDirs) + utils::format("/file%06u.gas", f),
+				siege::ByteArray(std::begin(contents), std::end(contents)), siege::TankFile::DataFormat::Raw);
+	}
+	writer.writeTank(tankFilename);
+
+	std::cout << "Tank.....: \"" << tankFilename << "\", " << numFiles << " files in "
+	          << numDirs << " directories up to " << dirDepth << " deep, written by TankFile::Writer\n";
+}
+
+void IndexBench::benchmarkTank(const std::string & tankFilename, const siege::TankFile::IOMode ioMode)
+{
+	using namespace std::chrono;
+	const char * const modeName = (ioMode == siege::TankFile::IOMode::Stream) ? "stream" : "mmap";
+
+	siege::TankFile tank;
+	tank.openForReading(tankFilename, ioMode);
+	siege::TankFile::Reader reader;
+
+	const std::string cacheFile = tankFilename + ".bench.tidx";
+
+	// Best of the runs, each run timing a single call.
+	const auto timeBest = [this](const std::function<void()> & prepare, const std::function<void()> & call)
+	{
+		double bestSeconds = 0.0;
+		for (unsigned int r = 0; r < numRuns; ++r)
+		{
+			prepare();
+			const auto t0 = steady_clock::now();
+			call();
+			const duration<double> seconds(steady_clock::now() - t0);
+			if (r == 0 || seconds.count() < bestSeconds)
+			{
+				bestSeconds = seconds.count();
+			}
+		}
+		return bestSeconds * 1000.0;
+	};
+
+	const double indexMs = timeBest([]() { },
+		[&]() { reader.indexFile(tank); });
+
+	// A missing cache: indexes the Tank and writes the cache.
+	const double cacheMissMs = timeBest([&]() { std::remove(cacheFile.c_str()); },
+		[&]() { reader.indexFileCached(tank, cacheFile); });
+
+	// The cache written by the last run above is loaded every time.
+	bool cacheHit = true;
+	const double cacheHitMs = timeBest([]() { },
+		[&]() { cacheHit = reader.indexFileCached(tank, cacheFile) && cacheHit; });
+
+	std::remove(cacheFile.c_str());
+
+	std::cout << utils::format("%-9s: indexFile() %.2fms, indexFileCached() %.2fms loading the cache%s, "
+			"%.2fms writing it (best of %u, %u files, %u dirs)\n", modeName, indexMs, cacheHitMs,
+			(cacheHit ? "" : " (MISSED)"), cacheMissMs, numRuns, reader.getIndex().getFileCount(),
+			reader.getIndex().getDirCount());
+}
+
+void IndexBench::printHelpText() const
+{
+	std::cout << "Usage:\n";
+	std::cout << "$ " << programName << " <tank_file> [options]\n";
+	std::cout << " Writes a Tank of many small resources to <tank_file> with TankFile::Writer, then times\n";
+	std::cout << " TankFile::Reader::indexFile() and indexFileCached() on it, in both IO modes (stream and\n";
+	std::cout << " memory mapped). indexFileCached() is timed loading an existing cache and writing a new one.\n";
+	std::cout << " Options are:\n";
+	std::cout << "  -h, --help       Prints this help text and exits.\n";
+	std::cout << "  -v, --verbose    Enables the Tank logs.\n";
+	std::cout << "  --files=N        Number of resources in the generated Tank. Default is 60000.\n";
+	std::cout << "  --dirs=N         Number of directories they are spread over. Default is 800.\n";
+	std::cout << "  --depth=N        Nests the directories in chains of N, for deep hierarchies. Default is 1.\n";
+	std::cout << "  --runs=N         Runs of each call. The best one is printed. Default is 7.\n";
+	std::cout << "  --keep           Keeps the generated Tank instead of deleting it at the end.\n";
+	std::cout << "  --existing       Uses <tank_file> as it is instead of writing one.\n";
+	std::cout << "\n";
+	std::cout << "Created by Guilherme R. Lampert, " << __DATE__ << ".\n";
+}
+
+uint64_t IndexBench::getNumericFlag(const std::string & flagName, const uint64_t defaultValue) const
+{
+	utils::CmdLineFlag flag;
+	if (!cmdLine.getFlag(flagName, flag) || flag.value.empty())
+	{
+		return defaultValue;
+	}
+	return std::strtoull(flag.value.c_str(), nullptr, 10);
+}
+
+} // namespace tools {}
+
+// ========================================================
+// main():
+// ========================================================
+
+int main(int argc, const char * argv[])
+{
+	siege::setDefaultLogStream(std::cout);
+
+	try
+	{
+		tools::IndexBench indexBench(argc, argv);
+		return indexBench.run();
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << "ERROR.: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
@@ -16,6 +16,7 @@
 #include "siege/siege.hpp"
 
 #include <chrono>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
 
@@ -38,11 +39,18 @@ private:
 	void writeFile(std::string destFileName, const siege::ByteArray & fileContents) const;
 	void extractSingleFile();
 	void extractAllFiles();
+	bool writeZipArchive();
+	bool verifyTank();
 
 	void printTankHeader() const;
 	void printTankFiles()  const;
 	void printTankDirs()   const;
+	void printTankDirContents() const;
 	void printHelpText()   const;
+	void printPipelineStats(const siege::TankFile::Reader::ExtractionStats & stats,
+	                        const siege::TankFile::Reader::PipelineConfig & pipelineConfig) const;
+
+	uint64_t getNumericFlag(const std::string & flagName, uint64_t defaultValue) const;
 
 	// Inputs/outputs:
 	const std::string programName;
@@ -57,8 +65,15 @@ private:
 	// Options:
 	const bool verbose;
 	const bool timings;
+	const bool mmap;    // Memory map the Tank instead of streaming it
 	const bool raw2png; // Convert RAW images to PNG
 	const bool raw2tga; // Convert RAW images to TGA
+	const bool incremental; // Skip resources unchanged since the last dump
+
+	// Decompression threads of `--dump_all`, `--zip` and `--verify` (0 = one per hardware thread)
+	// and max read and decompressed megabytes waiting to be written.
+	const unsigned int numThreads;
+	const uint64_t maxMBytesInFlight;
 };
 
 // ========================================================
@@ -70,8 +85,12 @@ TankDump::TankDump(const int argc, const char * argv[])
 	, cmdLine(argc, argv)
 	, verbose(cmdLine.hasFlag("v") || cmdLine.hasFlag("verbose"))
 	, timings(cmdLine.hasFlag("t") || cmdLine.hasFlag("timings"))
+	, mmap(cmdLine.hasFlag("m") || cmdLine.hasFlag("mmap"))
 	, raw2png(cmdLine.hasFlag("P") || cmdLine.hasFlag("raw2png"))
 	, raw2tga(cmdLine.hasFlag("T") || cmdLine.hasFlag("raw2tga"))
+	, incremental(cmdLine.hasFlag("i") || cmdLine.hasFlag("incremental"))
+	, numThreads(static_cast<unsigned int>(getNumericFlag("threads", 0)))
+	, maxMBytesInFlight(getNumericFlag("max_inflight", siege::TankFile::Reader::DefaultMaxBytesInFlight / (1024 * 1024)))
 {
 }
 
@@ -122,12 +141,37 @@ int TankDump::run()
 	}
 
 	VPrint("Opening Tank \"" << inputTankFile << "\"...");
-	tankFile.openForReading(inputTankFile);
+	tankFile.openForReading(inputTankFile, mmap ? siege::TankFile::IOMode::MemoryMapped : siege::TankFile::IOMode::Stream);
 	VPrint("Ok.");
 
-	VPrint("Indexing Tank file...");
-	tankReader.indexFile(tankFile);
-	VPrint("Ok.");
+	utils::CmdLineFlag indexCacheFlag;
+	if (cmdLine.getFlag("c", indexCacheFlag) || cmdLine.getFlag("index_cache", indexCacheFlag))
+	{
+		const std::string cacheFile = !indexCacheFlag.value.empty() ? indexCacheFlag.value :
+				siege::TankFile::Reader::getDefaultIndexCacheFile(tankFile);
+
+		VPrint("Indexing Tank file (cache: \"" << cacheFile << "\")...");
+		const bool cacheHit = tankReader.indexFileCached(tankFile, cacheFile);
+		VPrint("Ok. " << (cacheHit ? "Loaded from cache." : "Cache rebuilt.")
+				<< " Index size: " << utils::formatMemoryUnit(tankReader.getIndex().getSizeBytes()));
+	}
+	else
+	{
+		VPrint("Indexing Tank file...");
+		tankReader.indexFile(tankFile);
+		VPrint("Ok. Index size: " << utils::formatMemoryUnit(tankReader.getIndex().getSizeBytes()));
+	}
+
+	// Log the resources as they are extracted, for `tankpack --repack`.
+	utils::CmdLineFlag traceFlag;
+	const bool traceAccesses = cmdLine.getFlag("trace", traceFlag) && !traceFlag.value.empty();
+	tankReader.setAccessTraceEnabled(traceAccesses);
+
+	// One decompression thread per hardware thread unless the user asked for a specific count.
+	siege::TankFile::Reader::PipelineConfig pipelineConfig;
+	pipelineConfig.decodeThreads = numThreads;
+	tankReader.setPipelineConfig(pipelineConfig);
+	tankReader.setMaxBytesInFlight(maxMBytesInFlight * 1024 * 1024);
 
 	if (cmdLine.hasFlag("H") || cmdLine.hasFlag("tank_header"))
 	{
@@ -144,8 +188,23 @@ int TankDump::run()
 		printTankDirs();
 	}
 
-	// You can either extract a single file or the whole
-	// archive, but not both at the same time!
+	if (cmdLine.hasFlag("l") || cmdLine.hasFlag("list_dir"))
+	{
+		printTankDirContents();
+	}
+
+	// Verification failures make the exit code non-zero, so scripts can gate on it.
+	int exitCode = 0;
+	if (cmdLine.hasFlag("V") || cmdLine.hasFlag("verify"))
+	{
+		if (!verifyTank())
+		{
+			exitCode = EXIT_FAILURE;
+		}
+	}
+
+	// You can either extract a single file, the whole archive
+	// or convert it to ZIP, but only one at a time!
 	//
 	if (cmdLine.hasFlag("e") || cmdLine.hasFlag("extract"))
 	{
@@ -155,6 +214,23 @@ int TankDump::run()
 	{
 		extractAllFiles();
 	}
+	else if (cmdLine.hasFlag("z") || cmdLine.hasFlag("zip"))
+	{
+		if (!writeZipArchive())
+		{
+			exitCode = EXIT_FAILURE;
+		}
+	}
+
+	if (traceAccesses)
+	{
+		if (!tankReader.saveAccessTrace(traceFlag.value))
+		{
+			SiegeThrow(siege::Exception, "Failed to write access trace \"" << traceFlag.value << "\": "
+					<< utils::filesys::getLastFileError());
+		}
+		VPrint("Access trace written to \"" << traceFlag.value << "\".");
+	}
 
 	VPrint("Done!");
 
@@ -173,10 +249,11 @@ int TankDump::run()
 #endif // _MSC_VER
 
 		std::cout << "Finished execution on " << timeStr
-		          << "Elapsed time: " << elapsedSeconds.count() << "s\n";
+		          << "Elapsed time: " << elapsedSeconds.count() << "s\n"
+		          << "Peak memory usage: " << utils::formatMemoryUnit(utils::getPeakMemoryUsage()) << "\n";
 	}
 
-	return 0;
+	return exitCode;
 }
 
 void TankDump::writeFile(std::string destFileName, const siege::ByteArray & fileContents) const
@@ -247,98 +324,184 @@ void TankDump::extractAllFiles()
 	VPrint("Extracting whole Tank to path \"" << outputFileDir << "\"...");
 	VPrint("------------------------------");
 
-	if (!utils::filesys::createPath(outputFileDir))
+	// The whole directory tree is created before any file is written, so the
+	// writes below don't need to check their paths on the file system again.
+	utils::filesys::DirectoryCache dirCache;
+	tankReader.createDirectoryTree(outputFileDir, dirCache);
+
+	// The Reader reads, decompresses and verifies the resources in stages of
+	// their own, in the order they are stored. We only get to write them out.
+	// User might want to convert textures to PNG or TGA, which changes their
+	// file names. The incremental dump also needs those to find the old files.
+	siege::TankFile::Reader::ResourceSink sink;
+	sink.outputName = [this](const std::string & resourceName)
 	{
-		SiegeThrow(siege::Exception, "Failed to create path \"" << outputFileDir << "\": " << utils::filesys::getLastFileError());
-	}
-
-	std::vector<siege::TankFile::Task> taskList;
-	taskList.reserve(tankReader.getFileCount());
-
-	std::string destFilename, extension;
-	std::vector<std::string> fileList = tankReader.getFileList();
-	std::sort(std::begin(fileList), std::end(fileList));
-
-	// Walk the file table and decompress each resource asynchronously:
-	for (const auto & resourceName : fileList)
+		if (utils::filesys::getFilenameExtension(resourceName) == ".raw" && (raw2png || raw2tga))
+		{
+			return utils::filesys::removeFilenameExtension(resourceName) + (raw2png ? ".png" : ".tga");
+		}
+		return resourceName;
+	};
+	sink.write = [this, &dirCache, &sink](const std::string & resourceName, siege::TankFile::Reader::ResourceBuffer & contents)
 	{
-		destFilename = outputFileDir + resourceName;
-		if (!utils::filesys::createPath(destFilename))
+		VPrint("Extracting resource file \"" << resourceName << "\"");
+
+		const std::string outputName   = sink.outputName(resourceName);
+		const std::string destFilename = outputFileDir + outputName;
+		if (!dirCache.createPath(destFilename))
 		{
 			SiegeThrow(siege::Exception, "Failed to create path \"" << destFilename << "\": " << utils::filesys::getLastFileError());
 		}
 
-		VPrint("Extracting resource file \"" << resourceName << "\"");
-
-		siege::TankFile::Task task;
-		extension = utils::filesys::getFilenameExtension(resourceName);
+		if (outputName != resourceName)
+		{
+			siege::RawImage rawImage(siege::ByteArray(std::begin(contents), std::end(contents)), resourceName);
+			if (raw2png)
+			{
+				rawImage.writeSurfaceAsPngImage(0, destFilename, true);
+			}
+			else // Assume TGA
+			{
+				rawImage.writeSurfaceAsTgaImage(0, destFilename, false);
+			}
+			return true;
+		}
 
-		// User might want to convert textures to PNG or TGA...
-		if (extension == ".raw" && (raw2png || raw2tga))
+		std::ofstream outFile;
+		if (!utils::filesys::tryOpen(outFile, destFilename, std::ofstream::binary) ||
+		    !outFile.write(reinterpret_cast<const char *>(contents.data()), contents.size()))
 		{
-			auto resourceData = tankReader.extractResourceToMemory(tankFile,
-					resourceName, /* validateCRCs = */ true);
-
-			task = std::async(std::launch::async,
-				[] (siege::ByteArray imageData, std::string imageName,
-				    std::string destFileName, const bool writePng) -> bool
-				{
-					try
-					{
-						siege::RawImage rawImage(std::move(imageData), std::move(imageName));
-						if (writePng)
-						{
-							rawImage.writeSurfaceAsPngImage(0,
-								utils::filesys::removeFilenameExtension(destFileName) + ".png", true);
-						}
-						else // Assume TGA
-						{
-							rawImage.writeSurfaceAsTgaImage(0,
-								utils::filesys::removeFilenameExtension(destFileName) + ".tga", false);
-						}
-						return true;
-					}
-					catch (std::exception & e)
-					{
-						std::cerr << "ERROR.: " << e.what() << std::endl;
-						return false;
-					}
-				},
-			std::move(resourceData), resourceName, destFilename, raw2png);
+			SiegeThrow(siege::Exception, "Failed to write file \"" << destFilename << "\": "
+					<< utils::filesys::getLastFileError());
 		}
-		else
+		return true;
+	};
+	sink.error = [](const std::string &, const std::string & errorText)
+	{
+		std::cerr << "ERROR.: " << errorText << std::endl;
+	};
+
+	siege::TankFile::Reader::ExtractionStats stats;
+	if (incremental)
+	{
+		// The manifest goes next to the output directory, not inside it.
+		std::string manifestFile = outputFileDir;
+		while (manifestFile.length() > 1 && manifestFile.back() == utils::filesys::getPathSeparator()[0])
 		{
-			task = tankReader.extractResourceToFileAsync(tankFile,
-				resourceName, destFilename, /* validateCRCs = */ true);
+			manifestFile.pop_back();
 		}
+		manifestFile += ".manifest";
+
+		const auto result = tankReader.extractAllResourcesIncremental(tankFile, sink,
+				outputFileDir, manifestFile, /* validateCRCs = */ true);
 
-		taskList.emplace_back(std::move(task));
+		for (const auto & path : result.added)   { VPrint("Added.....: " << path); }
+		for (const auto & path : result.changed) { VPrint("Changed...: " << path); }
+		for (const auto & path : result.removed) { VPrint("Removed...: " << path); }
+
+		std::cout << result.added.size() << " added, " << result.changed.size() << " changed, "
+		          << result.removed.size() << " removed and " << result.unchanged << " unchanged resource files"
+		          << " since the last dump (\"" << manifestFile << "\").\n";
+		stats = result.stats;
+	}
+	else
+	{
+		stats = tankReader.extractAllResources(tankFile, sink, /* validateCRCs = */ true);
 	}
 
 	VPrint("------------------------------");
 
-	// Once all files are done, we synchronize.
-	int filesExtracted = 0;
-	int filesFailed    = 0;
-	for (auto & task : taskList)
+	if (stats.filesFailed != 0)
 	{
-		if (task.get())
-		{
-			++filesExtracted;
-		}
-		else
+		std::cerr << "ERROR.: Failed to extract " << stats.filesFailed << " resource files!" << std::endl;
+	}
+
+	VPrint(stats.filesWritten << " resource files extracted from Tank \"" <<
+		tankFile.getFileName() << "\" to path \"" << outputFileDir << "\".");
+
+	if (timings)
+	{
+		printPipelineStats(stats, tankReader.getPipelineConfig());
+	}
+}
+
+bool TankDump::writeZipArchive()
+{
+	assert(tankFile.isOpen());
+	if (outputFileDir.empty())
+	{
+		SiegeThrow(siege::Exception, "`--zip | -z` flag requires a ZIP file name as the second parameter!");
+	}
+
+	siege::TankFile::Reader::ZipOptions options;
+	options.compressionLevel = static_cast<unsigned int>(getNumericFlag("zip_level", options.compressionLevel));
+	options.passThroughZlib  = !cmdLine.hasFlag("zip_recompress");
+
+	VPrint("Writing whole Tank to ZIP archive \"" << outputFileDir << "\"...");
+	const auto report = tankReader.transcodeToZip(tankFile, outputFileDir, options);
+
+	for (const auto & failure : report.failures)
+	{
+		std::cerr << "FAILED: " << failure.resourcePath << "\n        " << failure.errorText << std::endl;
+	}
+
+	std::cout << "Files passed through: " << report.filesPassedThrough << "\n";
+	std::cout << "Files recompressed..: " << report.filesDeflated << "\n";
+	std::cout << "Files stored........: " << report.filesStored << "\n";
+	std::cout << "Files failed........: " << report.failures.size() << " (" << report.invalidFiles << " marked invalid skipped)\n";
+	std::cout << "Directories.........: " << report.directories << "\n";
+	std::cout << "Wrote " << utils::formatMemoryUnit(report.zipSizeBytes) << " to \"" << outputFileDir
+	          << "\" in " << report.elapsedSeconds << "s.\n";
+
+	if (timings)
+	{
+		printPipelineStats(report.stats, report.pipelineConfig);
+	}
+
+	return report.failures.empty();
+}
+
+bool TankDump::verifyTank()
+{
+	assert(tankFile.isOpen());
+
+	VPrint("Verifying Tank \"" << inputTankFile << "\"...");
+	const auto report = tankReader.verify(tankFile);
+
+	const auto & header = tankFile.getFileHeader();
+	auto crcStatus = [](const bool checked, const uint32_t computed, const uint32_t expected)
+	{
+		if (!checked)
 		{
-			++filesFailed;
+			return std::string("not checked");
 		}
+		return utils::format("0x%08X ", computed) + ((computed == expected) ? "OK" : utils::format("MISMATCH (header says 0x%08X)", expected));
+	};
+
+	std::cout << "Index CRC-32.......: " << crcStatus(report.indexCrcChecked, report.computedIndexCrc32, header.indexCrc32) << "\n";
+	std::cout << "Data CRC-32........: " << crcStatus(report.dataCrcChecked,  report.computedDataCrc32,  header.dataCrc32)  << "\n";
+	std::cout << "Resources checked..: " << report.filesChecked << " (" << report.invalidFiles << " marked invalid skipped)\n";
+	std::cout << "Resources failed...: " << report.failures.size() << "\n";
+
+	for (const auto & error : report.tankErrors)
+	{
+		std::cerr << "ERROR.: " << error << std::endl;
+	}
+	for (const auto & failure : report.failures)
+	{
+		std::cerr << "FAILED: " << failure.resourcePath << "\n        " << failure.errorText << std::endl;
 	}
 
-	if (filesFailed != 0)
+	std::cout << "Verified " << utils::formatMemoryUnit(report.tankSizeBytes) << " in " << report.elapsedSeconds
+	          << "s (" << utils::format("%.1f", report.getMegabytesPerSecond()) << " MB/s).\n";
+
+	if (timings)
 	{
-		std::cerr << "ERROR.: Failed to extract " << filesFailed << " resource files!" << std::endl;
+		printPipelineStats(report.stats, tankReader.getPipelineConfig());
 	}
 
-	VPrint(filesExtracted << " resource files extracted from Tank \"" <<
-		tankFile.getFileName() << "\" to path \"" << outputFileDir << "\".");
+	std::cout << "Tank \"" << tankFile.getFileName() << "\" " << (report.passed() ? "PASSED" : "FAILED") << " verification.\n";
+	return report.passed();
 }
 
 void TankDump::printTankHeader() const
@@ -391,18 +554,44 @@ void TankDump::printTankFiles() const
 {
 	assert(tankFile.isOpen());
 
-	std::vector<std::string> fileList = tankReader.getFileList();
-	std::sort(std::begin(fileList), std::end(fileList));
+	// `--list_files=pattern` only lists the files starting with a path
+	// or, if the pattern has wildcards, the files matching a glob.
+	utils::CmdLineFlag listFlag;
+	cmdLine.getFlag("list_files", listFlag);
+	const std::string & pattern = listFlag.value;
 
 	std::cout << "\n";
 	std::cout << "-------- TANK FILES --------\n";
 
-	for (size_t f = 0; f < fileList.size(); ++f)
+	uint32_t numListed = 0;
+	const auto printPath = [&numListed](const utils::StringView path)
 	{
-		std::cout << "[" << std::setw(4) << std::setfill('0') << f << "] " << fileList[f] << "\n";
+		std::cout << "[" << std::setw(4) << std::setfill('0') << numListed++ << "] " << path << "\n";
+	};
+
+	if (pattern.empty())
+	{
+		for (const utils::StringView path : tankReader.getFileList())
+		{
+			printPath(path);
+		}
+	}
+	else if (utils::filesys::getGlobLiteralPrefixLength(pattern) == pattern.length())
+	{
+		for (const utils::StringView path : tankReader.getFileListWithPrefix(pattern))
+		{
+			printPath(path);
+		}
+	}
+	else
+	{
+		for (const utils::StringView path : tankReader.getFileListMatching(pattern))
+		{
+			printPath(path);
+		}
 	}
 
-	std::cout << "Listed " << fileList.size() << " files.\n";
+	std::cout << "Listed " << numListed << " files.\n";
 	std::cout << "\n";
 }
 
@@ -410,13 +599,12 @@ void TankDump::printTankDirs() const
 {
 	assert(tankFile.isOpen());
 
-	std::vector<std::string> dirList = tankReader.getDirectoryList();
-	std::sort(std::begin(dirList), std::end(dirList));
+	const auto dirList = tankReader.getDirectoryList();
 
 	std::cout << "\n";
 	std::cout << "-------- TANK DIRECTORIES --------\n";
 
-	for (size_t d = 0; d < dirList.size(); ++d)
+	for (uint32_t d = 0; d < dirList.size(); ++d)
 	{
 		std::cout << "[" << std::setw(4) << std::setfill('0') << d << "] " << dirList[d] << "\n";
 	}
@@ -425,6 +613,33 @@ void TankDump::printTankDirs() const
 	std::cout << "\n";
 }
 
+void TankDump::printTankDirContents() const
+{
+	assert(tankFile.isOpen());
+
+	// The root unless given with `--list_dir=path`.
+	utils::CmdLineFlag dirFlag;
+	cmdLine.getFlag("list_dir", dirFlag);
+	const std::string dirPath = !dirFlag.value.empty() ? dirFlag.value : utils::filesys::getPathSeparator();
+	const auto listing = tankReader.listDirectory(dirPath);
+
+	std::cout << "\n";
+	std::cout << "-------- TANK DIRECTORY " << dirPath << " --------\n";
+
+	for (const utils::StringView path : listing.subdirs)
+	{
+		std::cout << "<DIR>      " << path << "\n";
+	}
+	for (uint32_t f = 0; f < listing.files.size(); ++f)
+	{
+		const auto & resFile = tankReader.getIndex().getFile(listing.files.getRecordIndex(f));
+		std::cout << std::setw(10) << std::setfill(' ') << resFile.size << " " << listing.files[f] << "\n";
+	}
+
+	std::cout << "Listed " << listing.subdirs.size() << " directories and " << listing.files.size() << " files.\n";
+	std::cout << "\n";
+}
+
 void TankDump::printHelpText() const
 {
 	std::cout << "Usage:\n";
@@ -435,19 +650,71 @@ void TankDump::printHelpText() const
 	std::cout << " Options are:\n";
 	std::cout << "  -h, --help        Prints this help text and exits.\n";
 	std::cout << "  -v, --verbose     If present enables verbose output about the program execution.\n";
-	std::cout << "  -t, --timings     If present prints the time taken to process the file(s).\n";
+	std::cout << "  -t, --timings     If present prints the time taken to process the file(s), the peak memory usage\n";
+	std::cout << "                    and the time spent on each stage of `--dump_all`.\n";
+	std::cout << "  -m, --mmap        Memory maps the Tank file instead of reading it through a file stream.\n";
+	std::cout << "  -c, --index_cache Loads the Tank index from a cache file next to the Tank (<tank_file>.tidx),\n";
+	std::cout << "                    writing it first if missing or stale. `--index_cache=path` selects another file.\n";
 	std::cout << "  -H, --tank_header Displays the Tank file header and exits.\n";
-	std::cout << "  -f, --list_files  Displays a list of all FILES in the Tank.\n";
+	std::cout << "  -f, --list_files  Displays a list of all FILES in the Tank. `--list_files=pattern` only lists the files\n";
+	std::cout << "                    under a path (e.g. `/art/maps/`) or matching a glob (e.g. `/art/**/*.raw`).\n";
 	std::cout << "  -d, --list_dirs   Displays a list of all DIRECTORIES in the Tank.\n";
+	std::cout << "  -l, --list_dir    Displays the directories and files right under the root of the Tank, with the file\n";
+	std::cout << "                    sizes. `--list_dir=path` lists another directory (e.g. `/art/maps/`).\n";
 	std::cout << "  -P, --raw2png     Converts all RAW images to PNG before writing to file (only the 1st surface).\n";
 	std::cout << "  -T, --raw2tga     Converts all RAW images to TGA before writing to file (only the 1st surface).\n";
 	std::cout << "  -e, --extract     The second parameter is the name of a file that is to be extracted from the Tank.\n";
 	std::cout << "  -D, --dump_all    The second parameter is the name of a directory where the whole Tank is to be decompressed into.\n";
 	std::cout << "                    The output directory will be created if it does not exists.\n";
+	std::cout << "  -i, --incremental With `--dump_all`, skips the files that haven't changed since the last dump to the same\n";
+	std::cout << "                    directory, going by the CRC, size and time in a manifest kept next to it (<directory>.manifest).\n";
+	std::cout << "                    Prints what was added, changed or removed. Files of removed resources are not deleted.\n";
+	std::cout << "  -z, --zip         The second parameter is the name of a ZIP archive the whole Tank is to be written to,\n";
+	std::cout << "                    straight from the Tank, without extracting it first. The compressed data of Zlib\n";
+	std::cout << "                    files is copied as it is, the others are compressed again in parallel.\n";
+	std::cout << "                    The exit code is non-zero if any file failed.\n";
+	std::cout << "  --zip_level=N     Deflate level (0-10) of the files `--zip` compresses. Default is 6. Zero stores all files.\n";
+	std::cout << "  --zip_recompress  Makes `--zip` compress the Zlib files again instead of copying their compressed data.\n";
+	std::cout << "  -V, --verify      Checks the whole Tank without extracting anything: the index and data CRCs of the\n";
+	std::cout << "                    header, the chunk headers and the CRC of every file. Lists the files that failed and\n";
+	std::cout << "                    the throughput. The exit code is non-zero if anything failed.\n";
+	std::cout << "  --threads=N       Number of decompression threads used by `--dump_all` and `--verify`, or of\n";
+	std::cout << "                    decompression and compression threads together for `--zip`. Defaults to one per\n";
+	std::cout << "                    hardware thread, less the conversion thread of `--dump_all` and `--verify`.\n";
+	std::cout << "  --trace=file      Writes the resources extracted, in the order they were opened, to an access trace\n";
+	std::cout << "                    file that `tankpack --repack` can use to lay out a Tank.\n";
+	std::cout << "  --max_inflight=N  Max megabytes of read and decompressed data held in memory by `--dump_all`, `--zip`\n";
+	std::cout << "                    and `--verify`, the reads wait for the writes when over it. Default is "
+	          << (siege::TankFile::Reader::DefaultMaxBytesInFlight / (1024 * 1024)) << ". Zero means no limit.\n";
 	std::cout << "\n";
 	std::cout << "Created by Guilherme R. Lampert, " << __DATE__ << ".\n";
 }
 
+void TankDump::printPipelineStats(const siege::TankFile::Reader::ExtractionStats & stats,
+                                  const siege::TankFile::Reader::PipelineConfig & pipelineConfig) const
+{
+	const unsigned int decodeThreads = tankReader.getDecodeThreadCount(pipelineConfig);
+
+	std::cout << "Read...........: " << utils::formatMemoryUnit(stats.bytesRead) << " in " << stats.readCalls
+	          << " reads, busy " << stats.readSeconds << "s (" << pipelineConfig.readThreads << " threads)\n";
+	std::cout << "Decode.........: " << utils::formatMemoryUnit(stats.bytesExtracted)
+	          << ", busy " << stats.decodeSeconds << "s (" << decodeThreads << " threads)\n";
+	std::cout << "Verify/convert.: busy " << stats.verifySeconds << "s (" << pipelineConfig.verifyThreads << " threads)\n";
+	std::cout << "Write..........: busy " << stats.writeSeconds << "s (" << pipelineConfig.writeThreads << " threads)\n";
+	std::cout << "Peak in flight.: " << utils::formatMemoryUnit(stats.peakBytesInFlight) << "\n";
+	std::cout << "Extraction time: " << stats.elapsedSeconds << "s\n";
+}
+
+uint64_t TankDump::getNumericFlag(const std::string & flagName, const uint64_t defaultValue) const
+{
+	utils::CmdLineFlag flag;
+	if (!cmdLine.getFlag(flagName, flag) || flag.value.empty())
+	{
+		return defaultValue;
+	}
+	return std::strtoull(flag.value.c_str(), nullptr, 10);
+}
+
 #undef VPrint
 
 } // namespace tool {}
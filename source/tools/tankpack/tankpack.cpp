@@ -0,0 +1,285 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: tankpack.cpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: Command line tool that packs a directory tree into a Dungeon Siege Tank file,
+//        or repacks an existing Tank with its data laid out in the order it is used.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "utils/utils.hpp"
+#include "siege/siege.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+namespace tools
+{
+
+// ========================================================
+// TankPack:
+// ========================================================
+
+class TankPack final
+{
+public:
+
+	TankPack(int argc, const char * argv[]);
+	int run();
+
+private:
+
+	void addResources(siege::TankFile::Writer & tankWriter);
+	void addResourcesFromTank(siege::TankFile::Writer & tankWriter);
+	void printHelpText() const;
+	uint64_t getNumericFlag(const std::string & flagName, uint64_t defaultValue) const;
+
+	// Inputs/outputs:
+	const std::string programName;
+	utils::SimpleCmdLineParser cmdLine;
+	std::string inputPath; // Directory, or Tank if repacking
+	std::string outputTankFile;
+
+	// Source Tank when repacking. Must stay open until the new Tank is written.
+	siege::TankFile sourceTankFile;
+	siege::TankFile::Reader sourceTankReader;
+
+	// Options:
+	const bool verbose;
+	const bool timings;
+	const bool store;  // No compression
+	const bool repack; // Input is a Tank
+
+	// Compression worker threads (0 = one per hardware thread).
+	const unsigned int numThreads;
+};
+
+// ========================================================
+
+#define VPrint(x) if (verbose) { std::cout << x << "\n"; }
+
+TankPack::TankPack(const int argc, const char * argv[])
+	: programName(argv[0])
+	, cmdLine(argc, argv)
+	, verbose(cmdLine.hasFlag("v") || cmdLine.hasFlag("verbose"))
+	, timings(cmdLine.hasFlag("t") || cmdLine.hasFlag("timings"))
+	, store(cmdLine.hasFlag("s") || cmdLine.hasFlag("store"))
+	, repack(cmdLine.hasFlag("r") || cmdLine.hasFlag("repack"))
+	, numThreads(static_cast<unsigned int>(getNumericFlag("threads", 0)))
+{
+}
+
+int TankPack::run()
+{
+	if (cmdLine.getArgCount() < 2)
+	{
+		std::cout << "Not enough arguments!\n";
+		printHelpText();
+		return 0;
+	}
+
+	if (cmdLine.hasFlag("h") || cmdLine.hasFlag("help"))
+	{
+		printHelpText();
+		return 0;
+	}
+
+	if (cmdLine.getArg(0)[0] == '-' || cmdLine.getArg(1)[0] == '-')
+	{
+		std::cerr << "ERROR.: First two arguments must be the source directory (or Tank) and the Tank file!" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	inputPath      = cmdLine.getArg(0);
+	outputTankFile = cmdLine.getArg(1);
+
+	VPrint("In path......: " << inputPath);
+	VPrint("Out file.....: " << outputTankFile);
+	VPrint("Options......: " << cmdLine.getFlagsString());
+
+	// We optionally measure execution time.
+	using namespace std::chrono;
+	system_clock::time_point t0, t1;
+
+	if (timings)
+	{
+		t0 = system_clock::now();
+	}
+
+	// Use the shared pool unless the user asked for a specific thread count.
+	std::unique_ptr<utils::JobSystem> localJobSystem;
+	if (numThreads != 0)
+	{
+		localJobSystem.reset(new utils::JobSystem(numThreads));
+	}
+
+	siege::TankFile::Writer tankWriter;
+	tankWriter.setJobSystem(localJobSystem.get());
+	tankWriter.setCompressionLevel(static_cast<unsigned int>(getNumericFlag("level",
+			utils::compression::Level::DefaultCompression)));
+	tankWriter.setChunkSize(static_cast<uint32_t>(getNumericFlag("chunk_size",
+			siege::TankFile::Writer::DefaultChunkSize / 1024) * 1024));
+
+	if (repack)
+	{
+		addResourcesFromTank(tankWriter);
+	}
+	else
+	{
+		addResources(tankWriter);
+	}
+
+	// Set after the files, so these replace the texts copied when repacking.
+	utils::CmdLineFlag textFlag;
+	if (cmdLine.getFlag("title", textFlag))
+	{
+		tankWriter.setTitleText(textFlag.value);
+	}
+	if (cmdLine.getFlag("author", textFlag))
+	{
+		tankWriter.setAuthorText(textFlag.value);
+	}
+	if (cmdLine.getFlag("description", textFlag))
+	{
+		tankWriter.setDescriptionText(textFlag.value);
+	}
+
+	VPrint("Writing Tank \"" << outputTankFile << "\"...");
+	tankWriter.writeTank(outputTankFile);
+	VPrint("Ok. Index CRC-32: " << utils::format("0x%08X", tankWriter.getHeader().indexCrc32)
+			<< ", data CRC-32: " << utils::format("0x%08X", tankWriter.getHeader().dataCrc32));
+
+	VPrint("Done!");
+
+	if (timings)
+	{
+		t1 = system_clock::now();
+
+		const duration<double> elapsedSeconds(t1 - t0);
+		const auto endTime = system_clock::to_time_t(t1);
+
+#ifdef _MSC_VER
+		char timeStr[256];
+		ctime_s(timeStr, sizeof(timeStr), &endTime);
+#else // _MSC_VER
+		const char * const timeStr = std::ctime(&endTime);
+#endif // _MSC_VER
+
+		std::cout << "Finished execution on " << timeStr
+		          << "Elapsed time: " << elapsedSeconds.count() << "s\n"
+		          << "Peak memory usage: " << utils::formatMemoryUnit(utils::getPeakMemoryUsage()) << "\n";
+	}
+
+	return 0;
+}
+
+void TankPack::addResources(siege::TankFile::Writer & tankWriter)
+{
+	const auto format = store ? siege::TankFile::DataFormat::Raw : siege::TankFile::DataFormat::Zlib;
+
+	VPrint("Gathering files...");
+	const unsigned int fileCount = tankWriter.addResourcesFromDirectory(inputPath, "/", format);
+	VPrint("Ok. Found " << fileCount << " files.");
+}
+
+void TankPack::addResourcesFromTank(siege::TankFile::Writer & tankWriter)
+{
+	VPrint("Opening Tank \"" << inputPath << "\"...");
+	sourceTankFile.openForReading(inputPath);
+	sourceTankReader.indexFile(sourceTankFile);
+	VPrint("Ok.");
+
+	const unsigned int fileCount = tankWriter.addAllResourcesFromTank(sourceTankReader, sourceTankFile);
+	VPrint("Copying " << fileCount << " files as stored.");
+
+	// Files in the trace go first, in the order they were first opened.
+	utils::CmdLineFlag traceFlag;
+	if ((cmdLine.getFlag("r", traceFlag) || cmdLine.getFlag("repack", traceFlag)) && !traceFlag.value.empty())
+	{
+		std::vector<siege::TankFile::Reader::AccessRecord> records;
+		if (!siege::TankFile::Reader::loadAccessTrace(traceFlag.value, records))
+		{
+			SiegeThrow(siege::Exception, "Failed to load access trace \"" << traceFlag.value << "\": "
+					<< utils::filesys::getLastFileError());
+		}
+
+		std::vector<std::string> placementOrder;
+		placementOrder.reserve(records.size());
+		for (auto & rec : records)
+		{
+			placementOrder.push_back(std::move(rec.resourcePath));
+		}
+		tankWriter.setPlacementOrder(placementOrder);
+
+		VPrint("Placing traced files first (" << records.size() << " accesses in \"" << traceFlag.value << "\").");
+	}
+}
+
+void TankPack::printHelpText() const
+{
+	std::cout << "Usage:\n";
+	std::cout << "$ " << programName << " <source_directory | source_tank> <tank_file> [options]\n";
+	std::cout << " Packs a directory tree into a Dungeon Siege Tank file, usually with the `.dsres` or `.dsm` extension.\n";
+	std::cout << " Files are compressed with Zlib unless they don't get any smaller.\n";
+	std::cout << " With `--repack` the source is a Tank, which is rewritten with the files stored as they are\n";
+	std::cout << " (same compressed data, CRCs and entries), but the data laid out in the order given by an\n";
+	std::cout << " access trace, such as the ones written by `tankdump --trace`.\n";
+	std::cout << " Options are:\n";
+	std::cout << "  -h, --help        Prints this help text and exits.\n";
+	std::cout << "  -v, --verbose     If present enables verbose output about the program execution.\n";
+	std::cout << "  -t, --timings     If present prints the time taken to write the Tank and the peak memory usage.\n";
+	std::cout << "  -s, --store       Stores all files without compression.\n";
+	std::cout << "  -r, --repack      First argument is a Tank to rewrite. `--repack=trace_file` places the files\n";
+	std::cout << "                    of the access trace first, in the order they were opened.\n";
+	std::cout << "  --level=N         Zlib compression level, 0 to 10. Default is "
+	          << utils::compression::Level::DefaultCompression << ".\n";
+	std::cout << "  --chunk_size=N    Size in kilobytes of the compressed chunks. Default is "
+	          << (siege::TankFile::Writer::DefaultChunkSize / 1024) << ".\n";
+	std::cout << "  --threads=N       Number of compression threads. Defaults to one per hardware thread.\n";
+	std::cout << "  --title=text      Title text of the Tank header.\n";
+	std::cout << "  --author=text     Author text of the Tank header.\n";
+	std::cout << "  --description=text Description text of the Tank header.\n";
+	std::cout << "\n";
+	std::cout << "Created by Guilherme R. Lampert, " << __DATE__ << ".\n";
+}
+
+uint64_t TankPack::getNumericFlag(const std::string & flagName, const uint64_t defaultValue) const
+{
+	utils::CmdLineFlag flag;
+	if (!cmdLine.getFlag(flagName, flag) || flag.value.empty())
+	{
+		return defaultValue;
+	}
+	return std::strtoull(flag.value.c_str(), nullptr, 10);
+}
+
+#undef VPrint
+
+} // namespace tools {}
+
+// ========================================================
+// main():
+// ========================================================
+
+int main(int argc, const char * argv[])
+{
+	siege::setDefaultLogStream(std::cout);
+	siege::defaultLogVerbosity = siege::LogVerbosity::Silent;
+
+	try
+	{
+		tools::TankPack tankpack(argc, argv);
+		return tankpack.run();
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << "ERROR.: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,401 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: tankstress.cpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: Command line tool that extracts a Tank from many threads at once and checks the results.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "siege/siege.hpp"
+#include "utils/utils.hpp"
+#include "utils/simple_cmdline_parser.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <thread>
+
+namespace tools
+{
+
+// ========================================================
+// TankStress:
+// ========================================================
+
+class TankStress final
+{
+public:
+
+	TankStress(int argc, const char * argv[]);
+	~TankStress() = default;
+
+	int run();
+
+private:
+
+	// Writes a Tank of random resources with TankFile::Writer, keeping their contents in 'writtenContents'.
+	void writeTestTank(const std::string & tankFilename);
+
+	// Extracts every resource from a single thread into 'expectedContents'. If the Tank was
+	// generated, also compares them with what was written. Returns the number of errors.
+	unsigned int extractReference(const std::string & tankFilename);
+
+	// Extracts every resource from 'numThreads' threads at once, each in its own random order and
+	// through all the Reader's extraction methods, comparing each with 'expectedContents'. Returns the errors.
+	unsigned int stressTank(const std::string & tankFilename, siege::TankFile::IOMode ioMode);
+
+	// Prints some help text to STDOUT.
+	void printHelpText() const;
+
+	// Value of a --flag=N, or the default if not given.
+	uint64_t getNumericFlag(const std::string & flagName, uint64_t defaultValue) const;
+
+	const std::string programName; // argv[0]
+	utils::SimpleCmdLineParser cmdLine;
+
+	// Contents of each resource from a single thread extraction and, for
+	// a generated Tank, what was given to the Writer. Sorted by path.
+	std::vector<std::string>      expectedPaths;
+	std::vector<siege::ByteArray> expectedContents;
+	std::vector<siege::ByteArray> writtenContents;
+
+	// Options:
+	const bool         verbose;
+	const unsigned int numThreads;
+	const unsigned int numRounds;
+	const unsigned int numFiles;
+	const unsigned int seed;
+};
+
+TankStress::TankStress(const int argc, const char * argv[])
+	: programName(argv[0])
+	, cmdLine(argc, argv)
+	, verbose(cmdLine.hasFlag("v") || cmdLine.hasFlag("verbose"))
+	, numThreads(static_cast<unsigned int>(getNumericFlag("threads", 16)))
+	, numRounds(static_cast<unsigned int>(getNumericFlag("rounds", 3)))
+	, numFiles(static_cast<unsigned int>(getNumericFlag("files", 2000)))
+	, seed(static_cast<unsigned int>(getNumericFlag("seed", 1234)))
+{
+	if (verbose)
+	{
+		siege::defaultLogVerbosity = siege::LogVerbosity::All;
+	}
+	else
+	{
+		siege::defaultLogVerbosity = siege::LogVerbosity::Silent;
+	}
+}
+
+int TankStress::run()
+{
+	if (cmdLine.hasFlag("h") || cmdLine.hasFlag("help"))
+	{
+		printHelpText();
+		return 0;
+	}
+
+	if (cmdLine.getArgCount() == 0 || cmdLine.getArg(0)[0] == '-')
+	{
+		std::cout << "Not enough arguments!\n";
+		printHelpText();
+		return 0;
+	}
+
+	const std::string tankFilename = cmdLine.getArg(0);
+	const bool useExistingTank = cmdLine.hasFlag("existing");
+
+	if (!useExistingTank)
+	{
+		writeTestTank(tankFilename);
+	}
+
+	unsigned int errors = extractReference(tankFilename);
+	errors += stressTank(tankFilename, siege::TankFile::IOMode::Stream);
+	errors += stressTank(tankFilename, siege::TankFile::IOMode::MemoryMapped);
+
+	if (!useExistingTank && !cmdLine.hasFlag("keep"))
+	{
+		std::remove(tankFilename.c_str());
+	}
+
+	if (errors != 0)
+	{
+		std::cerr << "ERROR.: " << errors << " extraction errors!" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "No errors.\n";
+	return 0;
+}
+
+void TankStress::writeTestTank(const std::string & tankFilename)
+{
+	std::mt19937 random(seed);
+	std::uniform_int_distribution<uint32_t> randomByte(0, 255);
+	std::uniform_int_distribution<uint32_t> randomRun(1, 64);
+
+	// Mostly small files, a few big enough for many chunks and some empty ones.
+	// Runs of repeated bytes make them compress about as well as real resources.
+	siege::TankFile::Writer writer;
+	uint64_t totalBytes = 0;
+	for (unsigned int f = 0; f < numFiles; ++f)
+	{
+		uint32_t size;
+		switch (f % 50)
+		{
+		case 0  : size = 0; break;
+		case 1  : size = 256 * 1024 + random() % (512 * 1024); break;
+		default : size = random() % (24 * 1024); break;
+		} // switch (f % 50)
+
+		siege::ByteArray contents(size);
+		for (uint32_t i = 0; i < size;)
+		{
+			const uint8_t byte = static_cast<uint8_t>(randomByte(random));
+			for (uint32_t run = randomRun(random); run != 0 && i < size; --run)
+			{
+				contents[i++] = byte;
+			}
+		}
+
+		const std::string path = utils::format("/dir%02u/sub%u/file%05u.bin", f % 23, f % 7, f);
+		const auto format = (f % 5 == 0) ? siege::TankFile::DataFormat::Raw : siege::TankFile::DataFormat::Zlib;
+
+		expectedPaths.push_back(path);
+		writtenContents.push_back(contents);
+		totalBytes += size;
+
+		writer.addResource(path, std::move(contents), format);
+	}
+
+	writer.writeTank(tankFilename);
+	std::cout << "Tank.....: \"" << tankFilename << "\", " << numFiles << " files, "
+	          << utils::formatMemoryUnit(totalBytes) << " written by TankFile::Writer\n";
+}
+
+unsigned int TankStress::extractReference(const std::string & tankFilename)
+{
+	siege::TankFile tank;
+	tank.openForReading(tankFilename);
+	siege::TankFile::Reader reader(tank);
+
+	const bool generated = !expectedPaths.empty();
+	if (generated)
+	{
+		// Both lists sorted by path, so written and extracted line up.
+		std::vector<size_t> order(expectedPaths.size());
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			order[i] = i;
+		}
+		std::sort(std::begin(order), std::end(order),
+			[this](const size_t a, const size_t b) { return expectedPaths[a] < expectedPaths[b]; });
+
+		std::vector<std::string>      sortedPaths;
+		std::vector<siege::ByteArray> sortedContents;
+		for (const size_t i : order)
+		{
+			sortedPaths.push_back(std::move(expectedPaths[i]));
+			sortedContents.push_back(std::move(writtenContents[i]));
+		}
+		expectedPaths.swap(sortedPaths);
+		writtenContents.swap(sortedContents);
+	}
+
+	const siege::TankFile::Index::PathList fileList = reader.getFileList();
+	unsigned int errors = 0;
+
+	if (generated && fileList.size() != expectedPaths.size())
+	{
+		std::cerr << "ERROR.: Tank has " << fileList.size() << " files, " << expectedPaths.size() << " were written!" << std::endl;
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < fileList.size(); ++i)
+	{
+		const std::string path = fileList[i].toString();
+		expectedContents.push_back(reader.extractResourceToMemory(tank, path, /* validateCRCs = */ true));
+
+		if (!generated)
+		{
+			expectedPaths.push_back(path);
+		}
+		else if (path != expectedPaths[i] || expectedContents.back() != writtenContents[i])
+		{
+			std::cerr << "ERROR.: \"" << path << "\" doesn't match what was written!" << std::endl;
+			++errors;
+		}
+	}
+
+	std::cout << "Reference: " << expectedPaths.size() << " files extracted from a single thread, "
+	          << errors << " errors\n";
+	return errors;
+}
+
+unsigned int TankStress::stressTank(const std::string & tankFilename, const siege::TankFile::IOMode ioMode)
+{
+	using namespace std::chrono;
+	const char * const modeName = (ioMode == siege::TankFile::IOMode::Stream) ? "stream" : "mmap";
+
+	// One Tank and one Reader shared by all threads, as the Reader's documentation allows.
+	siege::TankFile tank;
+	tank.openForReading(tankFilename, ioMode);
+	siege::TankFile::Reader reader(tank);
+
+	std::atomic<unsigned int> errors(0);
+	std::atomic<uint64_t>     extractions(0);
+
+	const auto reportError = [&](const std::string & path, const std::string & what)
+	{
+		if (errors++ < 20)
+		{
+			std::cerr << "ERROR.: [" << modeName << "] \"" << path << "\": " << what << std::endl;
+		}
+	};
+
+	const auto worker = [&](const unsigned int threadIndex)
+	{
+		std::mt19937 random(seed + threadIndex);
+		std::vector<size_t> order(expectedPaths.size());
+		siege::ByteArray buffer;
+
+		for (unsigned int round = 0; round < numRounds; ++round)
+		{
+			for (size_t i = 0; i < order.size(); ++i)
+			{
+				order[i] = i;
+			}
+			std::shuffle(std::begin(order), std::end(order), random);
+
+			for (const size_t i : order)
+			{
+				const std::string & path = expectedPaths[i];
+				const siege::ByteArray & expected = expectedContents[i];
+				try
+				{
+					// Each thread goes through all the ways of extracting, so they all run at the same time.
+					switch ((i + threadIndex + round) % 3)
+					{
+					case 0 :
+						if (reader.extractResourceToMemory(tank, path, /* validateCRCs = */ true) != expected)
+						{
+							reportError(path, "extractResourceToMemory() contents differ");
+						}
+						break;
+
+					case 1 :
+						buffer.resize(expected.size() + 1);
+						if (reader.extractResourceInto(tank, path, buffer.data(), buffer.size(), true) != expected.size() ||
+						    !std::equal(std::begin(expected), std::end(expected), std::begin(buffer)))
+						{
+							reportError(path, "extractResourceInto() contents differ");
+						}
+						break;
+
+					default :
+						{
+							// A range crossing the chunk boundaries of the bigger files.
+							const uint32_t size   = static_cast<uint32_t>(expected.size());
+							const uint32_t offset = (size != 0) ? static_cast<uint32_t>(random() % size) : 0;
+							const uint32_t length = static_cast<uint32_t>(random() % (64 * 1024));
+							const siege::ByteArray range = reader.extractResourceRange(tank, path, offset, length);
+							const uint32_t expectedLength = std::min(length, size - offset);
+							if (range.size() != expectedLength ||
+							    !std::equal(std::begin(range), std::end(range), std::begin(expected) + offset))
+							{
+								reportError(path, utils::format("extractResourceRange(%u, %u) contents differ", offset, length));
+							}
+						}
+						break;
+					} // switch
+				}
+				catch (std::exception & e)
+				{
+					reportError(path, e.what());
+				}
+				++extractions;
+			}
+		}
+	};
+
+	const auto startTime = steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < numThreads; ++t)
+	{
+		threads.emplace_back(worker, t);
+	}
+	for (std::thread & thread : threads)
+	{
+		thread.join();
+	}
+
+	const duration<double> elapsedSeconds(steady_clock::now() - startTime);
+	std::cout << utils::format("%-9s: %llu extractions from %u threads in %.3fs, %u errors\n", modeName,
+			static_cast<unsigned long long>(extractions.load()), numThreads, elapsedSeconds.count(), errors.load());
+
+	return errors;
+}
+
+void TankStress::printHelpText() const
+{
+	std::cout << "Usage:\n";
+	std::cout << "$ " << programName << " <tank_file> [options]\n";
+	std::cout << " Writes a Tank of random resources to <tank_file> with TankFile::Writer, then has many threads\n";
+	std::cout << " extract all of them at once from a single TankFile and Reader, in both IO modes (stream and\n";
+	std::cout << " memory mapped), comparing every result with a single thread extraction. That extraction\n";
+	std::cout << " is also checked against the contents the Tank was written with.\n";
+	std::cout << " Exits with an error if any extraction fails or differs.\n";
+	std::cout << " Options are:\n";
+	std::cout << "  -h, --help       Prints this help text and exits.\n";
+	std::cout << "  -v, --verbose    Enables the Tank logs.\n";
+	std::cout << "  --threads=N      Number of threads extracting at once. Default is 16.\n";
+	std::cout << "  --rounds=N       Times each thread extracts every resource. Default is 3.\n";
+	std::cout << "  --files=N        Number of resources in the generated Tank. Default is 2000.\n";
+	std::cout << "  --seed=N         Seed of the random data and extraction orders. Default is 1234.\n";
+	std::cout << "  --keep           Keeps the generated Tank instead of deleting it at the end.\n";
+	std::cout << "  --existing       Uses <tank_file> as it is instead of writing one. The reference\n";
+	std::cout << "                   contents come from a single thread extraction.\n";
+	std::cout << "\n";
+	std::cout << "Created by Guilherme R. Lampert, " << __DATE__ << ".\n";
+}
+
+uint64_t TankStress::getNumericFlag(const std::string & flagName, const uint64_t defaultValue) const
+{
+	utils::CmdLineFlag flag;
+	if (!cmdLine.getFlag(flagName, flag) || flag.value.empty())
+	{
+		return defaultValue;
+	}
+	return std::strtoull(flag.value.c_str(), nullptr, 10);
+}
+
+} // namespace tools {}
+
+// ========================================================
+// main():
+// ========================================================
+
+int main(int argc, const char * argv[])
+{
+	siege::setDefaultLogStream(std::cout);
+
+	try
+	{
+		tools::TankStress tankStress(argc, argv);
+		return tankStress.run();
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << "ERROR.: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
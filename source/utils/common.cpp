@@ -13,6 +13,17 @@
 
 #include "utils/common.hpp"
 
+#if defined(WIN32) || defined(WIN64)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	#include <psapi.h>
+	#ifdef _MSC_VER
+		#pragma comment(lib, "psapi.lib")
+	#endif // _MSC_VER
+#else // !WINDOWS
+	#include <sys/resource.h>
+#endif // WINDOWS
+
 namespace utils
 {
 
@@ -144,50 +155,30 @@ std::string formatMemoryUnit(const uint64_t memorySizeInBytes, const bool abbrev
 }
 
 // ========================================================
-// computeCrc32():
+// getPeakMemoryUsage():
 // ========================================================
 
-uint32_t computeCrc32(const void * data, size_t sizeBytes) noexcept
+uint64_t getPeakMemoryUsage() noexcept
 {
-	assert(data != nullptr);
-	assert(sizeBytes != 0);
-
-	//
-	// This compact CRC 32 algo was adapted from miniz.c, which in turn was taken from
-	// "A compact CCITT crc16 and crc32 C implementation that balances processor cache usage against speed"
-	// By Karl Malbrain.
-	//
-	static const uint32_t crcTable[16] =
+#if defined(WIN32) || defined(WIN64)
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
 	{
-		0,
-		0x1DB71064,
-		0x3B6E20C8,
-		0x26D930AC,
-		0x76DC4190,
-		0x6B6B51F4,
-		0x4DB26158,
-		0x5005713C,
-		0xEDB88320,
-		0xF00F9344,
-		0xD6D6A3E8,
-		0xCB61B38C,
-		0x9B64C2B0,
-		0x86D3D2D4,
-		0xA00AE278,
-		0xBDBDF21C
-	};
-
-	const uint8_t * ptr = reinterpret_cast<const uint8_t *>(data);
-	uint32_t crcu32 = 0;
-
-	crcu32 = ~crcu32;
-	while (sizeBytes--)
+		return 0;
+	}
+	return counters.PeakWorkingSetSize;
+#else // !WINDOWS
+	struct rusage usage = {};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
 	{
-		uint8_t b = *ptr++;
-		crcu32 = (crcu32 >> 4) ^ crcTable[(crcu32 & 0xF) ^ (b & 0xF)];
-		crcu32 = (crcu32 >> 4) ^ crcTable[(crcu32 & 0xF) ^ (b >> 4) ];
+		return 0;
 	}
-	return ~crcu32;
+	#ifdef __APPLE__
+	return static_cast<uint64_t>(usage.ru_maxrss); // Already in bytes.
+	#else // !__APPLE__
+	return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // Kilobytes.
+	#endif // __APPLE__
+#endif // WINDOWS
 }
 
 } // namespace utils {}
@@ -105,8 +105,14 @@ std::string removeTrailingFloatZeros(const std::string & floatStr);
 // Memory unit/size to printable string. Example "1 GB" or "1 Gigabyte", depending on 'abbreviated'.
 std::string formatMemoryUnit(uint64_t memorySizeInBytes, bool abbreviated = false);
 
-// Computes a CRC 32 for the given byte array. Pointer must not be null. `sizeBytes` must be nonzero.
-uint32_t computeCrc32(const void * data, size_t sizeBytes) noexcept;
+// Largest amount of physical memory (resident set size) the process has used so far, in bytes.
+// Zero if the platform doesn't tell.
+uint64_t getPeakMemoryUsage() noexcept;
+
+// Computes a CRC 32 for the given byte array. Pointer may only be null if `sizeBytes` is zero.
+// The CRC of data split in pieces can be computed by passing the CRC of the previous pieces as `crc`.
+// Uses the fastest engine for the CPU, see utils/crc32.hpp.
+uint32_t computeCrc32(const void * data, size_t sizeBytes, uint32_t crc = 0) noexcept;
 
 // ========================================================
 // NonCopyable:
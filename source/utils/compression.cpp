@@ -4,7 +4,7 @@
 // File: compression.cpp
 // Author: Guilherme R. Lampert
 // Created on: 02/09/15
-// Brief: Compression/decompression helpers (low-level wrapper over mini-Z).
+// Brief: Compression/decompression helpers (low-level wrapper over mini-Z, plus an LZO1X decoder).
 //
 // This project's source code is released under the MIT License.
 // - http://opensource.org/licenses/MIT
@@ -12,6 +12,9 @@
 // ================================================================================================
 
 #include "utils/compression.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
 
 // ========================================================
 // The header-only mini-Z library (only included here).
@@ -42,6 +45,223 @@ int decompress(uint8_t * dest, unsigned long * destSizeBytes,
 	return mz_uncompress(dest, destSizeBytes, source, sourceSizeBytes);
 }
 
+int decompress(const Codec::Enum codec, uint8_t * dest, unsigned long * destSizeBytes,
+               const uint8_t * source, const unsigned long sourceSizeBytes)
+{
+	switch (codec)
+	{
+	case Codec::Zlib  : return decompress(dest, destSizeBytes, source, sourceSizeBytes);
+	case Codec::Lzo1x : return lzo1xDecompress(dest, destSizeBytes, source, sourceSizeBytes);
+	default           : return Error::ParamError;
+	} // switch (codec)
+}
+
+// ========================================================
+// LZO1X decompressor:
+// ========================================================
+
+//
+// Instruction set of an LZO1X block, as documented in the LZO sources.
+// The meaning of opcodes 0-15 depends on what the previous instruction was:
+//
+//  0000LLLL               After a match with no trailing literals: literal run of L+3 bytes.
+//                         L == 0: 15 + run of zero bytes (255 each) + next byte.
+//  0000DDSS HHHHHHHH      After a match with 1-3 trailing literals: 2 byte match, distance (H << 2) + D + 1.
+//                         After a literal run of 4+ bytes: 3 byte match, distance (H << 2) + D + 2049.
+//  LLLDDDSS HHHHHHHH      (opcode >= 64) Match of L+1 bytes, distance (H << 3) + D + 1.
+//  001LLLLL (ext) DDDDDDSS DDDDDDDD
+//                         Match of L+2 bytes, distance D + 1 (little endian, 14 bits).
+//  0001HLLL (ext) DDDDDDSS DDDDDDDD
+//                         Match of L+2 bytes, distance 16384 + (H << 14) + D. Distance 16384 ends the stream.
+//
+// SS is the number of literals (0-3) that follow a match. A first byte above 17 is a literal run of byte-17 bytes.
+//
+int lzo1xDecompress(uint8_t * dest, unsigned long * destSizeBytes,
+                    const uint8_t * source, const unsigned long sourceSizeBytes)
+{
+	assert(destSizeBytes != nullptr);
+	assert(dest   != nullptr || *destSizeBytes   == 0);
+	assert(source != nullptr || sourceSizeBytes == 0);
+
+	const uint8_t *       ip    = source;
+	const uint8_t * const ipEnd = source + sourceSizeBytes;
+	uint8_t *             op    = dest;
+	uint8_t * const       opEnd = dest + *destSizeBytes;
+
+	*destSizeBytes = 0;
+
+	#define LZO_NEED_IP(n) if (size_t(ipEnd - ip) < size_t(n)) { return Error::DataError;   }
+	#define LZO_NEED_OP(n) if (size_t(opEnd - op) < size_t(n)) { return Error::BufferError; }
+
+	// Lengths of 0 are followed by a run of zero bytes worth 255 each, then a final non-zero byte.
+	// Bounded by the output space left, so they can never overflow.
+	const auto readLongLength = [&ip, ipEnd, &op, opEnd](size_t & length, const size_t base) -> int
+	{
+		length = base;
+		for (;;)
+		{
+			LZO_NEED_IP(1);
+			if (*ip != 0)
+			{
+				break;
+			}
+			length += 255;
+			++ip;
+			LZO_NEED_OP(length);
+		}
+		length += *ip++;
+		return Error::Ok;
+	};
+
+	// 0 after a match with no trailing literals, 1-3 after a match
+	// with that many trailing literals, 4 after a long literal run.
+	size_t state = 0;
+	size_t t;
+
+	LZO_NEED_IP(1);
+	if (*ip > 17)
+	{
+		t = *ip++ - 17;
+		LZO_NEED_IP(t);
+		LZO_NEED_OP(t);
+		std::memcpy(op, ip, t);
+		ip += t;
+		op += t;
+		state = (t < 4) ? t : 4;
+	}
+
+	for (;;)
+	{
+		LZO_NEED_IP(1);
+		t = *ip++;
+
+		size_t matchLen;
+		size_t matchDist;
+
+		if (t < 16)
+		{
+			if (state == 0) // Literal run:
+			{
+				if (t == 0)
+				{
+					const int error = readLongLength(t, 15);
+					if (error != Error::Ok)
+					{
+						return error;
+					}
+				}
+				t += 3;
+				LZO_NEED_IP(t);
+				LZO_NEED_OP(t);
+				std::memcpy(op, ip, t);
+				ip += t;
+				op += t;
+				state = 4;
+				continue;
+			}
+
+			LZO_NEED_IP(1);
+			if (state == 4) // Short match after a literal run:
+			{
+				matchLen  = 3;
+				matchDist = 1 + 0x0800 + (t >> 2) + (size_t(*ip++) << 2);
+			}
+			else // Short match after a match:
+			{
+				matchLen  = 2;
+				matchDist = 1 + (t >> 2) + (size_t(*ip++) << 2);
+			}
+		}
+		else if (t >= 64)
+		{
+			LZO_NEED_IP(1);
+			matchLen  = (t >> 5) + 1;
+			matchDist = 1 + ((t >> 2) & 7) + (size_t(*ip++) << 3);
+		}
+		else if (t >= 32)
+		{
+			matchLen = t & 31;
+			if (matchLen == 0)
+			{
+				const int error = readLongLength(matchLen, 31);
+				if (error != Error::Ok)
+				{
+					return error;
+				}
+			}
+			matchLen += 2;
+
+			LZO_NEED_IP(2);
+			matchDist = 1 + (ip[0] >> 2) + (size_t(ip[1]) << 6);
+			ip += 2;
+		}
+		else // 16 to 31
+		{
+			matchLen = t & 7;
+			if (matchLen == 0)
+			{
+				const int error = readLongLength(matchLen, 7);
+				if (error != Error::Ok)
+				{
+					return error;
+				}
+			}
+			matchLen += 2;
+
+			LZO_NEED_IP(2);
+			matchDist = ((t & 8) << 11) + (ip[0] >> 2) + (size_t(ip[1]) << 6);
+			ip += 2;
+
+			if (matchDist == 0) // End of stream marker.
+			{
+				break;
+			}
+			matchDist += 0x4000;
+		}
+
+		// Copy the match. Overlapping copies repeat the last 'matchDist' bytes.
+		if (matchDist > size_t(op - dest))
+		{
+			return Error::DataError;
+		}
+		LZO_NEED_OP(matchLen);
+
+		const uint8_t * matchPtr = op - matchDist;
+		if (matchDist >= matchLen)
+		{
+			std::memcpy(op, matchPtr, matchLen);
+			op += matchLen;
+		}
+		else
+		{
+			for (size_t i = 0; i < matchLen; ++i)
+			{
+				*op++ = *matchPtr++;
+			}
+		}
+
+		// Trailing literals are encoded in the low bits of the second to last byte read.
+		state = ip[-2] & 3;
+		if (state != 0)
+		{
+			LZO_NEED_IP(state);
+			LZO_NEED_OP(state);
+			for (size_t i = 0; i < state; ++i)
+			{
+				*op++ = *ip++;
+			}
+		}
+	}
+
+	#undef LZO_NEED_IP
+	#undef LZO_NEED_OP
+
+	*destSizeBytes = static_cast<unsigned long>(op - dest);
+
+	// All of the input must have been used.
+	return (ip == ipEnd) ? Error::Ok : Error::DataError;
+}
+
 int compress(uint8_t * dest, unsigned long * destSizeBytes, const uint8_t * source,
              const unsigned long sourceSizeBytes, const unsigned long compressionLevel)
 {
@@ -55,6 +275,618 @@ int compress(uint8_t * dest, unsigned long * destSizeBytes, const uint8_t * sour
 			sourceSizeBytes, static_cast<mz_uint>(compressionLevel));
 }
 
+unsigned long compressBound(const unsigned long sourceSizeBytes)
+{
+	return mz_compressBound(sourceSizeBytes);
+}
+
+int decompressMeasuringLead(uint8_t * dest, unsigned long * destSizeBytes,
+                            const uint8_t * source, const unsigned long sourceSizeBytes,
+                            long * maxLeadBytes)
+{
+	assert(dest != nullptr);
+	assert(destSizeBytes != nullptr && *destSizeBytes != 0);
+
+	assert(source != nullptr);
+	assert(sourceSizeBytes != 0);
+	assert(maxLeadBytes != nullptr);
+
+	// Input is fed in small steps so the lead can be sampled between them.
+	// Output goes straight to the flat 'dest' buffer, same as mz_uncompress().
+	constexpr size_t InputStep = 16;
+
+	tinfl_decompressor inflator;
+	tinfl_init(&inflator);
+
+	size_t inPos  = 0;
+	size_t outPos = 0;
+	long   lead   = 0;
+
+	for (;;)
+	{
+		const size_t stepEnd = std::min<size_t>(inPos + InputStep, sourceSizeBytes);
+		size_t inBytes  = stepEnd - inPos;
+		size_t outBytes = *destSizeBytes - outPos;
+
+		const mz_uint32 flags = TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF |
+		                        TINFL_FLAG_COMPUTE_ADLER32 | ((stepEnd < sourceSizeBytes) ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+
+		const tinfl_status status = tinfl_decompress(&inflator, source + inPos, &inBytes,
+		                                             dest, dest + outPos, &outBytes, flags);
+
+		// Conservative: everything written in this step counts
+		// against the input consumed before the step began.
+		lead = std::max(lead, long(outPos + outBytes) - long(inPos));
+
+		inPos  += inBytes;
+		outPos += outBytes;
+
+		if (status == TINFL_STATUS_DONE)
+		{
+			break;
+		}
+		if (status == TINFL_STATUS_HAS_MORE_OUTPUT)
+		{
+			return Error::BufferError;
+		}
+		if (status != TINFL_STATUS_NEEDS_MORE_INPUT || stepEnd == sourceSizeBytes)
+		{
+			return Error::DataError;
+		}
+	}
+
+	*destSizeBytes = static_cast<unsigned long>(outPos);
+	*maxLeadBytes  = lead;
+	return Error::Ok;
+}
+
+int deflateRaw(uint8_t * dest, unsigned long * destSizeBytes, const uint8_t * source,
+               const unsigned long sourceSizeBytes, const unsigned long compressionLevel, const bool finalPiece)
+{
+	assert(dest != nullptr);
+	assert(destSizeBytes != nullptr && *destSizeBytes != 0);
+
+	assert(source != nullptr);
+	assert(sourceSizeBytes != 0);
+
+	// Too big for the stack, same as what mz_compress2() allocates.
+	std::unique_ptr<tdefl_compressor, void (*)(void *)> compressor(
+			static_cast<tdefl_compressor *>(std::malloc(sizeof(tdefl_compressor))), &std::free);
+	if (compressor == nullptr)
+	{
+		return Error::MemoryError;
+	}
+
+	// Negative window bits select a raw Deflate stream (no Zlib header).
+	const mz_uint flags = tdefl_create_comp_flags_from_zip_params(static_cast<int>(compressionLevel),
+	                                                              -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY);
+	if (tdefl_init(compressor.get(), nullptr, nullptr, static_cast<int>(flags)) != TDEFL_STATUS_OKAY)
+	{
+		return Error::ParamError;
+	}
+
+	size_t inBytes  = sourceSizeBytes;
+	size_t outBytes = *destSizeBytes;
+	const tdefl_status status = tdefl_compress(compressor.get(), source, &inBytes, dest, &outBytes,
+	                                           finalPiece ? TDEFL_FINISH : TDEFL_FULL_FLUSH);
+
+	// Anything left in the compressor's own buffer means 'dest' was too small.
+	const bool complete = finalPiece ? (status == TDEFL_STATUS_DONE) :
+	                      (status == TDEFL_STATUS_OKAY && compressor->m_output_flush_remaining == 0);
+	if (!complete || inBytes != sourceSizeBytes)
+	{
+		return (status < 0) ? Error::ParamError : Error::BufferError;
+	}
+
+	*destSizeBytes = static_cast<unsigned long>(outBytes);
+	return Error::Ok;
+}
+
+bool findZlibDeflateData(const uint8_t * zlibStream, const unsigned long zlibSizeBytes,
+                         unsigned long * deflateOffset, unsigned long * deflateSizeBytes)
+{
+	assert(zlibStream != nullptr);
+	assert(deflateOffset != nullptr && deflateSizeBytes != nullptr);
+
+	constexpr unsigned long HeaderSize  = 2;
+	constexpr unsigned long TrailerSize = 4;
+	if (zlibSizeBytes <= HeaderSize + TrailerSize)
+	{
+		return false;
+	}
+
+	// CMF: method 8 (Deflate) with a window of up to 32K. FLG: no preset dictionary.
+	// The two bytes together must be a multiple of 31 (RFC 1950).
+	const unsigned int cmf = zlibStream[0];
+	const unsigned int flg = zlibStream[1];
+	if ((cmf & 0x0F) != 8 || (cmf >> 4) > 7 || (flg & 0x20) != 0 || ((cmf << 8) | flg) % 31 != 0)
+	{
+		return false;
+	}
+
+	*deflateOffset    = HeaderSize;
+	*deflateSizeBytes = zlibSizeBytes - HeaderSize - TrailerSize;
+	return true;
+}
+
+// ========================================================
+// Deflate block scanning:
+// ========================================================
+
+namespace
+{
+
+// Reads the bits of a Deflate stream, least significant first,
+// through a 64 bits buffer refilled a byte at a time.
+class DeflateBitReader final
+{
+public:
+
+	DeflateBitReader(const uint8_t * source, const unsigned long sourceSizeBytes)
+		: data(source)
+		, sizeBytes(sourceSizeBytes)
+	{ }
+
+	// Makes at least 'count' bits (up to 57) available. Returns false if the stream ends first.
+	bool need(const unsigned int count)
+	{
+		while (bitCount <= 56 && bytePos < sizeBytes)
+		{
+			bitBuffer |= uint64_t(data[bytePos++]) << bitCount;
+			bitCount  += 8;
+		}
+		return bitCount >= count;
+	}
+
+	// The next bits, without consuming them. Call need() first.
+	uint64_t peek() const noexcept { return bitBuffer; }
+	unsigned int getBitsAvailable() const noexcept { return bitCount; }
+
+	void consume(const unsigned int count) noexcept
+	{
+		assert(count <= bitCount);
+		bitBuffer >>= count;
+		bitCount   -= count;
+	}
+
+	// Returns false, reading nothing, if the stream ends first.
+	bool getBits(const unsigned int count, uint32_t & bits)
+	{
+		if (!need(count))
+		{
+			return false;
+		}
+		bits = static_cast<uint32_t>(bitBuffer & ((uint64_t(1) << count) - 1));
+		consume(count);
+		return true;
+	}
+
+	bool skipBytes(const uint64_t count)
+	{
+		const uint64_t newBytePos = getBitPosition() / 8 + count;
+		if (newBytePos > sizeBytes)
+		{
+			return false;
+		}
+		bytePos   = static_cast<size_t>(newBytePos);
+		bitBuffer = 0;
+		bitCount  = 0;
+		return true;
+	}
+
+	void alignToByte() noexcept { consume(bitCount & 7); }
+	uint64_t getBitPosition() const noexcept { return uint64_t(bytePos) * 8 - bitCount; }
+
+private:
+
+	const uint8_t * data;
+	const size_t    sizeBytes;
+	size_t          bytePos   = 0;
+	uint64_t        bitBuffer = 0;
+	unsigned int    bitCount  = 0;
+};
+
+// Canonical Huffman code, as the number of codes of each length
+// and the symbols ordered by code. Same scheme as zlib's puff.c.
+struct HuffmanCode
+{
+	uint16_t count[16];
+	uint16_t symbol[288];
+};
+
+// Returns zero for a complete code, a positive number if incomplete
+// (some codes unused) and a negative one if over-subscribed.
+int buildHuffmanCode(HuffmanCode & code, const uint8_t * lengths, const unsigned int numSymbols)
+{
+	std::fill(std::begin(code.count), std::end(code.count), uint16_t(0));
+	for (unsigned int s = 0; s < numSymbols; ++s)
+	{
+		++code.count[lengths[s]];
+	}
+	if (code.count[0] == numSymbols)
+	{
+		return 0; // No codes. Decoding anything with it fails.
+	}
+
+	int left = 1;
+	for (unsigned int len = 1; len < 16; ++len)
+	{
+		left <<= 1;
+		left -= code.count[len];
+		if (left < 0)
+		{
+			return left;
+		}
+	}
+
+	uint16_t offsets[16];
+	offsets[1] = 0;
+	for (unsigned int len = 1; len < 15; ++len)
+	{
+		offsets[len + 1] = offsets[len] + code.count[len];
+	}
+	for (unsigned int s = 0; s < numSymbols; ++s)
+	{
+		if (lengths[s] != 0)
+		{
+			code.symbol[offsets[lengths[s]]++] = static_cast<uint16_t>(s);
+		}
+	}
+	return left;
+}
+
+// Decodes one symbol, a bit at a time. Returns -1 for an invalid code or the end of the stream.
+int decodeSymbol(DeflateBitReader & in, const HuffmanCode & code)
+{
+	in.need(15);
+	uint64_t bits = in.peek();
+	const unsigned int bitsAvailable = in.getBitsAvailable();
+
+	int first = 0;
+	int index = 0;
+	int value = 0;
+	for (unsigned int len = 1; len < 16 && len <= bitsAvailable; ++len)
+	{
+		value |= static_cast<int>(bits & 1);
+		bits >>= 1;
+
+		const int count = code.count[len];
+		if (value - count < first)
+		{
+			in.consume(len);
+			return code.symbol[index + (value - first)];
+		}
+
+		index += count;
+		first += count;
+		first <<= 1;
+		value <<= 1;
+	}
+	return -1;
+}
+
+// Extra bits of the length (257..285) and distance (0..29) symbols.
+constexpr uint8_t LengthExtraBits[29]   = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+constexpr uint8_t DistanceExtraBits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// Reads the literals and matches of a Huffman coded block up to its end-of-block code.
+bool skipHuffmanCodes(DeflateBitReader & in, const HuffmanCode & lengthCode, const HuffmanCode & distanceCode)
+{
+	for (;;)
+	{
+		int symbol = decodeSymbol(in, lengthCode);
+		if (symbol < 256)
+		{
+			if (symbol < 0)
+			{
+				return false;
+			}
+			continue; // Literal
+		}
+		if (symbol == 256)
+		{
+			return true; // End of block
+		}
+
+		uint32_t extra;
+		symbol -= 257;
+		if (symbol >= 29 || !in.getBits(LengthExtraBits[symbol], extra))
+		{
+			return false;
+		}
+
+		symbol = decodeSymbol(in, distanceCode);
+		if (symbol < 0 || symbol >= 30 || !in.getBits(DistanceExtraBits[symbol], extra))
+		{
+			return false;
+		}
+	}
+}
+
+bool skipFixedBlock(DeflateBitReader & in)
+{
+	struct FixedCodes
+	{
+		HuffmanCode lengthCode;
+		HuffmanCode distanceCode;
+
+		FixedCodes()
+		{
+			uint8_t lengths[288];
+			std::fill(lengths,       lengths + 144, uint8_t(8));
+			std::fill(lengths + 144, lengths + 256, uint8_t(9));
+			std::fill(lengths + 256, lengths + 280, uint8_t(7));
+			std::fill(lengths + 280, lengths + 288, uint8_t(8));
+			buildHuffmanCode(lengthCode, lengths, 288);
+
+			std::fill(lengths, lengths + 30, uint8_t(5));
+			buildHuffmanCode(distanceCode, lengths, 30);
+		}
+	};
+
+	static const FixedCodes fixed;
+	return skipHuffmanCodes(in, fixed.lengthCode, fixed.distanceCode);
+}
+
+bool skipDynamicBlock(DeflateBitReader & in)
+{
+	static const uint8_t codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	uint32_t numLengths, numDistances, numCodeLengths;
+	if (!in.getBits(5, numLengths) || !in.getBits(5, numDistances) || !in.getBits(4, numCodeLengths))
+	{
+		return false;
+	}
+	numLengths     += 257;
+	numDistances   += 1;
+	numCodeLengths += 4;
+	if (numLengths > 286 || numDistances > 30)
+	{
+		return false;
+	}
+
+	uint8_t lengths[286 + 30] = {};
+	for (uint32_t i = 0; i < numCodeLengths; ++i)
+	{
+		uint32_t len;
+		if (!in.getBits(3, len))
+		{
+			return false;
+		}
+		lengths[codeLengthOrder[i]] = static_cast<uint8_t>(len);
+	}
+
+	HuffmanCode lengthCode;
+	HuffmanCode distanceCode;
+	if (buildHuffmanCode(lengthCode, lengths, 19) != 0)
+	{
+		return false; // The code length code must be complete.
+	}
+
+	// Code lengths of the literal/length and distance codes, run-length encoded.
+	const uint32_t numSymbols = numLengths + numDistances;
+	for (uint32_t index = 0; index < numSymbols;)
+	{
+		const int symbol = decodeSymbol(in, lengthCode);
+		if (symbol < 0)
+		{
+			return false;
+		}
+		if (symbol < 16)
+		{
+			lengths[index++] = static_cast<uint8_t>(symbol);
+			continue;
+		}
+
+		uint8_t  len = 0;
+		uint32_t repeat;
+		if (symbol == 16)
+		{
+			if (index == 0 || !in.getBits(2, repeat))
+			{
+				return false;
+			}
+			len = lengths[index - 1];
+			repeat += 3;
+		}
+		else if (symbol == 17)
+		{
+			if (!in.getBits(3, repeat))
+			{
+				return false;
+			}
+			repeat += 3;
+		}
+		else
+		{
+			if (!in.getBits(7, repeat))
+			{
+				return false;
+			}
+			repeat += 11;
+		}
+
+		if (index + repeat > numSymbols)
+		{
+			return false;
+		}
+		while (repeat--)
+		{
+			lengths[index++] = len;
+		}
+	}
+
+	if (lengths[256] == 0)
+	{
+		return false; // No end-of-block code.
+	}
+
+	// Incomplete codes are only allowed with a single code.
+	int error = buildHuffmanCode(lengthCode, lengths, numLengths);
+	if (error < 0 || (error > 0 && numLengths != uint32_t(lengthCode.count[0] + lengthCode.count[1])))
+	{
+		return false;
+	}
+	error = buildHuffmanCode(distanceCode, lengths + numLengths, numDistances);
+	if (error < 0 || (error > 0 && numDistances != uint32_t(distanceCode.count[0] + distanceCode.count[1])))
+	{
+		return false;
+	}
+
+	return skipHuffmanCodes(in, lengthCode, distanceCode);
+}
+
+} // namespace {}
+
+int scanDeflateBlocks(const uint8_t * source, const unsigned long sourceSizeBytes,
+                      uint64_t * lastBlockBit, uint64_t * endBit)
+{
+	assert(source != nullptr);
+	assert(lastBlockBit != nullptr && endBit != nullptr);
+
+	DeflateBitReader in(source, sourceSizeBytes);
+	uint32_t lastBlock = 0;
+	uint64_t blockBit  = 0;
+
+	do
+	{
+		blockBit = in.getBitPosition();
+
+		uint32_t blockType;
+		if (!in.getBits(1, lastBlock) || !in.getBits(2, blockType))
+		{
+			return Error::DataError;
+		}
+
+		bool blockOk = false;
+		switch (blockType)
+		{
+		case 0 : // Stored
+			{
+				uint32_t len, nlen;
+				in.alignToByte();
+				blockOk = in.getBits(16, len) && in.getBits(16, nlen) &&
+				          len == (~nlen & 0xFFFF) && in.skipBytes(len);
+				break;
+			}
+		case 1 : // Fixed Huffman codes
+			blockOk = skipFixedBlock(in);
+			break;
+		case 2 : // Dynamic Huffman codes
+			blockOk = skipDynamicBlock(in);
+			break;
+		default :
+			break;
+		} // switch (blockType)
+
+		if (!blockOk)
+		{
+			return Error::DataError;
+		}
+	}
+	while (!lastBlock);
+
+	*lastBlockBit = blockBit;
+	*endBit       = in.getBitPosition();
+	return Error::Ok;
+}
+
+// ========================================================
+// DeflateStreamBuilder:
+// ========================================================
+
+constexpr uint64_t DeflateStreamBuilder::NoBlock;
+
+int DeflateStreamBuilder::appendDeflate(const uint8_t * source, const unsigned long sourceSizeBytes)
+{
+	uint64_t streamLastBlock, streamEnd;
+	if (scanDeflateBlocks(source, sourceSizeBytes, &streamLastBlock, &streamEnd) != Error::Ok)
+	{
+		return Error::DataError;
+	}
+
+	// The stream's bytes are copied as they are, so it must start on a byte boundary.
+	// An empty stored block gets there, since stored data is byte aligned.
+	if ((bitLength & 7) != 0)
+	{
+		putStoredBlock(nullptr, 0);
+	}
+
+	const uint64_t streamStart = bitLength;
+	data.insert(std::end(data), source, source + (streamEnd + 7) / 8);
+	bitLength = streamStart + streamEnd;
+
+	// Padding after the end-of-block code is cleared for the next block.
+	if ((bitLength & 7) != 0)
+	{
+		data.back() &= static_cast<uint8_t>((1u << (bitLength & 7)) - 1);
+	}
+
+	// Clear BFINAL. finish() sets it again on whichever block ends up last.
+	lastBlockBit = streamStart + streamLastBlock;
+	data[lastBlockBit >> 3] &= static_cast<uint8_t>(~(1u << (lastBlockBit & 7)));
+	return Error::Ok;
+}
+
+void DeflateStreamBuilder::appendStored(const uint8_t * source, unsigned long sourceSizeBytes)
+{
+	constexpr unsigned long MaxStoredBlockSize = 0xFFFF;
+	while (sourceSizeBytes != 0)
+	{
+		const unsigned long blockSize = std::min(sourceSizeBytes, MaxStoredBlockSize);
+		putStoredBlock(source, blockSize);
+		source          += blockSize;
+		sourceSizeBytes -= blockSize;
+	}
+}
+
+void DeflateStreamBuilder::finish()
+{
+	if (lastBlockBit == NoBlock)
+	{
+		putStoredBlock(nullptr, 0);
+	}
+	data[lastBlockBit >> 3] |= static_cast<uint8_t>(1u << (lastBlockBit & 7));
+}
+
+void DeflateStreamBuilder::clear()
+{
+	data.clear();
+	bitLength    = 0;
+	lastBlockBit = NoBlock;
+}
+
+void DeflateStreamBuilder::putBits(const uint32_t bits, const unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i, ++bitLength)
+	{
+		if ((bitLength & 7) == 0)
+		{
+			data.push_back(0);
+		}
+		data.back() |= static_cast<uint8_t>(((bits >> i) & 1) << (bitLength & 7));
+	}
+}
+
+void DeflateStreamBuilder::putStoredBlock(const uint8_t * source, const unsigned long sizeBytes)
+{
+	assert(sizeBytes <= 0xFFFF);
+
+	// BFINAL = 0, BTYPE = 00, then LEN and its complement from the next byte boundary.
+	lastBlockBit = bitLength;
+	putBits(0, 3);
+	bitLength = uint64_t(data.size()) * 8;
+
+	const uint32_t len = static_cast<uint32_t>(sizeBytes);
+	const uint8_t blockHeader[4] = { uint8_t(len), uint8_t(len >> 8), uint8_t(~len), uint8_t(~len >> 8) };
+	data.insert(std::end(data), blockHeader, blockHeader + 4);
+	if (sizeBytes != 0)
+	{
+		data.insert(std::end(data), source, source + sizeBytes);
+	}
+	bitLength += (4 + uint64_t(sizeBytes)) * 8;
+}
+
 uint8_t * writeImageToPngInMemory(const uint8_t * image, const int w, const int h, const int numChans,
                                   size_t * lenOut, const unsigned long compressionLevel, const bool flip)
 {
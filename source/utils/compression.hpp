@@ -12,12 +12,13 @@
 // ================================================================================================
 
 #include "utils/common.hpp"
+#include <vector>
 
 namespace utils
 {
 
 // Helper functions for compression and decompression of raw data.
-// (Mini-Z is the compressor/decompressor back-end).
+// (Mini-Z is the compressor/decompressor back-end. LZO1X decoding is done here).
 namespace compression
 {
 
@@ -35,16 +36,121 @@ struct Level
 	};
 };
 
+// Compressed data formats understood by decompress().
+struct Codec
+{
+	enum Enum
+	{
+		Zlib, // Zlib stream, decoded by Mini-Z.
+		Lzo1x // Raw LZO1X block, as produced by lzo1x_1_compress() & co.
+	};
+};
+
+// Error codes, same values as the Mini-Z/ZLib ones, so getErrorString() covers all codecs.
+struct Error
+{
+	enum Enum
+	{
+		Ok          =  0,
+		DataError   = -3, // Corrupted or truncated compressed data.
+		MemoryError = -4, // Out of memory.
+		BufferError = -5, // Output buffer too small.
+		ParamError  = -10000
+	};
+};
+
 // 'dest' is the decompression buffer; 'source' is the compressed data.
+// On input '*destSizeBytes' is the capacity of 'dest', on output the number of bytes written.
 int decompress(uint8_t * dest, unsigned long * destSizeBytes,
                const uint8_t * source, unsigned long sourceSizeBytes);
 
+// Same as above, but for any of the supported codecs.
+int decompress(Codec::Enum codec, uint8_t * dest, unsigned long * destSizeBytes,
+               const uint8_t * source, unsigned long sourceSizeBytes);
+
+// LZO1X decompressor. Never reads past the end of 'source' or writes past the end
+// of 'dest', so it is safe to use on untrusted data (same as lzo1x_decompress_safe()).
+int lzo1xDecompress(uint8_t * dest, unsigned long * destSizeBytes,
+                    const uint8_t * source, unsigned long sourceSizeBytes);
+
+// Zlib decompression that also measures how far the output gets ahead of the input consumed.
+// '*maxLeadBytes' receives the largest (bytes written - bytes read) seen, checked every 16 bytes
+// of input. Data can be inflated in place, with the compressed bytes at the end of the output
+// buffer, if that buffer has at least 'sourceSizeBytes + *maxLeadBytes' bytes.
+int decompressMeasuringLead(uint8_t * dest, unsigned long * destSizeBytes,
+                            const uint8_t * source, unsigned long sourceSizeBytes,
+                            long * maxLeadBytes);
+
 // 'dest' is the compressed output; 'source' is the uncompressed input data.
 // 'compressionLevel' is one of the Level flags or a value between 0 and 10.
 int compress(uint8_t * dest, unsigned long * destSizeBytes,
              const uint8_t * source, unsigned long sourceSizeBytes,
              unsigned long compressionLevel);
 
+// Upper bound of the compressed size of 'sourceSizeBytes' for compress().
+unsigned long compressBound(unsigned long sourceSizeBytes);
+
+// Compresses 'source' to raw Deflate data, without the Zlib header and trailer, as stored in ZIP archives.
+// Data compressed in separate calls can be concatenated into a single Deflate stream: all pieces but the
+// last end with a full flush (byte aligned, no references to earlier data) and the last one, compressed
+// with 'finalPiece', ends the stream. compressBound() is also a bound for this function.
+int deflateRaw(uint8_t * dest, unsigned long * destSizeBytes,
+               const uint8_t * source, unsigned long sourceSizeBytes,
+               unsigned long compressionLevel, bool finalPiece);
+
+// Finds the raw Deflate data inside a Zlib stream, which is everything between the 2 bytes header and the
+// 4 bytes Adler-32 trailer. Returns false if the header is not a valid Deflate one or uses a preset dictionary.
+bool findZlibDeflateData(const uint8_t * zlibStream, unsigned long zlibSizeBytes,
+                         unsigned long * deflateOffset, unsigned long * deflateSizeBytes);
+
+// Scans a raw Deflate stream, decoding the Huffman codes but not producing any output, to find where its
+// blocks are. '*lastBlockBit' gets the position of the header of the final block and '*endBit' the position
+// just past its end-of-block code. Positions are in bits from the first bit of 'source', in the Deflate
+// bit order (least significant bit first). Returns Error::DataError if the stream is malformed or truncated.
+int scanDeflateBlocks(const uint8_t * source, unsigned long sourceSizeBytes,
+                      uint64_t * lastBlockBit, uint64_t * endBit);
+
+//
+// Joins raw Deflate streams and uncompressed bytes into a single raw Deflate stream without
+// recompressing anything. The final block of each stream is made a normal one and the
+// uncompressed bytes become stored blocks, so the result inflates to all the pieces one
+// after the other. Streams compressed on their own never refer back to data before their
+// start, so they still inflate to the same bytes. Used to move Zlib compressed data into
+// formats that take a single Deflate stream, like ZIP.
+//
+class DeflateStreamBuilder final
+{
+public:
+
+	// Appends a whole raw Deflate stream (see findZlibDeflateData()). Anything after its final
+	// block is ignored. Returns Error::DataError, appending nothing, if the stream is malformed.
+	int appendDeflate(const uint8_t * source, unsigned long sourceSizeBytes);
+
+	// Appends bytes as they are, in stored blocks of up to 64K each.
+	void appendStored(const uint8_t * source, unsigned long sourceSizeBytes);
+
+	// Makes the last block appended the final one, adding an empty block if there are none.
+	// Nothing else can be appended afterwards, until clear().
+	void finish();
+
+	// The stream so far. Only complete after finish().
+	std::vector<uint8_t> & getData() noexcept { return data; }
+
+	void reserve(size_t numBytes) { data.reserve(numBytes); }
+	void clear();
+
+private:
+
+	void putBits(uint32_t bits, unsigned int count);
+	void putStoredBlock(const uint8_t * source, unsigned long sizeBytes);
+
+	static constexpr uint64_t NoBlock = ~uint64_t(0);
+
+	std::vector<uint8_t> data;
+	uint64_t bitLength     = 0;       // Bits used. The rest of the last byte is zero.
+	uint64_t lastBlockBit  = NoBlock; // BFINAL bit of the last block appended.
+};
+
 // Compresses an image to a compressed PNG file in memory.
 // Memory returned should the released with std::free()!
 uint8_t * writeImageToPngInMemory(const uint8_t * image, int w, int h,
@@ -0,0 +1,434 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: crc32.cpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: CRC-32 engines with runtime CPU dispatch.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "utils/crc32.hpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	#define CRC32_HAS_PCLMUL 1
+	#include <emmintrin.h>
+	#include <wmmintrin.h>
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+		#define CRC32_TARGET_PCLMUL
+	#else // GCC & Clang
+		#include <cpuid.h>
+		#define CRC32_TARGET_PCLMUL __attribute__((target("pclmul,sse2")))
+	#endif // _MSC_VER
+#endif // x86
+
+// Runtime detection on ARM is OS specific, so this is only enabled when the
+// compiler already targets the CRC extension (e.g. -march=armv8-a+crc, Apple Silicon).
+#if defined(__ARM_FEATURE_CRC32)
+	#define CRC32_HAS_ARM_CRC 1
+	#include <arm_acle.h>
+#endif // __ARM_FEATURE_CRC32
+
+namespace utils
+{
+namespace crc32
+{
+
+// Reversed representation of the CRC-32 polynomial 0x04C11DB7.
+static constexpr uint32_t Polynomial = 0xEDB88320;
+
+// ========================================================
+// Nibble engine:
+// ========================================================
+
+static uint32_t computeNibble(const uint8_t * ptr, size_t sizeBytes, const uint32_t crc) noexcept
+{
+	//
+	// This compact CRC 32 algo was adapted from miniz.c, which in turn was taken from
+	// "A compact CCITT crc16 and crc32 C implementation that balances processor cache usage against speed"
+	// By Karl Malbrain.
+	//
+	static const uint32_t crcTable[16] =
+	{
+		0,
+		0x1DB71064,
+		0x3B6E20C8,
+		0x26D930AC,
+		0x76DC4190,
+		0x6B6B51F4,
+		0x4DB26158,
+		0x5005713C,
+		0xEDB88320,
+		0xF00F9344,
+		0xD6D6A3E8,
+		0xCB61B38C,
+		0x9B64C2B0,
+		0x86D3D2D4,
+		0xA00AE278,
+		0xBDBDF21C
+	};
+
+	uint32_t crcu32 = crc;
+
+	crcu32 = ~crcu32;
+	while (sizeBytes--)
+	{
+		uint8_t b = *ptr++;
+		crcu32 = (crcu32 >> 4) ^ crcTable[(crcu32 & 0xF) ^ (b & 0xF)];
+		crcu32 = (crcu32 >> 4) ^ crcTable[(crcu32 & 0xF) ^ (b >> 4) ];
+	}
+	return ~crcu32;
+}
+
+// ========================================================
+// Slice-by-8 engine:
+// ========================================================
+
+//
+// Table k gives the CRC of a byte followed by k zero bytes, so eight
+// input bytes can be folded into the CRC with eight independent lookups.
+// 8KB of tables, built on first use.
+//
+struct SliceBy8Tables
+{
+	uint32_t table[8][256];
+
+	SliceBy8Tables() noexcept
+	{
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			uint32_t c = i;
+			for (int bit = 0; bit < 8; ++bit)
+			{
+				c = (c & 1) ? ((c >> 1) ^ Polynomial) : (c >> 1);
+			}
+			table[0][i] = c;
+		}
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			for (int k = 1; k < 8; ++k)
+			{
+				table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+			}
+		}
+	}
+};
+
+static inline uint32_t loadU32LE(const uint8_t * ptr) noexcept
+{
+	return uint32_t(ptr[0]) | (uint32_t(ptr[1]) << 8) | (uint32_t(ptr[2]) << 16) | (uint32_t(ptr[3]) << 24);
+}
+
+static uint32_t computeSliceBy8(const uint8_t * ptr, size_t sizeBytes, const uint32_t crc) noexcept
+{
+	static const SliceBy8Tables tables;
+	const auto & t = tables.table;
+
+	uint32_t c = ~crc;
+	while (sizeBytes >= 8)
+	{
+		const uint32_t lo = loadU32LE(ptr) ^ c;
+		const uint32_t hi = loadU32LE(ptr + 4);
+
+		c = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+		    t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+
+		ptr       += 8;
+		sizeBytes -= 8;
+	}
+	while (sizeBytes--)
+	{
+		c = t[0][(c ^ *ptr++) & 0xFF] ^ (c >> 8);
+	}
+	return ~c;
+}
+
+// ========================================================
+// PCLMULQDQ engine:
+// ========================================================
+
+#if CRC32_HAS_PCLMUL
+
+static bool queryCpuPclmul() noexcept
+{
+	// CPUID leaf 1: ECX bit 1 is PCLMULQDQ, EDX bit 26 is SSE2.
+	unsigned int regs[4] = { 0, 0, 0, 0 };
+	#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 1);
+	for (int i = 0; i < 4; ++i)
+	{
+		regs[i] = static_cast<unsigned int>(info[i]);
+	}
+	#else // GCC & Clang
+	if (!__get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]))
+	{
+		return false;
+	}
+	#endif // _MSC_VER
+	return (regs[2] & (1u << 1)) != 0 && (regs[3] & (1u << 26)) != 0;
+}
+
+static bool cpuHasPclmul() noexcept
+{
+	// CPUID can be very slow under virtualization, so only ask once.
+	static const bool hasPclmul = queryCpuPclmul();
+	return hasPclmul;
+}
+
+//
+// Folds 64 bytes at a time into four 128-bit accumulators with carry-less
+// multiplies, then reduces to 32 bits with a Barrett reduction. Based on
+// "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+// (Gopal et al., Intel 2009), constants for the reflected CRC-32 polynomial.
+// 'sizeBytes' must be a multiple of 16 and at least 64. Takes and returns
+// the raw (non inverted) CRC register.
+//
+CRC32_TARGET_PCLMUL
+static uint32_t foldPclmul(const uint8_t * ptr, size_t sizeBytes, const uint32_t crcReg) noexcept
+{
+	assert(sizeBytes >= 64 && (sizeBytes % 16) == 0);
+
+	const __m128i k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+	const __m128i k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+	const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163CD6124);
+	const __m128i poly = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+	const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+	__m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + 0x00));
+	__m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + 0x10));
+	__m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + 0x20));
+	__m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + 0x30));
+	__m128i x5, x6, x7, x8;
+
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crcReg)));
+	ptr       += 64;
+	sizeBytes -= 64;
+
+	// Fold by 4:
+	while (sizeBytes >= 64)
+	{
+		x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + 0x30)));
+
+		ptr       += 64;
+		sizeBytes -= 64;
+	}
+
+	// Fold the four accumulators into one:
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	// Fold by 1 for the remaining 16 byte blocks:
+	while (sizeBytes >= 16)
+	{
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr))), x5);
+
+		ptr       += 16;
+		sizeBytes -= 16;
+	}
+
+	// 128 bits down to 64:
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, mask);
+	x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits:
+	x2 = _mm_and_si128(x1, mask);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+	x2 = _mm_and_si128(x2, mask);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(x1, 4)));
+}
+
+static uint32_t computePclmul(const uint8_t * ptr, const size_t sizeBytes, const uint32_t crc) noexcept
+{
+	// Not worth the setup for tiny blocks.
+	if (sizeBytes < 64)
+	{
+		return computeSliceBy8(ptr, sizeBytes, crc);
+	}
+
+	const size_t foldedBytes = sizeBytes & ~size_t(15);
+	const uint32_t crcReg = foldPclmul(ptr, foldedBytes, ~crc);
+	return computeSliceBy8(ptr + foldedBytes, sizeBytes - foldedBytes, ~crcReg);
+}
+
+#endif // CRC32_HAS_PCLMUL
+
+// ========================================================
+// ARMv8 CRC engine:
+// ========================================================
+
+#if CRC32_HAS_ARM_CRC
+
+static uint32_t computeArmCrc(const uint8_t * ptr, size_t sizeBytes, const uint32_t crc) noexcept
+{
+	uint32_t c = ~crc;
+	while (sizeBytes >= 8)
+	{
+		uint64_t qword;
+		std::memcpy(&qword, ptr, sizeof(qword));
+		c = __crc32d(c, qword);
+
+		ptr       += 8;
+		sizeBytes -= 8;
+	}
+	while (sizeBytes--)
+	{
+		c = __crc32b(c, *ptr++);
+	}
+	return ~c;
+}
+
+#endif // CRC32_HAS_ARM_CRC
+
+// ========================================================
+// Dispatch:
+// ========================================================
+
+using ComputeFunc = uint32_t (*)(const uint8_t *, size_t, uint32_t);
+
+static ComputeFunc getEngineFunc(const Engine::Enum engine) noexcept
+{
+	switch (engine)
+	{
+	case Engine::Nibble   : return &computeNibble;
+	case Engine::SliceBy8 : return &computeSliceBy8;
+	#if CRC32_HAS_PCLMUL
+	case Engine::Pclmul   : return cpuHasPclmul() ? &computePclmul : nullptr;
+	#endif // CRC32_HAS_PCLMUL
+	#if CRC32_HAS_ARM_CRC
+	case Engine::ArmCrc   : return &computeArmCrc;
+	#endif // CRC32_HAS_ARM_CRC
+	default               : return nullptr;
+	} // switch (engine)
+}
+
+Engine::Enum getBestEngine() noexcept
+{
+	static const Engine::Enum bestEngine = []() noexcept
+	{
+		if (isEngineSupported(Engine::ArmCrc)) { return Engine::ArmCrc; }
+		if (isEngineSupported(Engine::Pclmul)) { return Engine::Pclmul; }
+		return Engine::SliceBy8;
+	}();
+	return bestEngine;
+}
+
+bool isEngineSupported(const Engine::Enum engine) noexcept
+{
+	return getEngineFunc(engine) != nullptr;
+}
+
+const char * getEngineName(const Engine::Enum engine) noexcept
+{
+	switch (engine)
+	{
+	case Engine::Nibble   : return "nibble";
+	case Engine::SliceBy8 : return "slice-by-8";
+	case Engine::Pclmul   : return "pclmul";
+	case Engine::ArmCrc   : return "arm-crc";
+	default               : return "unknown";
+	} // switch (engine)
+}
+
+uint32_t compute(const Engine::Enum engine, const void * data, const size_t sizeBytes, const uint32_t crc) noexcept
+{
+	assert(data != nullptr || sizeBytes == 0);
+	assert(isEngineSupported(engine));
+
+	const ComputeFunc func = getEngineFunc(engine);
+	return ((func != nullptr) ? func : &computeSliceBy8)(static_cast<const uint8_t *>(data), sizeBytes, crc);
+}
+
+// ========================================================
+// combine():
+// ========================================================
+
+// a * b modulo the CRC polynomial, both in the reflected bit order (x^0 is bit 31).
+static uint32_t multiplyModPoly(uint32_t a, uint32_t b) noexcept
+{
+	uint32_t product = 0;
+	for (uint32_t m = 1u << 31; m != 0 && a != 0; m >>= 1)
+	{
+		if (a & m)
+		{
+			product ^= b;
+			a ^= m;
+		}
+		b = (b & 1) ? ((b >> 1) ^ Polynomial) : (b >> 1);
+	}
+	return product;
+}
+
+uint32_t combine(const uint32_t crcA, const uint32_t crcB, uint64_t sizeBytesB) noexcept
+{
+	// Appending N bytes multiplies the CRC register by x^(8*N). Raise x to that
+	// power by squaring, starting from x^8 (x^1 is 1 << 30 in reflected order).
+	uint32_t xPow = multiplyModPoly(1u << 30, 1u << 30); // x^2
+	xPow = multiplyModPoly(xPow, xPow);                  // x^4
+	xPow = multiplyModPoly(xPow, xPow);                  // x^8
+
+	uint32_t shift = 1u << 31; // x^0
+	while (sizeBytesB != 0)
+	{
+		if (sizeBytesB & 1)
+		{
+			shift = multiplyModPoly(shift, xPow);
+		}
+		xPow = multiplyModPoly(xPow, xPow);
+		sizeBytesB >>= 1;
+	}
+
+	return multiplyModPoly(shift, crcA) ^ crcB;
+}
+
+} // namespace crc32 {}
+
+// ========================================================
+// computeCrc32():
+// ========================================================
+
+uint32_t computeCrc32(const void * data, const size_t sizeBytes, const uint32_t crc) noexcept
+{
+	assert(data != nullptr || sizeBytes == 0);
+
+	static const crc32::ComputeFunc bestFunc = crc32::getEngineFunc(crc32::getBestEngine());
+	return bestFunc(static_cast<const uint8_t *>(data), sizeBytes, crc);
+}
+
+} // namespace utils {}
@@ -0,0 +1,54 @@
+#pragma once
+// ================================================================================================
+// -*- C++ -*-
+// File: crc32.hpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: CRC-32 engines with runtime CPU dispatch.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "utils/common.hpp"
+
+namespace utils
+{
+
+// Implementations of the standard (ZLib/PKZIP) CRC-32 behind utils::computeCrc32().
+// All engines produce the same values, they only differ in speed.
+namespace crc32
+{
+
+struct Engine
+{
+	enum Enum
+	{
+		Nibble,     // 4 bits per table lookup. The original, smallest and slowest routine.
+		SliceBy8,   // 8 bytes per step with eight 256-entry tables. Portable fallback.
+		Pclmul,     // x86 carry-less multiply folding (PCLMULQDQ), 64 bytes per step.
+		ArmCrc,     // ARMv8 CRC32 instructions. Only if the compiler targets them.
+		Count
+	};
+};
+
+// Engine used by utils::computeCrc32(). Picked once from the features of the running CPU.
+Engine::Enum getBestEngine() noexcept;
+
+// Whether the engine can run on this CPU and was compiled in.
+bool isEngineSupported(Engine::Enum engine) noexcept;
+
+// Printable name of the engine, e.g. "slice-by-8".
+const char * getEngineName(Engine::Enum engine) noexcept;
+
+// Same as utils::computeCrc32() but with a specific engine, which must be supported.
+uint32_t compute(Engine::Enum engine, const void * data, size_t sizeBytes, uint32_t crc = 0) noexcept;
+
+// CRC of the concatenation of two blocks, given the CRC of each and the size of the second one.
+// Lets the pieces of a buffer be checksummed independently (e.g. in parallel) and merged after.
+// Runs in O(log(sizeBytesB)) time.
+uint32_t combine(uint32_t crcA, uint32_t crcB, uint64_t sizeBytesB) noexcept;
+
+} // namespace crc32 {}
+} // namespace utils {}
@@ -0,0 +1,323 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: file_io.cpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: Low-level binary file access helpers (positional reads and memory mapped files).
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "utils/file_io.hpp"
+#include <errno.h>
+
+#if defined(WIN32) || defined(WIN64)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else // !WINDOWS
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif // WINDOWS
+
+namespace utils
+{
+
+// ========================================================
+// RandomAccessFile:
+// ========================================================
+
+RandomAccessFile::~RandomAccessFile()
+{
+	close();
+}
+
+#if defined(WIN32) || defined(WIN64)
+
+bool RandomAccessFile::openForReading(const std::string & filename)
+{
+	assert(!filename.empty());
+	close();
+
+	errno = 0;
+	HANDLE hFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+	                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		errno = ENOENT;
+		return false;
+	}
+
+	fileHandle = hFile;
+	return true;
+}
+
+void RandomAccessFile::close() noexcept
+{
+	if (fileHandle != nullptr)
+	{
+		CloseHandle(static_cast<HANDLE>(fileHandle));
+		fileHandle = nullptr;
+	}
+}
+
+bool RandomAccessFile::readAt(uint64_t offset, void * buffer, size_t numBytes, size_t * bytesRead) const
+{
+	assert(buffer != nullptr);
+	assert(isOpen());
+
+	uint8_t * dest = static_cast<uint8_t *>(buffer);
+	size_t totalRead = 0;
+
+	while (totalRead < numBytes)
+	{
+		// The offset is passed per call in the OVERLAPPED structure,
+		// so concurrent reads don't step on each other.
+		OVERLAPPED overlapped = {};
+		overlapped.Offset     = static_cast<DWORD>(offset & 0xFFFFFFFF);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+		const size_t remaining = numBytes - totalRead;
+		const DWORD  toRead    = static_cast<DWORD>(remaining > 0x40000000 ? 0x40000000 : remaining);
+		DWORD        numRead   = 0;
+
+		if (!ReadFile(static_cast<HANDLE>(fileHandle), dest + totalRead, toRead, &numRead, &overlapped) || numRead == 0)
+		{
+			errno = EIO;
+			break;
+		}
+
+		totalRead += numRead;
+		offset    += numRead;
+	}
+
+	if (bytesRead != nullptr)
+	{
+		*bytesRead = totalRead;
+	}
+	return totalRead == numBytes;
+}
+
+bool RandomAccessFile::isOpen() const noexcept
+{
+	return fileHandle != nullptr;
+}
+
+#else // !WINDOWS
+
+bool RandomAccessFile::openForReading(const std::string & filename)
+{
+	assert(!filename.empty());
+	close();
+
+	errno = 0;
+	fileDescriptor = open(filename.c_str(), O_RDONLY);
+	return fileDescriptor >= 0;
+}
+
+void RandomAccessFile::close() noexcept
+{
+	if (fileDescriptor >= 0)
+	{
+		::close(fileDescriptor);
+		fileDescriptor = -1;
+	}
+}
+
+bool RandomAccessFile::readAt(uint64_t offset, void * buffer, size_t numBytes, size_t * bytesRead) const
+{
+	assert(buffer != nullptr);
+	assert(isOpen());
+
+	uint8_t * dest = static_cast<uint8_t *>(buffer);
+	size_t totalRead = 0;
+
+	while (totalRead < numBytes)
+	{
+		const ssize_t result = pread(fileDescriptor, dest + totalRead,
+		                             numBytes - totalRead, static_cast<off_t>(offset));
+		if (result < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+		if (result == 0) // Hit the end of the file.
+		{
+			break;
+		}
+
+		totalRead += static_cast<size_t>(result);
+		offset    += static_cast<uint64_t>(result);
+	}
+
+	if (bytesRead != nullptr)
+	{
+		*bytesRead = totalRead;
+	}
+	return totalRead == numBytes;
+}
+
+bool RandomAccessFile::isOpen() const noexcept
+{
+	return fileDescriptor >= 0;
+}
+
+#endif // WINDOWS
+
+// ========================================================
+// MemoryMappedFile:
+// ========================================================
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+	unmap();
+}
+
+#if defined(WIN32) || defined(WIN64)
+
+bool MemoryMappedFile::mapForReading(const std::string & filename)
+{
+	assert(!filename.empty());
+	unmap();
+
+	errno = 0;
+	HANDLE hFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+	                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		errno = ENOENT;
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(hFile, &fileSize))
+	{
+		CloseHandle(hFile);
+		errno = EIO;
+		return false;
+	}
+
+	// Can't map an empty file, but that is not an error.
+	if (fileSize.QuadPart == 0)
+	{
+		CloseHandle(hFile);
+		mapped = true;
+		return true;
+	}
+
+	HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (hMapping == nullptr)
+	{
+		CloseHandle(hFile);
+		errno = ENOMEM;
+		return false;
+	}
+
+	const void * view = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(hMapping);
+		CloseHandle(hFile);
+		errno = ENOMEM;
+		return false;
+	}
+
+	fileHandle    = hFile;
+	mappingHandle = hMapping;
+	data          = static_cast<const uint8_t *>(view);
+	sizeBytes     = static_cast<size_t>(fileSize.QuadPart);
+	mapped        = true;
+	return true;
+}
+
+void MemoryMappedFile::unmap() noexcept
+{
+	if (data != nullptr)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mappingHandle != nullptr)
+	{
+		CloseHandle(static_cast<HANDLE>(mappingHandle));
+	}
+	if (fileHandle != nullptr)
+	{
+		CloseHandle(static_cast<HANDLE>(fileHandle));
+	}
+
+	fileHandle    = nullptr;
+	mappingHandle = nullptr;
+	data          = nullptr;
+	sizeBytes     = 0;
+	mapped        = false;
+}
+
+#else // !WINDOWS
+
+bool MemoryMappedFile::mapForReading(const std::string & filename)
+{
+	assert(!filename.empty());
+	unmap();
+
+	errno = 0;
+	const int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat statBuf = {};
+	if (fstat(fd, &statBuf) != 0 || !S_ISREG(statBuf.st_mode))
+	{
+		::close(fd);
+		return false;
+	}
+
+	// Can't map an empty file, but that is not an error.
+	if (statBuf.st_size == 0)
+	{
+		::close(fd);
+		mapped = true;
+		return true;
+	}
+
+	const size_t length = static_cast<size_t>(statBuf.st_size);
+	void * view = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+
+	// The mapping keeps its own reference to the file.
+	::close(fd);
+
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+
+	data      = static_cast<const uint8_t *>(view);
+	sizeBytes = length;
+	mapped    = true;
+	return true;
+}
+
+void MemoryMappedFile::unmap() noexcept
+{
+	if (data != nullptr)
+	{
+		munmap(const_cast<uint8_t *>(data), sizeBytes);
+	}
+
+	data      = nullptr;
+	sizeBytes = 0;
+	mapped    = false;
+}
+
+#endif // WINDOWS
+
+} // namespace utils {}
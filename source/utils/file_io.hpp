@@ -0,0 +1,102 @@
+#pragma once
+// ================================================================================================
+// -*- C++ -*-
+// File: file_io.hpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: Low-level binary file access helpers (positional reads and memory mapped files).
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "utils/common.hpp"
+
+namespace utils
+{
+
+// ========================================================
+// RandomAccessFile:
+// ========================================================
+
+//
+// Read-only file handle that only supports positional reads,
+// i.e. pread() on Unix or ReadFile() with an explicit offset on Windows.
+// There is no shared file cursor, so readAt() can be called from
+// any number of threads at the same time on the same instance.
+//
+class RandomAccessFile final
+	: public NonCopyable
+{
+public:
+
+	RandomAccessFile() = default;
+	~RandomAccessFile();
+
+	// Opens an existing file for reading. Any previously open file is closed first.
+	// Returns false on failure. Use filesys::getLastFileError() to get an error description.
+	bool openForReading(const std::string & filename);
+
+	// Closes the file. Safe to call if no file is open.
+	void close() noexcept;
+
+	// Reads exactly `numBytes` starting at the absolute `offset`. Thread safe.
+	// Returns false if the read failed or if it hit the end of the file before
+	// `numBytes` were read, in which case `bytesRead` gets the partial count (if not null).
+	bool readAt(uint64_t offset, void * buffer, size_t numBytes, size_t * bytesRead = nullptr) const;
+
+	// Queries:
+	bool isOpen() const noexcept;
+
+private:
+
+	#if defined(WIN32) || defined(WIN64)
+	void * fileHandle = nullptr;
+	#else // !WINDOWS
+	int fileDescriptor = -1;
+	#endif // WINDOWS
+};
+
+// ========================================================
+// MemoryMappedFile:
+// ========================================================
+
+//
+// Read-only memory mapping of a whole file.
+// Uses mmap() on Unix and a file mapping object on Windows.
+// The mapped bytes stay valid until unmap() is called or the object is destroyed.
+//
+class MemoryMappedFile final
+	: public NonCopyable
+{
+public:
+
+	MemoryMappedFile() = default;
+	~MemoryMappedFile();
+
+	// Maps the whole file for reading. Any previous mapping is released first.
+	// Returns false on failure. Use filesys::getLastFileError() to get an error description.
+	bool mapForReading(const std::string & filename);
+
+	// Releases the mapping. Safe to call if nothing is mapped.
+	void unmap() noexcept;
+
+	// Queries:
+	bool isMapped()           const noexcept { return mapped;    }
+	const uint8_t * getData() const noexcept { return data;      }
+	size_t getSizeBytes()     const noexcept { return sizeBytes; }
+
+private:
+
+	const uint8_t * data      = nullptr;
+	size_t          sizeBytes = 0;
+	bool            mapped    = false;
+
+	#if defined(WIN32) || defined(WIN64)
+	void * fileHandle    = nullptr;
+	void * mappingHandle = nullptr;
+	#endif // WINDOWS
+};
+
+} // namespace utils {}
@@ -17,15 +17,21 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <cctype>
+#include <cstdio>
+#include <algorithm>
+#include <memory>
 
 #if defined(WIN32) || defined(WIN64)
 	#include <direct.h> // _mkdir
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h> // FindFirstFileA
 	// Copied from linux libc sys/stat.h:
 	#define S_ISREG(m) (((m) & S_IFMT) == S_IFREG)
 	#define S_ISDIR(m) (((m) & S_IFMT) == S_IFDIR)
 	#define SIEGE_MAKE_DIR(dirname) _mkdir(dirname)
 #else // !WINDOWS
 	#include <unistd.h>
+	#include <dirent.h>
 	#define SIEGE_MAKE_DIR(dirname) mkdir((dirname), 0777)
 #endif // WINDOWS
 
@@ -96,6 +102,26 @@ bool queryFileSize(const std::string & filename, size_t & sizeInBytes)
 	return false;
 }
 
+// ========================================================
+// queryFileModificationTime():
+// ========================================================
+
+bool queryFileModificationTime(const std::string & filename, std::time_t & modificationTime)
+{
+	assert(!filename.empty());
+
+	errno = 0;
+	struct stat statBuf = {};
+	if (stat(filename.c_str(), &statBuf) == 0 && S_ISREG(statBuf.st_mode))
+	{
+		modificationTime = statBuf.st_mtime;
+		return true;
+	}
+
+	modificationTime = 0;
+	return false;
+}
+
 // ========================================================
 // createDirectory():
 // ========================================================
@@ -117,7 +143,11 @@ bool createDirectory(const std::string & dirPath)
 	{
 		if (SIEGE_MAKE_DIR(dirPath.c_str()) != 0)
 		{
-			return false;
+			// Could have just been created by another thread.
+			if (errno != EEXIST || stat(dirPath.c_str(), &dirStat) != 0 || !S_ISDIR(dirStat.st_mode))
+			{
+				return false;
+			}
 		}
 	}
 	else // Path already exists:
@@ -154,7 +184,8 @@ bool createPath(const std::string & pathEndedWithSeparatorOrFilename)
 	while (*pPath != '\0')
 	{
 		// Works for both Win and Unix without the need for extra tweaks.
-		if (*pPath == '/' || *pPath == '\\')
+		// A separator at the start is the root of an absolute path, which is never created.
+		if ((*pPath == '/' || *pPath == '\\') && pPath != dirPath)
 		{
 			*pPath = '\0';
 			if (!createDirectory(dirPath))
@@ -169,6 +200,282 @@ bool createPath(const std::string & pathEndedWithSeparatorOrFilename)
 	return true;
 }
 
+// ========================================================
+// replaceFile():
+// ========================================================
+
+bool replaceFile(const std::string & tempFile, const std::string & destFile)
+{
+	errno = 0;
+
+	#if defined(WIN32) || defined(WIN64)
+	std::remove(destFile.c_str()); // rename() doesn't replace existing files on Windows.
+	#endif // WINDOWS
+
+	if (std::rename(tempFile.c_str(), destFile.c_str()) != 0)
+	{
+		const int renameError = errno;
+		std::remove(tempFile.c_str());
+		errno = renameError;
+		return false;
+	}
+	return true;
+}
+
+// ========================================================
+// DirectoryCache:
+// ========================================================
+
+bool DirectoryCache::createPath(const std::string & pathEndedWithSeparatorOrFilename)
+{
+	const std::string & path = pathEndedWithSeparatorOrFilename;
+	assert(!path.empty());
+
+	const size_t lastSeparator = path.find_last_of("/\\");
+	if (lastSeparator == std::string::npos || lastSeparator == 0)
+	{
+		return true; // No directories, or just the root.
+	}
+
+	// Usual case, all the files of a directory after the first one.
+	if (isCreated(path.substr(0, lastSeparator)))
+	{
+		return true;
+	}
+
+	// Check each directory of the path from the top, so only the missing ones
+	// are created. Directories are created without holding the lock, since two
+	// threads racing to create the same one is not an error (see createDirectory()).
+	std::string dirPath;
+	for (size_t separator = path.find_first_of("/\\", 1); separator <= lastSeparator;
+	     separator = path.find_first_of("/\\", separator + 1))
+	{
+		dirPath.assign(path, 0, separator);
+		if (isCreated(dirPath))
+		{
+			continue;
+		}
+
+		if (!createDirectory(dirPath))
+		{
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		createdDirs.insert(dirPath);
+	}
+
+	return true;
+}
+
+bool DirectoryCache::isCreated(const std::string & dirPath) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return createdDirs.find(dirPath) != createdDirs.end();
+}
+
+size_t DirectoryCache::getDirectoryCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return createdDirs.size();
+}
+
+void DirectoryCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	createdDirs.clear();
+}
+
+// ========================================================
+// matchGlob():
+// ========================================================
+
+namespace
+{
+
+// Walks the pattern once, keeping the set of path positions the pattern so far can end at
+// ('ends[i]' is true if it matched the first i chars of the path). O(pattern * path), unlike
+// trying every length of each star, which is exponential on patterns with many of them.
+bool matchGlobRange(const char * pattern, const char * const patternEnd, const char * const path,
+                    const size_t pathLength, const char separator, bool * const ends) noexcept
+{
+	std::fill_n(ends, pathLength + 1, false);
+	ends[0] = true;
+
+	while (pattern != patternEnd)
+	{
+		if (*pattern == '*')
+		{
+			const bool anyDepth = (pattern + 1 != patternEnd && pattern[1] == '*');
+			pattern += anyDepth ? 2 : 1;
+
+			// "**/" is a run of whole directories, possibly none.
+			if (anyDepth && pattern != patternEnd && *pattern == separator)
+			{
+				bool reached = false;
+				for (size_t i = 0; i <= pathLength; ++i)
+				{
+					const bool endedHere = ends[i];
+					ends[i] = endedHere || (reached && path[i - 1] == separator);
+					reached = reached || endedHere;
+				}
+				++pattern;
+				continue;
+			}
+
+			// A star can extend each match up to the next separator, or to the end with '**'.
+			bool reached = false;
+			for (size_t i = 0; i <= pathLength; ++i)
+			{
+				reached = reached || ends[i];
+				ends[i] = reached;
+				if (!anyDepth && i != pathLength && path[i] == separator)
+				{
+					reached = false;
+				}
+			}
+			continue;
+		}
+
+		// Any other char takes one char of the path, in place, so back to front.
+		bool anyMatch = false;
+		for (size_t i = pathLength; i != 0; --i)
+		{
+			const char c = path[i - 1];
+			ends[i] = ends[i - 1] && (*pattern == '?' ? (c != separator) : (*pattern == c));
+			anyMatch = anyMatch || ends[i];
+		}
+		ends[0] = false;
+
+		if (!anyMatch)
+		{
+			return false;
+		}
+		++pattern;
+	}
+	return ends[pathLength];
+}
+
+} // namespace {}
+
+bool matchGlob(const StringView pattern, const StringView path) noexcept
+{
+	// Room for most paths without an allocation. Longer ones go to the heap.
+	bool localEnds[512];
+	std::unique_ptr<bool[]> heapEnds;
+
+	const size_t pathLength = static_cast<size_t>(path.end() - path.begin());
+	bool * ends = localEnds;
+	if (pathLength >= sizeof(localEnds))
+	{
+		heapEnds.reset(new bool[pathLength + 1]);
+		ends = heapEnds.get();
+	}
+
+	return matchGlobRange(pattern.begin(), pattern.end(), path.begin(), pathLength, *getPathSeparator(), ends);
+}
+
+size_t getGlobLiteralPrefixLength(const StringView pattern) noexcept
+{
+	const char * const wildcard = std::find_if(pattern.begin(), pattern.end(),
+			[](const char c) { return c == '*' || c == '?'; });
+	return static_cast<size_t>(wildcard - pattern.begin());
+}
+
+// ========================================================
+// listFiles():
+// ========================================================
+
+#if defined(WIN32) || defined(WIN64)
+
+bool listFiles(const std::string & dirPath, std::vector<std::string> & filesOut, const bool recursive)
+{
+	assert(!dirPath.empty());
+
+	errno = 0;
+	WIN32_FIND_DATAA findData;
+	HANDLE hFind = FindFirstFileA((dirPath + "\\*").c_str(), &findData);
+	if (hFind == INVALID_HANDLE_VALUE)
+	{
+		errno = ENOENT;
+		return false;
+	}
+
+	do
+	{
+		const std::string name = findData.cFileName;
+		if (name == "." || name == "..")
+		{
+			continue;
+		}
+
+		const std::string fullPath = dirPath + getPathSeparator() + name;
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			if (recursive)
+			{
+				listFiles(fullPath, filesOut, true);
+			}
+		}
+		else
+		{
+			filesOut.push_back(fullPath);
+		}
+	} while (FindNextFileA(hFind, &findData));
+
+	FindClose(hFind);
+	return true;
+}
+
+#else // !WINDOWS
+
+bool listFiles(const std::string & dirPath, std::vector<std::string> & filesOut, const bool recursive)
+{
+	assert(!dirPath.empty());
+
+	errno = 0;
+	DIR * dir = opendir(dirPath.c_str());
+	if (dir == nullptr)
+	{
+		return false;
+	}
+
+	while (const struct dirent * entry = readdir(dir))
+	{
+		const std::string name = entry->d_name;
+		if (name == "." || name == "..")
+		{
+			continue;
+		}
+
+		// d_type is not filled in by every file system, so stat() to be sure.
+		const std::string fullPath = dirPath + getPathSeparator() + name;
+		struct stat statBuf = {};
+		if (stat(fullPath.c_str(), &statBuf) != 0)
+		{
+			continue;
+		}
+
+		if (S_ISDIR(statBuf.st_mode))
+		{
+			if (recursive)
+			{
+				listFiles(fullPath, filesOut, true);
+			}
+		}
+		else if (S_ISREG(statBuf.st_mode))
+		{
+			filesOut.push_back(fullPath);
+		}
+	}
+
+	closedir(dir);
+	errno = 0;
+	return true;
+}
+
+#endif // WINDOWS
+
 // ========================================================
 // tryOpen() for ofstream and ifstream:
 // ========================================================
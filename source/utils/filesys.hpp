@@ -12,7 +12,12 @@
 // ================================================================================================
 
 #include "utils/common.hpp"
+#include "utils/string_view.hpp"
+#include <ctime>
 #include <fstream>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
 
 namespace utils
 {
@@ -32,12 +37,63 @@ std::string getFilenameExtension(const std::string & filename, bool includeDot =
 // Tries to get the size in bytes of a file, if `filename` exits and is a file.
 bool queryFileSize(const std::string & filename, size_t & sizeInBytes);
 
+// Tries to get the last modification time of a file, if `filename` exists and is a file.
+bool queryFileModificationTime(const std::string & filename, std::time_t & modificationTime);
+
 // Creates a single directory at an existing path. Fails with no side-effects if the dir already exists.
 bool createDirectory(const std::string & dirPath);
 
 // Creates a full path of directories. Fails with no side-effects if path already exists.
 bool createPath(const std::string & pathEndedWithSeparatorOrFilename);
 
+// Renames `tempFile` to `destFile`, replacing it if it exists, for files written to a temporary name first.
+// The replace is atomic on POSIX, so `destFile` is either the old or the new file, even after a crash. On
+// Windows the old file is deleted first. If the rename fails, `tempFile` is deleted and false is returned.
+bool replaceFile(const std::string & tempFile, const std::string & destFile);
+
+//
+// Thread safe record of the directories created so far, for writing many files
+// under the same tree. Its createPath() only touches the file system for the
+// directories it hasn't created yet, where the plain createPath() does a stat()
+// (plus a mkdir() if missing) on every directory of the path, every time.
+// Directories removed by someone else after being created are not noticed.
+//
+class DirectoryCache final
+	: public NonCopyable
+{
+public:
+
+	// Same as filesys::createPath().
+	bool createPath(const std::string & pathEndedWithSeparatorOrFilename);
+
+	// Whether the directory was created (or found) by this cache. No trailing separator.
+	bool isCreated(const std::string & dirPath) const;
+
+	// Number of directories created or found so far.
+	size_t getDirectoryCount() const;
+
+	// Forgets all the directories.
+	void clear();
+
+private:
+
+	mutable std::mutex              mutex;
+	std::unordered_set<std::string> createdDirs;
+};
+
+// Matches a path against a glob pattern. '?' matches any one character and '*' any run of characters,
+// neither crossing a path separator. '**' also matches across separators, and "**/" matches zero or more
+// whole directories, so "/art/**/*.raw" matches both "/art/a.raw" and "/art/maps/b.raw". Case sensitive.
+bool matchGlob(StringView pattern, StringView path) noexcept;
+
+// Length of the part of a glob pattern before the first wildcard. Every path it
+// matches starts with that, so it can be used to narrow down the candidates.
+size_t getGlobLiteralPrefixLength(StringView pattern) noexcept;
+
+// Appends to `filesOut` the paths (`dirPath` + separator + name) of all regular files in a directory,
+// optionally descending into subdirectories. Order is unspecified. Returns false if `dirPath` can't be read.
+bool listFiles(const std::string & dirPath, std::vector<std::string> & filesOut, bool recursive = false);
+
 // Attempts to open the file as a C++ stream, without throwing an exception if it fails.
 // This will clear `errno` before attempting to open the file, so you can getLastFileError()
 // if this function fails to get an error description string for debug printing.
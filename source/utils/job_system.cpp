@@ -0,0 +1,380 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: job_system.cpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: Small work-stealing thread pool and related synchronization helpers.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "utils/job_system.hpp"
+#include <chrono>
+
+namespace utils
+{
+
+namespace
+{
+
+// Index of the worker running on this thread and the system it belongs to.
+// Not a worker thread if `tlsJobSystem` is null.
+thread_local const JobSystem * tlsJobSystem   = nullptr;
+thread_local unsigned int      tlsWorkerIndex = 0;
+
+} // namespace {}
+
+// ========================================================
+// JobSystem:
+// ========================================================
+
+JobSystem::JobSystem(unsigned int numWorkers)
+	: pendingJobs(0)
+	, nextQueue(0)
+	, stopping(false)
+{
+	if (numWorkers == 0)
+	{
+		numWorkers = std::thread::hardware_concurrency();
+		if (numWorkers == 0) // Unknown.
+		{
+			numWorkers = 4;
+		}
+	}
+
+	queues.reserve(numWorkers);
+	for (unsigned int i = 0; i < numWorkers; ++i)
+	{
+		queues.emplace_back(new WorkQueue());
+	}
+
+	workers.reserve(numWorkers);
+	for (unsigned int i = 0; i < numWorkers; ++i)
+	{
+		workers.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wakeCondition.notify_all();
+
+	for (auto & worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void JobSystem::submit(Job job)
+{
+	assert(job != nullptr);
+
+	const unsigned int queueIndex = (tlsJobSystem == this) ? tlsWorkerIndex :
+			(nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size());
+
+	{
+		std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+		queues[queueIndex]->jobs.push_back(std::move(job));
+	}
+
+	// Take the sleep lock so a worker about to sleep can't miss the wake up.
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		pendingJobs.fetch_add(1, std::memory_order_release);
+	}
+	wakeCondition.notify_one();
+}
+
+bool JobSystem::runPendingJob()
+{
+	Job job;
+	const unsigned int myIndex = (tlsJobSystem == this) ? tlsWorkerIndex :
+			(nextQueue.load(std::memory_order_relaxed) % queues.size());
+
+	if (tryPopOwn(myIndex, job) || trySteal(myIndex, job))
+	{
+		job();
+		return true;
+	}
+	return false;
+}
+
+JobSystem & JobSystem::getDefault()
+{
+	static JobSystem defaultJobSystem;
+	return defaultJobSystem;
+}
+
+void JobSystem::workerLoop(const unsigned int workerIndex)
+{
+	tlsJobSystem   = this;
+	tlsWorkerIndex = workerIndex;
+
+	for (;;)
+	{
+		Job job;
+		if (tryPopOwn(workerIndex, job) || trySteal(workerIndex, job))
+		{
+			job();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wakeCondition.wait(lock, [this]() {
+			return pendingJobs.load(std::memory_order_acquire) != 0 || stopping;
+		});
+
+		if (stopping && pendingJobs.load(std::memory_order_acquire) == 0)
+		{
+			break;
+		}
+	}
+
+	tlsJobSystem = nullptr;
+}
+
+bool JobSystem::tryPopOwn(const unsigned int queueIndex, Job & job)
+{
+	WorkQueue & queue = *queues[queueIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+
+	if (queue.jobs.empty())
+	{
+		return false;
+	}
+
+	job = std::move(queue.jobs.back());
+	queue.jobs.pop_back();
+	pendingJobs.fetch_sub(1, std::memory_order_relaxed);
+	return true;
+}
+
+bool JobSystem::trySteal(const unsigned int thiefIndex, Job & job)
+{
+	const auto numQueues = static_cast<unsigned int>(queues.size());
+	for (unsigned int i = 1; i < numQueues; ++i)
+	{
+		WorkQueue & victim = *queues[(thiefIndex + i) % numQueues];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+
+		if (!victim.jobs.empty())
+		{
+			job = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+			pendingJobs.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+// ========================================================
+// JobGroup:
+// ========================================================
+
+JobGroup::JobGroup(JobSystem & jobSystem)
+	: jobs(jobSystem)
+	, outstanding(0)
+{
+}
+
+JobGroup::~JobGroup()
+{
+	waitNoThrow();
+}
+
+void JobGroup::run(JobSystem::Job job)
+{
+	outstanding.fetch_add(1, std::memory_order_relaxed);
+
+	jobs.submit([this, job]()
+	{
+		try
+		{
+			job();
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (firstError == nullptr)
+			{
+				firstError = std::current_exception();
+			}
+		}
+
+		// Notify under the lock so the group can't be destroyed
+		// by the waiter before we're done touching it.
+		std::lock_guard<std::mutex> lock(mutex);
+		if (outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			doneCondition.notify_all();
+		}
+	});
+}
+
+void JobGroup::wait()
+{
+	waitNoThrow();
+
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::swap(error, firstError);
+	}
+	if (error != nullptr)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+void JobGroup::waitNoThrow()
+{
+	while (outstanding.load(std::memory_order_acquire) != 0)
+	{
+		// Help out instead of just blocking. This is what makes
+		// waiting on a group from inside a job deadlock free.
+		if (jobs.runPendingJob())
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCondition.wait_for(lock, std::chrono::milliseconds(1), [this]() {
+			return outstanding.load(std::memory_order_acquire) == 0;
+		});
+	}
+
+	// Sync with the last job releasing the lock.
+	std::lock_guard<std::mutex> lock(mutex);
+}
+
+// ========================================================
+// ByteBudget:
+// ========================================================
+
+ByteBudget::ByteBudget(const uint64_t maxBytes)
+	: maxBytesInFlight(maxBytes)
+	, bytesInFlight(0)
+	, peakBytesInFlight(0)
+	, cancelled(false)
+{
+}
+
+bool ByteBudget::acquire(const uint64_t numBytes)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	if (maxBytesInFlight != 0)
+	{
+		releasedCondition.wait(lock, [this, numBytes]() {
+			return cancelled || bytesInFlight == 0 || (bytesInFlight + numBytes) <= maxBytesInFlight;
+		});
+	}
+	if (cancelled)
+	{
+		return false;
+	}
+
+	bytesInFlight += numBytes;
+	if (bytesInFlight > peakBytesInFlight)
+	{
+		peakBytesInFlight = bytesInFlight;
+	}
+	return true;
+}
+
+void ByteBudget::release(const uint64_t numBytes)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		assert(numBytes <= bytesInFlight);
+		bytesInFlight -= numBytes;
+	}
+	releasedCondition.notify_all();
+}
+
+void ByteBudget::cancel()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		cancelled = true;
+	}
+	releasedCondition.notify_all();
+}
+
+uint64_t ByteBudget::getBytesInFlight() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return bytesInFlight;
+}
+
+uint64_t ByteBudget::getPeakBytesInFlight() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return peakBytesInFlight;
+}
+
+// ========================================================
+// BufferPool:
+// ========================================================
+
+BufferPool::BufferPool(const unsigned int maxBuffers)
+	: maxPooledBuffers(maxBuffers)
+{
+}
+
+BufferPool::Buffer BufferPool::acquire(const size_t sizeBytes)
+{
+	Buffer buffer;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		// Best fit, or else the biggest one, which will need to grow the least.
+		size_t best = freeBuffers.size();
+		for (size_t i = 0; i < freeBuffers.size(); ++i)
+		{
+			const size_t capacity = freeBuffers[i].capacity();
+			if (best == freeBuffers.size())
+			{
+				best = i;
+				continue;
+			}
+
+			const size_t bestCapacity = freeBuffers[best].capacity();
+			const bool fits     = capacity >= sizeBytes;
+			const bool bestFits = bestCapacity >= sizeBytes;
+			if ((fits && (!bestFits || capacity < bestCapacity)) || (!fits && !bestFits && capacity > bestCapacity))
+			{
+				best = i;
+			}
+		}
+
+		if (best != freeBuffers.size())
+		{
+			std::swap(freeBuffers[best], freeBuffers.back());
+			buffer = std::move(freeBuffers.back());
+			freeBuffers.pop_back();
+		}
+	}
+
+	buffer.resize(sizeBytes);
+	return buffer;
+}
+
+void BufferPool::release(Buffer && buffer)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (freeBuffers.size() < maxPooledBuffers)
+	{
+		freeBuffers.push_back(std::move(buffer));
+	}
+}
+
+} // namespace utils {}
@@ -0,0 +1,324 @@
+#pragma once
+// ================================================================================================
+// -*- C++ -*-
+// File: job_system.hpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: Small work-stealing thread pool and related synchronization helpers.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "utils/common.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace utils
+{
+
+// ========================================================
+// JobSystem:
+// ========================================================
+
+//
+// Fixed-size pool of worker threads. Each worker has its own job queue.
+// Workers take jobs from the back of their own queue (LIFO, cache friendly)
+// and steal from the front of the other queues (FIFO) when they run out.
+// Jobs submitted from a worker thread go into that worker's queue, jobs
+// submitted from any other thread are spread round-robin across the queues.
+//
+// Jobs must not throw. Use JobGroup to run jobs that can fail and to wait on them.
+//
+class JobSystem final
+	: public NonCopyable
+{
+public:
+
+	using Job = std::function<void()>;
+
+	// Spawns `numWorkers` threads. Zero selects std::thread::hardware_concurrency().
+	explicit JobSystem(unsigned int numWorkers = 0);
+
+	// Finishes all pending jobs then joins the workers.
+	~JobSystem();
+
+	// Queues a job for execution on one of the workers. Thread safe.
+	void submit(Job job);
+
+	// Runs one pending job on the calling thread, if any can be found.
+	// Returns false if all queues were empty. Used by waiting threads to help out.
+	bool runPendingJob();
+
+	// Number of worker threads in the pool.
+	unsigned int getWorkerCount() const noexcept { return static_cast<unsigned int>(workers.size()); }
+
+	// Shared instance sized to the hardware thread count. Created on first use.
+	static JobSystem & getDefault();
+
+private:
+
+	struct WorkQueue
+	{
+		std::mutex      mutex;
+		std::deque<Job> jobs;
+	};
+
+	void workerLoop(unsigned int workerIndex);
+	bool tryPopOwn(unsigned int queueIndex, Job & job);
+	bool trySteal(unsigned int thiefIndex, Job & job);
+
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread>                workers;
+
+	std::mutex                sleepMutex;
+	std::condition_variable   wakeCondition;
+	std::atomic<unsigned int> pendingJobs;
+	std::atomic<unsigned int> nextQueue;
+	bool                      stopping;
+};
+
+// ========================================================
+// JobGroup:
+// ========================================================
+
+//
+// Tracks a batch of jobs submitted to a JobSystem so they can be waited on.
+// Exceptions thrown by the jobs are caught, the first one is rethrown by wait().
+// While waiting, the calling thread runs pending jobs from the JobSystem,
+// so it is fine to wait on a group from inside another job.
+//
+class JobGroup final
+	: public NonCopyable
+{
+public:
+
+	explicit JobGroup(JobSystem & jobSystem);
+
+	// Waits for any outstanding jobs, but never throws.
+	~JobGroup();
+
+	// Submits a job that is part of this group.
+	void run(JobSystem::Job job);
+
+	// Blocks until all jobs in the group have finished.
+	// Rethrows the first exception raised by a job, if any.
+	void wait();
+
+private:
+
+	void waitNoThrow();
+
+	JobSystem &               jobs;
+	std::atomic<unsigned int> outstanding;
+	std::mutex                mutex;
+	std::condition_variable   doneCondition;
+	std::exception_ptr        firstError;
+};
+
+// ========================================================
+// ByteBudget:
+// ========================================================
+
+//
+// Counting limiter for the number of bytes held by producer/consumer stages.
+// acquire() blocks while the bytes in flight plus the request would go
+// over the limit. A request larger than the whole limit is still let
+// through once nothing else is in flight, so it can never deadlock.
+// cancel() wakes up the waiting threads and makes acquire() fail from
+// then on, for producers that have to be stopped.
+//
+class ByteBudget final
+	: public NonCopyable
+{
+public:
+
+	// Zero means no limit (acquire() never blocks).
+	explicit ByteBudget(uint64_t maxBytes = 0);
+
+	// Returns false, taking nothing, if the budget was cancelled.
+	bool acquire(uint64_t numBytes);
+	void release(uint64_t numBytes);
+	void cancel();
+
+	uint64_t getMaxBytes() const noexcept { return maxBytesInFlight; }
+	uint64_t getBytesInFlight() const;
+	uint64_t getPeakBytesInFlight() const;
+
+private:
+
+	const uint64_t          maxBytesInFlight;
+	uint64_t                bytesInFlight;
+	uint64_t                peakBytesInFlight;
+	bool                    cancelled;
+	mutable std::mutex      mutex;
+	std::condition_variable releasedCondition;
+};
+
+// ========================================================
+// BufferPool:
+// ========================================================
+
+//
+// std::allocator that default-initializes the elements a container makes without a value,
+// which for plain types like bytes means leaving them uninitialized. A std::vector with it
+// doesn't zero-fill the new elements of resize(), for buffers that are about to be overwritten.
+//
+template<typename T>
+class DefaultInitAllocator
+	: public std::allocator<T>
+{
+public:
+
+	template<typename U>
+	struct rebind { using other = DefaultInitAllocator<U>; };
+
+	DefaultInitAllocator() = default;
+
+	template<typename U>
+	DefaultInitAllocator(const DefaultInitAllocator<U> &) noexcept { }
+
+	template<typename U>
+	void construct(U * ptr) noexcept(std::is_nothrow_default_constructible<U>::value)
+	{
+		::new(static_cast<void *>(ptr)) U;
+	}
+
+	template<typename U, typename... Args>
+	void construct(U * ptr, Args &&... args)
+	{
+		::new(static_cast<void *>(ptr)) U(std::forward<Args>(args)...);
+	}
+};
+
+//
+// Thread safe free list of byte buffers. Recycling the buffers of a
+// producer/consumer loop saves a heap allocation and the page faults
+// of fresh memory per item. The buffers never zero-fill what they grow
+// by, recycled or not, since their contents are overwritten anyway.
+//
+class BufferPool final
+	: public NonCopyable
+{
+public:
+
+	using Buffer = std::vector<uint8_t, DefaultInitAllocator<uint8_t>>;
+
+	// At most `maxBuffers` are kept for reuse, extra ones released are freed.
+	explicit BufferPool(unsigned int maxBuffers = 16);
+
+	// Returns a buffer with exactly `sizeBytes` of size. Reuses the smallest pooled
+	// buffer with enough capacity if there's one. Contents are undefined, not zeroed.
+	Buffer acquire(size_t sizeBytes);
+
+	// Gives a buffer back to the pool.
+	void release(Buffer && buffer);
+
+private:
+
+	const unsigned int  maxPooledBuffers;
+	std::mutex          mutex;
+	std::vector<Buffer> freeBuffers;
+};
+
+// ========================================================
+// BoundedQueue:
+// ========================================================
+
+//
+// Blocking FIFO with a fixed capacity, for handing items between the
+// threads of a pipeline. push() waits while the queue is full and pop()
+// while it is empty, so a slow consumer stalls its producers instead of
+// letting the items pile up. Once closed, push() refuses new items and
+// pop() returns false after the remaining ones are taken. Cancelling it
+// also drops the remaining items, so the consumers stop right away.
+//
+template<typename T>
+class BoundedQueue final
+	: public NonCopyable
+{
+public:
+
+	// A capacity of zero is taken as one.
+	explicit BoundedQueue(const size_t capacity)
+		: maxItems(capacity != 0 ? capacity : 1)
+		, closed(false)
+	{
+	}
+
+	// Returns false, dropping the item, if the queue was closed.
+	bool push(T item)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		notFullCondition.wait(lock, [this]() { return closed || items.size() < maxItems; });
+		if (closed)
+		{
+			return false;
+		}
+		items.push_back(std::move(item));
+		lock.unlock();
+		notEmptyCondition.notify_one();
+		return true;
+	}
+
+	// Returns false once the queue is closed and empty.
+	bool pop(T & item)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		notEmptyCondition.wait(lock, [this]() { return closed || !items.empty(); });
+		if (items.empty())
+		{
+			return false;
+		}
+		item = std::move(items.front());
+		items.pop_front();
+		lock.unlock();
+		notFullCondition.notify_one();
+		return true;
+	}
+
+	// Wakes up all waiting threads. Called by the last producer when it is done.
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+		}
+		notFullCondition.notify_all();
+		notEmptyCondition.notify_all();
+	}
+
+	// Closes the queue and drops the items still in it.
+	void cancel()
+	{
+		std::deque<T> droppedItems;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+			droppedItems.swap(items);
+		}
+		notFullCondition.notify_all();
+		notEmptyCondition.notify_all();
+	}
+
+	size_t getCapacity() const noexcept { return maxItems; }
+
+private:
+
+	const size_t            maxItems;
+	bool                    closed;
+	std::deque<T>           items;
+	std::mutex              mutex;
+	std::condition_variable notFullCondition;
+	std::condition_variable notEmptyCondition;
+};
+
+} // namespace utils {}
@@ -0,0 +1,123 @@
+#pragma once
+// ================================================================================================
+// -*- C++ -*-
+// File: string_view.hpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: Non-owning reference to a range of characters.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "utils/common.hpp"
+#include <algorithm>
+
+namespace utils
+{
+
+// ========================================================
+// StringView:
+// ========================================================
+
+//
+// Pointer + length pair referencing characters owned by someone else.
+// Not necessarily null terminated. Meant to hand out strings stored in
+// bulk (e.g. a string arena) without copying each one into a std::string.
+//
+class StringView final
+{
+public:
+
+	static constexpr size_t npos = ~size_t(0);
+
+	StringView() noexcept
+		: chars("")
+		, numChars(0)
+	{ }
+
+	StringView(const char * str)
+		: chars(str)
+		, numChars(std::strlen(str))
+	{ }
+
+	StringView(const char * str, const size_t len) noexcept
+		: chars(str)
+		, numChars(len)
+	{ }
+
+	StringView(const std::string & str) noexcept
+		: chars(str.data())
+		, numChars(str.length())
+	{ }
+
+	const char * data()  const noexcept { return chars; }
+	size_t       size()  const noexcept { return numChars; }
+	bool         empty() const noexcept { return numChars == 0; }
+
+	const char * begin() const noexcept { return chars; }
+	const char * end()   const noexcept { return chars + numChars; }
+
+	char operator[](const size_t index) const
+	{
+		assert(index < numChars);
+		return chars[index];
+	}
+
+	std::string toString() const { return std::string(chars, numChars); }
+
+	StringView substr(const size_t pos, const size_t count = npos) const
+	{
+		assert(pos <= numChars);
+		return StringView(chars + pos, std::min(count, numChars - pos));
+	}
+
+	bool startsWith(const StringView prefix) const noexcept
+	{
+		return prefix.numChars <= numChars && std::memcmp(chars, prefix.chars, prefix.numChars) == 0;
+	}
+
+	bool endsWith(const StringView suffix) const noexcept
+	{
+		return suffix.numChars <= numChars && std::memcmp(chars + numChars - suffix.numChars, suffix.chars, suffix.numChars) == 0;
+	}
+
+	// Lexicographical comparison, same ordering as std::string::compare().
+	int compare(const StringView other) const noexcept
+	{
+		const int result = std::memcmp(chars, other.chars, std::min(numChars, other.numChars));
+		if (result != 0)
+		{
+			return result;
+		}
+		return (numChars < other.numChars) ? -1 : (numChars > other.numChars) ? 1 : 0;
+	}
+
+private:
+
+	const char * chars;
+	size_t       numChars;
+};
+
+inline bool operator == (const StringView a, const StringView b) noexcept
+{
+	return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+inline bool operator != (const StringView a, const StringView b) noexcept
+{
+	return !(a == b);
+}
+
+inline bool operator < (const StringView a, const StringView b) noexcept
+{
+	return a.compare(b) < 0;
+}
+
+inline std::ostream & operator << (std::ostream & s, const StringView str)
+{
+	return s.write(str.data(), str.size());
+}
+
+} // namespace utils {}
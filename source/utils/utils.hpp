@@ -13,6 +13,11 @@
 
 #include "utils/common.hpp"
 #include "utils/vectors.hpp"
+#include "utils/string_view.hpp"
 #include "utils/filesys.hpp"
+#include "utils/file_io.hpp"
+#include "utils/job_system.hpp"
 #include "utils/compression.hpp"
+#include "utils/zip_writer.hpp"
+#include "utils/crc32.hpp"
 #include "utils/simple_cmdline_parser.hpp"
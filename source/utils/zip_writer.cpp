@@ -0,0 +1,297 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: zip_writer.cpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: Minimal sequential writer of ZIP archives.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "utils/zip_writer.hpp"
+#include "utils/filesys.hpp"
+#include <cerrno>
+
+namespace utils
+{
+namespace
+{
+
+// Record signatures and field values from the PKWARE APPNOTE.
+constexpr uint32_t LocalHeaderSignature      = 0x04034B50;
+constexpr uint32_t CentralHeaderSignature    = 0x02014B50;
+constexpr uint32_t EndOfCentralDirSignature  = 0x06054B50;
+constexpr uint32_t Zip64EndOfCentralDirSig   = 0x06064B50;
+constexpr uint32_t Zip64EndLocatorSignature  = 0x07064B50;
+constexpr uint16_t Zip64ExtraFieldId         = 0x0001;
+constexpr uint16_t VersionStoredOrDeflated   = 20; // 2.0
+constexpr uint16_t VersionZip64              = 45; // 4.5
+constexpr uint32_t DosDirectoryAttribute     = 0x10;
+constexpr uint32_t Max16                     = 0xFFFF;
+constexpr uint32_t Max32                     = 0xFFFFFFFF;
+
+// Little-endian fields of a header being built.
+class RecordBuilder final
+{
+public:
+
+	void put16(const uint32_t value)
+	{
+		bytes.push_back(static_cast<uint8_t>(value));
+		bytes.push_back(static_cast<uint8_t>(value >> 8));
+	}
+
+	void put32(const uint32_t value)
+	{
+		put16(value & 0xFFFF);
+		put16(value >> 16);
+	}
+
+	void put64(const uint64_t value)
+	{
+		put32(static_cast<uint32_t>(value));
+		put32(static_cast<uint32_t>(value >> 32));
+	}
+
+	void putString(const std::string & str)
+	{
+		bytes.insert(std::end(bytes), std::begin(str), std::end(str));
+	}
+
+	std::vector<uint8_t> bytes;
+};
+
+// MS-DOS time and date of the entries, in local time like other ZIP tools.
+// DOS dates start in 1980 and count seconds in steps of two.
+void makeDosTime(const std::time_t t, uint16_t & dosTime, uint16_t & dosDate)
+{
+	std::tm local = {};
+	#ifdef _MSC_VER
+	localtime_s(&local, &t);
+	#else // _MSC_VER
+	localtime_r(&t, &local);
+	#endif // _MSC_VER
+
+	if (local.tm_year < 80)
+	{
+		dosTime = 0;
+		dosDate = (1 << 5) | 1; // 1980-01-01
+		return;
+	}
+
+	dosTime = static_cast<uint16_t>((local.tm_hour << 11) | (local.tm_min << 5) | (local.tm_sec / 2));
+	dosDate = static_cast<uint16_t>(((local.tm_year - 80) << 9) | ((local.tm_mon + 1) << 5) | local.tm_mday);
+}
+
+} // namespace {}
+
+// ========================================================
+// ZipWriter:
+// ========================================================
+
+bool ZipWriter::open(const std::string & filename)
+{
+	if (file.is_open())
+	{
+		file.close();
+	}
+
+	entries.clear();
+	offset = 0;
+	failed = false;
+
+	return filesys::tryOpen(file, filename, std::ofstream::binary | std::ofstream::trunc);
+}
+
+bool ZipWriter::addFile(const std::string & name, const Method method, const uint8_t * data, const size_t dataSizeBytes,
+                        const uint32_t crc32, const uint64_t uncompressedSize, const std::time_t modificationTime)
+{
+	if (dataSizeBytes >= Max32 || uncompressedSize >= Max32)
+	{
+		errno = EFBIG;
+		return false;
+	}
+
+	Entry entry;
+	entry.name               = name;
+	entry.method             = static_cast<uint16_t>(method);
+	entry.crc32              = crc32;
+	entry.compressedSize     = static_cast<uint32_t>(dataSizeBytes);
+	entry.uncompressedSize   = static_cast<uint32_t>(uncompressedSize);
+	entry.externalAttributes = 0;
+	return addEntry(std::move(entry), data, dataSizeBytes, modificationTime);
+}
+
+bool ZipWriter::addDirectory(const std::string & name, const std::time_t modificationTime)
+{
+	Entry entry;
+	entry.name               = (!name.empty() && name.back() == '/') ? name : (name + '/');
+	entry.method             = static_cast<uint16_t>(Method::Stored);
+	entry.crc32              = 0;
+	entry.compressedSize     = 0;
+	entry.uncompressedSize   = 0;
+	entry.externalAttributes = DosDirectoryAttribute;
+	return addEntry(std::move(entry), nullptr, 0, modificationTime);
+}
+
+bool ZipWriter::addEntry(Entry entry, const uint8_t * data, const size_t dataSizeBytes, const std::time_t modificationTime)
+{
+	assert(file.is_open());
+	assert(data != nullptr || dataSizeBytes == 0);
+
+	if (failed || entry.name.empty() || entry.name.length() > Max16)
+	{
+		return false;
+	}
+
+	makeDosTime(modificationTime, entry.dosTime, entry.dosDate);
+	entry.localHeaderOffset = offset;
+
+	// The sizes are known up front, so they go right in the local
+	// header and there's no need for a data descriptor after the data.
+	RecordBuilder header;
+	header.put32(LocalHeaderSignature);
+	header.put16(VersionStoredOrDeflated);
+	header.put16(0); // Flags
+	header.put16(entry.method);
+	header.put16(entry.dosTime);
+	header.put16(entry.dosDate);
+	header.put32(entry.crc32);
+	header.put32(entry.compressedSize);
+	header.put32(entry.uncompressedSize);
+	header.put16(static_cast<uint32_t>(entry.name.length()));
+	header.put16(0); // Extra field length
+	header.putString(entry.name);
+
+	if (!writeBytes(header.bytes.data(), header.bytes.size()) || !writeBytes(data, dataSizeBytes))
+	{
+		return false;
+	}
+
+	entries.push_back(std::move(entry));
+	return true;
+}
+
+bool ZipWriter::finish()
+{
+	assert(file.is_open());
+
+	const uint64_t centralDirOffset = offset;
+
+	RecordBuilder record;
+	for (const Entry & entry : entries)
+	{
+		// The only field that can overflow is the offset, as entries are under 4GB.
+		const bool zip64Offset = entry.localHeaderOffset >= Max32;
+		const uint16_t version = zip64Offset ? VersionZip64 : VersionStoredOrDeflated;
+
+		record.put32(CentralHeaderSignature);
+		record.put16(version); // Made by (MS-DOS attributes)
+		record.put16(version); // Needed to extract
+		record.put16(0);       // Flags
+		record.put16(entry.method);
+		record.put16(entry.dosTime);
+		record.put16(entry.dosDate);
+		record.put32(entry.crc32);
+		record.put32(entry.compressedSize);
+		record.put32(entry.uncompressedSize);
+		record.put16(static_cast<uint32_t>(entry.name.length()));
+		record.put16(zip64Offset ? 12 : 0); // Extra field length
+		record.put16(0);                    // Comment length
+		record.put16(0);                    // Disk number
+		record.put16(0);                    // Internal attributes
+		record.put32(entry.externalAttributes);
+		record.put32(zip64Offset ? Max32 : static_cast<uint32_t>(entry.localHeaderOffset));
+		record.putString(entry.name);
+		if (zip64Offset)
+		{
+			record.put16(Zip64ExtraFieldId);
+			record.put16(8);
+			record.put64(entry.localHeaderOffset);
+		}
+
+		// Written in blocks, not all at the end, so memory use stays flat.
+		if (record.bytes.size() >= 64 * 1024)
+		{
+			if (!writeBytes(record.bytes.data(), record.bytes.size()))
+			{
+				return false;
+			}
+			record.bytes.clear();
+		}
+	}
+
+	const uint64_t numEntries = entries.size();
+	const uint64_t centralDirSize = offset + record.bytes.size() - centralDirOffset;
+	const bool zip64 = numEntries >= Max16 || centralDirOffset >= Max32 || centralDirSize >= Max32;
+
+	if (zip64)
+	{
+		const uint64_t zip64EndOffset = offset + record.bytes.size();
+
+		record.put32(Zip64EndOfCentralDirSig);
+		record.put64(44); // Size of the rest of this record
+		record.put16(VersionZip64);
+		record.put16(VersionZip64);
+		record.put32(0);  // This disk
+		record.put32(0);  // Disk with the central directory
+		record.put64(numEntries);
+		record.put64(numEntries);
+		record.put64(centralDirSize);
+		record.put64(centralDirOffset);
+
+		record.put32(Zip64EndLocatorSignature);
+		record.put32(0);  // Disk with the Zip64 end record
+		record.put64(zip64EndOffset);
+		record.put32(1);  // Total disks
+	}
+
+	// Fields that don't fit are set to all ones, telling the reader to look at the Zip64 records.
+	record.put32(EndOfCentralDirSignature);
+	record.put16(0); // This disk
+	record.put16(0); // Disk with the central directory
+	record.put16(zip64 ? Max16 : static_cast<uint32_t>(numEntries));
+	record.put16(zip64 ? Max16 : static_cast<uint32_t>(numEntries));
+	record.put32(zip64 ? Max32 : static_cast<uint32_t>(centralDirSize));
+	record.put32(zip64 ? Max32 : static_cast<uint32_t>(centralDirOffset));
+	record.put16(0); // Comment length
+
+	if (!writeBytes(record.bytes.data(), record.bytes.size()))
+	{
+		return false;
+	}
+
+	file.close();
+	return !file.fail();
+}
+
+void ZipWriter::close()
+{
+	if (file.is_open())
+	{
+		file.close();
+	}
+	entries.clear();
+}
+
+bool ZipWriter::writeBytes(const void * data, const size_t numBytes)
+{
+	if (numBytes == 0)
+	{
+		return !failed;
+	}
+
+	if (failed || !file.write(static_cast<const char *>(data), numBytes))
+	{
+		failed = true;
+		return false;
+	}
+
+	offset += numBytes;
+	return true;
+}
+
+} // namespace utils {}
@@ -0,0 +1,94 @@
+#pragma once
+// ================================================================================================
+// -*- C++ -*-
+// File: zip_writer.hpp
+// Author: Guilherme R. Lampert
+// Created on: 15/10/26
+// Brief: Minimal sequential writer of ZIP archives.
+//
+// This project's source code is released under the MIT License.
+// - http://opensource.org/licenses/MIT
+//
+// ================================================================================================
+
+#include "utils/common.hpp"
+#include <ctime>
+#include <fstream>
+#include <vector>
+
+namespace utils
+{
+
+//
+// Writes a ZIP archive front to back, one entry at a time. The data of each
+// entry is given already compressed (or not), so any number of threads can
+// prepare entries while a single one appends them. The central directory is
+// kept in memory and written by finish(). The Zip64 end records are added when
+// the archive has more than 65535 entries or passes 4GB, but each entry on its
+// own must stay under 4GB. No encryption, comments or data descriptors.
+//
+class ZipWriter final
+	: public NonCopyable
+{
+public:
+
+	// Compression method of an entry, as in the ZIP headers.
+	enum class Method : uint16_t
+	{
+		Stored   = 0,
+		Deflated = 8
+	};
+
+	ZipWriter() = default;
+
+	// Creates (or truncates) the archive file. Returns false on failure.
+	// Use filesys::getLastFileError() to get an error description.
+	bool open(const std::string & filename);
+
+	// Appends a file entry. 'data' is the entry as it goes in the archive: the file contents if Stored,
+	// or raw Deflate data (see compression::deflateRaw()) if Deflated. 'crc32' and 'uncompressedSize' are
+	// of the file contents. Names use '/' as separator and don't start with one. Returns false if the
+	// write fails or if the entry is 4GB or more. The archive is unusable after a failure.
+	bool addFile(const std::string & name, Method method, const uint8_t * data, size_t dataSizeBytes,
+	             uint32_t crc32, uint64_t uncompressedSize, std::time_t modificationTime);
+
+	// Appends a directory entry. A trailing '/' is added to the name if missing.
+	bool addDirectory(const std::string & name, std::time_t modificationTime);
+
+	// Writes the central directory and closes the file. Returns false if a write failed.
+	bool finish();
+
+	// Closes the file without the central directory, leaving an unusable archive. Safe to call if not open.
+	void close();
+
+	// Queries:
+	bool isOpen() const { return file.is_open(); }
+	uint64_t getSizeBytes() const noexcept { return offset; }
+	size_t getEntryCount() const noexcept { return entries.size(); }
+
+private:
+
+	// What the central directory needs of an entry.
+	struct Entry
+	{
+		std::string name;
+		uint16_t    method;
+		uint16_t    dosTime;
+		uint16_t    dosDate;
+		uint32_t    crc32;
+		uint32_t    compressedSize;
+		uint32_t    uncompressedSize;
+		uint32_t    externalAttributes;
+		uint64_t    localHeaderOffset;
+	};
+
+	bool addEntry(Entry entry, const uint8_t * data, size_t dataSizeBytes, std::time_t modificationTime);
+	bool writeBytes(const void * data, size_t numBytes);
+
+	std::ofstream      file;
+	std::vector<Entry> entries;
+	uint64_t           offset = 0;
+	bool               failed = false;
+};
+
+} // namespace utils {}